@@ -0,0 +1,9 @@
+#!/bin/bash
+
+set -e
+
+# Pass --max-size, --min-time or --filter through, e.g. ./bench.sh --max-size 512
+g++ -std=c++17 -O2 -I./ bench/matrix_bench.cpp src/matrix.cpp src/gemm.cpp src/simd.cpp src/thread_pool.cpp src/lu.cpp src/transpose.cpp src/view.cpp src/storage.cpp src/strassen.cpp src/instrumentation.cpp -pthread -o matrix_bench
+./matrix_bench --json bench_results.json "$@"
+
+echo Results written to bench_results.json
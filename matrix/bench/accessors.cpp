@@ -0,0 +1,100 @@
+/*
+ * Sums and fills a matrix through each element accessor, to check that
+ * operator[] and operator() cost no more than indexing the raw array once
+ * inlined, const or not: a non-const access only bumps a counter for the
+ * det() cache, which the compiler keeps in a register across the loop.
+ * With NDEBUG, or -DMATRIX_BOUNDS_CHECK=0, all but get() should match the
+ * raw loops; without it the checked accessors show the price of the checks.
+ *
+ * g++ -std=c++17 -O2 -DNDEBUG -I./ bench/accessors.cpp src/matrix.cpp \
+ *     src/gemm.cpp src/simd.cpp src/thread_pool.cpp src/lu.cpp \
+ *     src/transpose.cpp src/view.cpp src/storage.cpp src/strassen.cpp \
+ *     -pthread -o matrix_accessors
+ * ./matrix_accessors [size]
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "src/matrix.h"
+
+using task::Matrix;
+
+namespace {
+
+// Best of a few runs of sum(), in nanoseconds per element
+template <class F>
+void measure(const char* name, size_t n, F sum) {
+  double best = 0.;
+  double result = 0.;
+  for (int run = 0; run < 5; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    result += sum();
+    std::chrono::duration<double, std::nano> time =
+        std::chrono::steady_clock::now() - start;
+    if (run == 0 || time.count() < best) best = time.count();
+  }
+  std::cout << name << ": " << best / (n * n) << " ns per element (sum "
+            << result << ")" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t n = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1024;
+  Matrix m(n, n);
+  for (size_t i = 0; i < n * n; ++i) m.getRawArray()[i] = 0.001 * i;
+  const Matrix& c = m;
+
+  std::cout << "bounds checks " << (MATRIX_BOUNDS_CHECK ? "on" : "off")
+            << std::endl;
+  measure("raw array", n, [&] {
+    const double* data = c.getRawArray();
+    double sum = 0.;
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = 0; j < n; ++j) sum += data[i * n + j];
+    return sum;
+  });
+  measure("operator()", n, [&] {
+    double sum = 0.;
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = 0; j < n; ++j) sum += c(i, j);
+    return sum;
+  });
+  measure("operator[][]", n, [&] {
+    double sum = 0.;
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = 0; j < n; ++j) sum += c[i][j];
+    return sum;
+  });
+  // Through a non-const Matrix&, as loops that write elements go
+  measure("raw array write", n, [&] {
+    double* data = m.getRawArray();
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = 0; j < n; ++j) data[i * n + j] = 0.001 * (i * n + j);
+    return data[n * n - 1];
+  });
+  measure("operator() non-const", n, [&] {
+    double sum = 0.;
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = 0; j < n; ++j) sum += m(i, j);
+    return sum;
+  });
+  measure("operator() write", n, [&] {
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = 0; j < n; ++j) m(i, j) = 0.001 * (i * n + j);
+    return m(n - 1, n - 1);
+  });
+  measure("operator[][] write", n, [&] {
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = 0; j < n; ++j) m[i][j] = 0.001 * (i * n + j);
+    return m[n - 1][n - 1];
+  });
+  measure("get()", n, [&] {
+    double sum = 0.;
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = 0; j < n; ++j) sum += c.get(i, j);
+    return sum;
+  });
+  return 0;
+}
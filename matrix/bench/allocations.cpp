@@ -0,0 +1,116 @@
+/*
+ * Counts heap allocations done by a typical Matrix pipeline.
+ *
+ * g++ -std=c++17 -O2 -I./ bench/allocations.cpp src/matrix.cpp src/gemm.cpp \
+ *     src/simd.cpp src/thread_pool.cpp src/lu.cpp src/transpose.cpp \
+ *     src/view.cpp src/storage.cpp src/strassen.cpp -pthread \
+ *     -o matrix_allocations
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <utility>
+
+#include "src/matrix.h"
+
+namespace {
+
+size_t allocations = 0;
+size_t allocated_bytes = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  ++allocations;
+  allocated_bytes += size;
+  if (void* p = std::malloc(size)) return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+// Matrix storage takes 64-byte aligned blocks through these
+void* operator new(size_t size, std::align_val_t alignment) {
+  ++allocations;
+  allocated_bytes += size;
+  size_t align = static_cast<size_t>(alignment);
+  if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+using task::Matrix;
+
+namespace {
+
+Matrix make(size_t rows, size_t cols, double seed) {
+  Matrix m(rows, cols);
+  for (size_t i = 0; i < rows * cols; ++i) {
+    m.getRawArray()[i] = seed + 0.001 * i;
+  }
+  return m;
+}
+
+template <class F>
+void measure(const char* name, size_t iterations, F body) {
+  size_t start_allocations = allocations;
+  size_t start_bytes = allocated_bytes;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) body();
+  std::chrono::duration<double, std::micro> time =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << name << ": "
+            << double(allocations - start_allocations) / iterations
+            << " allocations, "
+            << double(allocated_bytes - start_bytes) / iterations
+            << " bytes, " << time.count() / iterations << " us per iteration"
+            << std::endl;
+}
+
+}  // namespace
+
+int main() {
+  const size_t n = 256;
+  const size_t iterations = 50;
+
+  Matrix a = make(n, n, 1.), b = make(n, n, 2.), c = make(n, n, 3.);
+  Matrix result = make(n, n, 0.);
+  double sink = 0.;
+
+  measure("a + b - c * 2.", iterations, [&] { result = a + b - c * 2.; });
+  measure("a * b", iterations, [&] { result = a * b; });
+  measure("(a * b).transposed()", iterations,
+          [&] { result = (a * b).transposed(); });
+  measure("transpose()", iterations, [&] { result.transpose(); });
+  measure("copy assignment", iterations, [&] { result = a; });
+  measure("swap through moves", iterations, [&] {
+    Matrix tmp = std::move(a);
+    a = std::move(b);
+    b = std::move(tmp);
+  });
+  measure("-(a * b) + c", iterations, [&] { result = -(a * b) + c; });
+
+  sink += result.trace();
+  std::cout << "checksum " << sink << std::endl;
+  return 0;
+}
@@ -0,0 +1,263 @@
+/*
+ * Benchmark suite for the matrix module, in the spirit of Google
+ * Benchmark: every case runs for at least --min-time seconds and reports
+ * time per operation, GFLOP/s, bytes/s and heap allocations per operation.
+ * Sizes sweep powers of two from 2 to --max-size. --json writes the
+ * results, with the machine context, for comparison between releases.
+ *
+ * Built and run by bench.sh, or:
+ * g++ -std=c++17 -O2 -I./ bench/matrix_bench.cpp src/matrix.cpp src/gemm.cpp \
+ *     src/simd.cpp src/thread_pool.cpp src/lu.cpp src/transpose.cpp \
+ *     src/view.cpp src/storage.cpp src/strassen.cpp src/instrumentation.cpp \
+ *     -pthread -o matrix_bench
+ * ./matrix_bench [--max-size N] [--min-time SECONDS] [--filter NAME]
+ *                [--json FILE]
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/matrix.h"
+#include "src/simd.h"
+
+namespace {
+
+size_t allocations = 0;
+
+void* counted_malloc(size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void* counted_aligned_malloc(size_t size, std::align_val_t alignment) {
+  ++allocations;
+  size_t align = static_cast<size_t>(alignment);
+  size = (size + align - 1) / align * align;
+  if (void* p = std::aligned_alloc(align, size ? size : align)) return p;
+  throw std::bad_alloc();
+}
+
+}  // namespace
+
+void* operator new(size_t size) { return counted_malloc(size); }
+void* operator new[](size_t size) { return counted_malloc(size); }
+void* operator new(size_t size, std::align_val_t alignment) {
+  return counted_aligned_malloc(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return counted_aligned_malloc(size, alignment);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+using task::Matrix;
+
+namespace {
+
+struct Options {
+  size_t max_size = 4096;
+  double min_time = 0.5;
+  std::string filter;
+  std::string json;
+};
+
+struct Result {
+  std::string name;
+  size_t size;
+  size_t iterations;
+  double ns_per_op;
+  double flops_per_op;
+  double bytes_per_op;
+  double allocations_per_op;
+};
+
+// Work done by one operation, for the throughput columns
+struct Cost {
+  double flops;
+  double bytes;
+};
+
+Matrix random_matrix(size_t n, std::mt19937& generator) {
+  std::uniform_real_distribution<double> value(-1., 1.);
+  Matrix m(n, n);
+  for (size_t i = 0; i < n * n; ++i) m.getRawArray()[i] = value(generator);
+  // Diagonally dominant, so det() never takes the singular shortcut
+  for (size_t i = 0; i < n; ++i) m[i][i] += n;
+  return m;
+}
+
+/*
+ * Runs body once to warm up, then in batches of growing size until the
+ * batch takes min_time; the last batch is the one reported.
+ */
+template <class F>
+Result run(const std::string& name, size_t size, Cost cost,
+           const Options& options, F body) {
+  body();
+  size_t iterations = 1;
+  while (true) {
+    size_t start_allocations = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) body();
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+
+    if (time.count() >= options.min_time || iterations >= (size_t(1) << 30)) {
+      return {name,
+              size,
+              iterations,
+              time.count() * 1e9 / iterations,
+              cost.flops,
+              cost.bytes,
+              double(allocations - start_allocations) / iterations};
+    }
+    // Aim past min_time, but grow at most tenfold per round
+    double factor = time.count() > 0. ? options.min_time * 1.4 / time.count()
+                                      : 10.;
+    factor = factor > 10. ? 10. : (factor < 2. ? 2. : factor);
+    iterations = static_cast<size_t>(iterations * factor);
+  }
+}
+
+void print(const Result& r) {
+  double seconds = r.ns_per_op * 1e-9;
+  std::cout << r.name << "/" << r.size << "\t" << r.iterations << " it\t"
+            << r.ns_per_op << " ns/op\t" << r.flops_per_op / seconds * 1e-9
+            << " GFLOP/s\t" << r.bytes_per_op / seconds * 1e-9 << " GB/s\t"
+            << r.allocations_per_op << " allocs/op" << std::endl;
+}
+
+void write_json(const std::string& path, const std::vector<Result>& results,
+                const Options& options) {
+  std::ofstream output(path);
+  output.precision(10);
+  output << "{\n  \"context\": {\n"
+         << "    \"compiler\": \"" << __VERSION__ << "\",\n"
+         << "    \"isa\": \"" << task::simd::isa_name(task::simd::active_isa())
+         << "\",\n"
+         << "    \"hardware_threads\": " << std::thread::hardware_concurrency()
+         << ",\n"
+         << "    \"min_time\": " << options.min_time << "\n  },\n"
+         << "  \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    double seconds = r.ns_per_op * 1e-9;
+    output << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "/"
+           << r.size << "\", \"run_name\": \"" << r.name
+           << "\", \"size\": " << r.size
+           << ", \"iterations\": " << r.iterations
+           << ", \"real_time\": " << r.ns_per_op
+           << ", \"time_unit\": \"ns\", \"gflops\": "
+           << r.flops_per_op / seconds * 1e-9
+           << ", \"bytes_per_second\": " << r.bytes_per_op / seconds
+           << ", \"allocations_per_op\": " << r.allocations_per_op << "}";
+  }
+  output << "\n  ]\n}\n";
+  if (!output) {
+    std::cerr << "cannot write " << path << std::endl;
+    std::exit(1);
+  }
+}
+
+Options parse(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 < argc && std::strcmp(argv[i], "--max-size") == 0) {
+      options.max_size = std::strtoul(argv[++i], nullptr, 10);
+    } else if (i + 1 < argc && std::strcmp(argv[i], "--min-time") == 0) {
+      options.min_time = std::strtod(argv[++i], nullptr);
+    } else if (i + 1 < argc && std::strcmp(argv[i], "--filter") == 0) {
+      options.filter = argv[++i];
+    } else if (i + 1 < argc && std::strcmp(argv[i], "--json") == 0) {
+      options.json = argv[++i];
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [--max-size N] [--min-time SECONDS] [--filter NAME]"
+                << " [--json FILE]" << std::endl;
+      std::exit(1);
+    }
+  }
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options = parse(argc, argv);
+  std::mt19937 generator(42);
+  std::vector<Result> results;
+  double sink = 0.;
+
+  auto wanted = [&](const char* name) {
+    return options.filter.empty() ||
+           std::string(name).find(options.filter) != std::string::npos;
+  };
+  auto record = [&](const Result& r) {
+    print(r);
+    results.push_back(r);
+  };
+
+  for (size_t n = 2; n <= options.max_size; n *= 2) {
+    Matrix a = random_matrix(n, generator);
+    Matrix b = random_matrix(n, generator);
+    Matrix c(n, n);
+    double nn = double(n) * n;
+    double bytes = nn * sizeof(double);
+
+    if (wanted("multiply")) {
+      record(run("multiply", n, {2. * nn * n, 3. * bytes}, options,
+                 [&] { c = a * b; }));
+    }
+    if (wanted("det")) {
+      // set() drops the cached value, so every call factors the matrix
+      record(run("det", n, {2. / 3. * nn * n, bytes}, options, [&] {
+        a.set(0, 0, a.get(0, 0));
+        sink += a.det();
+      }));
+    }
+    if (wanted("transpose")) {
+      record(run("transpose", n, {0., 2. * bytes}, options,
+                 [&] { c.transpose(); }));
+    }
+    if (wanted("add")) {
+      record(run("add", n, {nn, 3. * bytes}, options, [&] { c = a + b; }));
+    }
+    if (wanted("text_io")) {
+      std::stringstream text;
+      text << n << " " << n << a;
+      double text_bytes = double(text.str().size());
+      record(run("text_io", n, {0., 2. * text_bytes}, options, [&] {
+        std::stringstream stream;
+        stream << n << " " << n << a;
+        stream >> c;
+      }));
+    }
+    sink += c.trace();
+  }
+
+  if (!options.json.empty()) {
+    write_json(options.json, results, options);
+  }
+  std::cerr << "checksum " << sink << std::endl;
+  return 0;
+}
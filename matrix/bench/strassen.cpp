@@ -0,0 +1,83 @@
+/*
+ * Times the classic blocked product against Strassen-Winograd on square
+ * matrices, to find the size from which one level of recursion pays off on
+ * this machine. A good cutoff for set_strassen_cutoff() is the first size
+ * with a speedup above 1.
+ *
+ * g++ -std=c++17 -O2 -I./ bench/strassen.cpp src/matrix.cpp src/gemm.cpp \
+ *     src/simd.cpp src/thread_pool.cpp src/lu.cpp src/transpose.cpp \
+ *     src/view.cpp src/storage.cpp src/strassen.cpp -pthread \
+ *     -o matrix_strassen
+ * ./matrix_strassen [max_size]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "src/matrix.h"
+#include "src/strassen.h"
+
+using task::Matrix;
+
+namespace {
+
+Matrix random_matrix(size_t n, std::mt19937& generator) {
+  std::uniform_real_distribution<double> value(-1., 1.);
+  Matrix m(n, n);
+  for (size_t i = 0; i < n * n; ++i) m.getRawArray()[i] = value(generator);
+  return m;
+}
+
+// Best of a few runs, in milliseconds
+double time_product(const Matrix& a, const Matrix& b, Matrix& result) {
+  size_t runs = a.getRows() >= 2048 ? 1 : 3;
+  double best = 0.;
+  for (size_t i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    result = a * b;
+    std::chrono::duration<double, std::milli> time =
+        std::chrono::steady_clock::now() - start;
+    if (i == 0 || time.count() < best) best = time.count();
+  }
+  return best;
+}
+
+double max_difference(const Matrix& a, const Matrix& b) {
+  double difference = 0.;
+  size_t size = a.getRows() * a.getColumns();
+  for (size_t i = 0; i < size; ++i) {
+    difference = std::max(
+        difference, std::fabs(a.getRawArray()[i] - b.getRawArray()[i]));
+  }
+  return difference;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t max_size = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 4096;
+  std::mt19937 generator(42);
+
+  std::cout << "size  classic_ms  one_level_ms  speedup  max_difference"
+            << std::endl;
+  for (size_t n = 256; n <= max_size; n *= 2) {
+    Matrix a = random_matrix(n, generator);
+    Matrix b = random_matrix(n, generator);
+    Matrix classic, fast;
+
+    task::set_strassen_cutoff(0);
+    double classic_ms = time_product(a, b, classic);
+    // Just above n / 2: one level of recursion, then the blocked kernel
+    task::set_strassen_cutoff(n / 2 + 1);
+    double fast_ms = time_product(a, b, fast);
+
+    std::cout << n << "  " << classic_ms << "  " << fast_ms << "  "
+              << classic_ms / fast_ms << "  " << max_difference(classic, fast)
+              << std::endl;
+  }
+  task::set_strassen_cutoff(0);
+  return 0;
+}
@@ -4,7 +4,7 @@ set -e
 
 STRESS_TEST_COUNT=500
 
-g++ -std=c++17 -I./ test/test.cpp src/matrix.cpp -o matrix_test
+g++ -std=c++17 -O2 -I./ test/test.cpp src/matrix.cpp src/gemm.cpp src/simd.cpp src/thread_pool.cpp src/lu.cpp src/qr.cpp src/cholesky.cpp src/transpose.cpp src/sparse.cpp src/serialization.cpp src/out_of_core.cpp src/view.cpp src/storage.cpp src/strassen.cpp src/batch.cpp src/instrumentation.cpp -pthread -o matrix_test
 python3 test/generate.py $STRESS_TEST_COUNT > test_data
 ./matrix_test $STRESS_TEST_COUNT < test_data
 
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "exceptions.h"
+#include "gemm.h"
+#include "matrix.h"
+
+namespace task {
+
+/*
+ * Dense row-major matrix of element type T, meant for float, double,
+ * int64_t and std::complex<double>. Matrix stays the double workhorse with
+ * expression templates, views and SIMD kernels; BasicMatrix has the same
+ * interface and exceptions for the other element types.
+ *
+ * Paths specific to the element type:
+ *  - float products go through the mixed-precision gemm (float storage,
+ *    double accumulation) and float det() eliminates in double;
+ *  - int64_t det() is exact, computed by fraction-free Bareiss elimination;
+ *  - == compares integers exactly and everything else within EPS.
+ */
+template <class T>
+class BasicMatrix {
+ public:
+  // Ones on the main diagonal, zeros elsewhere, as Matrix(rows, cols)
+  BasicMatrix() : BasicMatrix(1, 1) {}
+  BasicMatrix(size_t rows, size_t cols)
+      : rows(rows), cols(cols), data(rows * cols, T(0)) {
+    for (size_t i = 0; i < rows && i < cols; ++i) data[i * cols + i] = T(1);
+  }
+
+  explicit BasicMatrix(const Matrix& m)
+      : rows(m.getRows()), cols(m.getColumns()), data(rows * cols) {
+    const double* src = m.view().getRawArray();
+    for (size_t i = 0; i < rows * cols; ++i) data[i] = static_cast<T>(src[i]);
+  }
+
+  template <class U>
+  explicit BasicMatrix(const BasicMatrix<U>& m)
+      : rows(m.getRows()), cols(m.getColumns()), data(rows * cols) {
+    const U* src = m.getRawArray();
+    for (size_t i = 0; i < rows * cols; ++i) data[i] = static_cast<T>(src[i]);
+  }
+
+  Matrix toMatrix() const {
+    static_assert(std::is_arithmetic<T>::value,
+                  "toMatrix() needs a real element type");
+    Matrix m(rows, cols);
+    double* dst = m.getRawArray();
+    for (size_t i = 0; i < rows * cols; ++i) {
+      dst[i] = static_cast<double>(data[i]);
+    }
+    return m;
+  }
+
+  T& get(size_t row, size_t col) {
+    check_bound(row, col);
+    return data[row * cols + col];
+  }
+  const T& get(size_t row, size_t col) const {
+    check_bound(row, col);
+    return data[row * cols + col];
+  }
+  void set(size_t row, size_t col, const T& value) { get(row, col) = value; }
+
+  // Unchecked row access
+  T* operator[](size_t row) { return data.data() + row * cols; }
+  const T* operator[](size_t row) const { return data.data() + row * cols; }
+
+  size_t getRows() const { return rows; }
+  size_t getColumns() const { return cols; }
+  T* getRawArray() { return data.data(); }
+  const T* getRawArray() const { return data.data(); }
+
+  BasicMatrix& operator+=(const BasicMatrix& a) {
+    check_size(a);
+    for (size_t i = 0; i < data.size(); ++i) data[i] += a.data[i];
+    return *this;
+  }
+
+  BasicMatrix& operator-=(const BasicMatrix& a) {
+    check_size(a);
+    for (size_t i = 0; i < data.size(); ++i) data[i] -= a.data[i];
+    return *this;
+  }
+
+  BasicMatrix& operator*=(const T& number) {
+    for (T& value : data) value *= number;
+    return *this;
+  }
+
+  BasicMatrix& operator*=(const BasicMatrix& a) {
+    return *this = multiply(*this, a, ExecutionPolicy::sequential());
+  }
+
+  BasicMatrix operator+(const BasicMatrix& a) const {
+    BasicMatrix m(*this);
+    return m += a;
+  }
+
+  BasicMatrix operator-(const BasicMatrix& a) const {
+    BasicMatrix m(*this);
+    return m -= a;
+  }
+
+  BasicMatrix operator*(const T& number) const {
+    BasicMatrix m(*this);
+    return m *= number;
+  }
+
+  BasicMatrix operator*(const BasicMatrix& a) const {
+    return multiply(*this, a, ExecutionPolicy::sequential());
+  }
+
+  BasicMatrix operator-() const {
+    BasicMatrix m(*this);
+    for (T& value : m.data) value = -value;
+    return m;
+  }
+
+  BasicMatrix operator+() const { return *this; }
+
+  /*
+   * float and double go through gemm, other element types through an
+   * i-p-j loop; both split rows over the threads of policy.
+   */
+  static BasicMatrix multiply(const BasicMatrix& a, const BasicMatrix& b,
+                              const ExecutionPolicy& policy) {
+    if (a.cols != b.rows) {
+      throw SizeMismatchException();
+    }
+
+    BasicMatrix m(a.rows, b.cols, Uninitialized());
+    if constexpr (std::is_same<T, double>::value ||
+                  std::is_same<T, float>::value) {
+      gemm(a.rows, b.cols, a.cols, 1., a.data.data(), a.cols, b.data.data(),
+           b.cols, 0., m.data.data(), b.cols, policy);
+    } else {
+      policy.parallel_for(a.rows, [&](size_t i) {
+        T* m_row = m[i];
+        for (size_t j = 0; j < b.cols; ++j) m_row[j] = T(0);
+        for (size_t p = 0; p < a.cols; ++p) {
+          T a_ip = a[i][p];
+          const T* b_row = b[p];
+          for (size_t j = 0; j < b.cols; ++j) m_row[j] += a_ip * b_row[j];
+        }
+      });
+    }
+    return m;
+  }
+
+  bool operator==(const BasicMatrix& a) const {
+    if (rows != a.rows || cols != a.cols) {
+      return false;
+    }
+    for (size_t i = 0; i < data.size(); ++i) {
+      if constexpr (std::is_integral<T>::value) {
+        if (data[i] != a.data[i]) return false;
+      } else {
+        if (std::abs(data[i] - a.data[i]) > EPS) return false;
+      }
+    }
+    return true;
+  }
+
+  bool operator!=(const BasicMatrix& a) const { return !(*this == a); }
+
+  BasicMatrix transposed() const {
+    BasicMatrix m(cols, rows, Uninitialized());
+    for (size_t i = 0; i < rows; ++i)
+      for (size_t j = 0; j < cols; ++j)
+        m.data[j * rows + i] = data[i * cols + j];
+    return m;
+  }
+
+  void transpose() { *this = transposed(); }
+
+  T trace() const {
+    if (rows != cols) {
+      throw SizeMismatchException();
+    }
+    T s = T(0);
+    for (size_t i = 0; i < rows; ++i) s += data[i * cols + i];
+    return s;
+  }
+
+  T det() const {
+    if (rows != cols) {
+      throw SizeMismatchException();
+    }
+    if constexpr (std::is_integral<T>::value) {
+      return det_bareiss();
+    } else {
+      return det_elimination();
+    }
+  }
+
+ private:
+  size_t rows = 1;
+  size_t cols = 1;
+  std::vector<T> data;
+
+  // float is accumulated in double, everything else in itself
+  using Accumulator =
+      typename std::conditional<std::is_same<T, float>::value, double, T>::type;
+
+  struct Uninitialized {};
+
+  BasicMatrix(size_t rows, size_t cols, Uninitialized)
+      : rows(rows), cols(cols), data(rows * cols) {}
+
+  void check_bound(size_t row, size_t col) const {
+    if (row >= rows || col >= cols) {
+      throw OutOfBoundsException();
+    }
+  }
+
+  void check_size(const BasicMatrix& a) const {
+    if (rows != a.rows || cols != a.cols) {
+      throw SizeMismatchException();
+    }
+  }
+
+  // Same elimination rule as Matrix::det(), on a copy in Accumulator
+  T det_elimination() const {
+    size_t n = rows;
+    std::vector<Accumulator> m(data.begin(), data.end());
+    Accumulator det = Accumulator(1);
+    for (size_t i = 0; i < n; ++i) {
+      size_t pivot = i;
+      for (size_t k = i + 1; k < n; ++k) {
+        if (std::abs(m[k * n + i]) > std::abs(m[pivot * n + i])) pivot = k;
+      }
+      if (pivot != i) {
+        for (size_t j = 0; j < n; ++j) {
+          std::swap(m[i * n + j], m[pivot * n + j]);
+        }
+        det = -det;
+      }
+      Accumulator value = m[i * n + i];
+      if (i + 1 < n && std::abs(value) < EPS) return T(0);
+      for (size_t r = i + 1; r < n; ++r) {
+        Accumulator k = m[r * n + i] / value;
+        for (size_t j = i; j < n; ++j) m[r * n + j] -= k * m[i * n + j];
+      }
+      det *= value;
+    }
+    return static_cast<T>(det);
+  }
+
+  /*
+   * Bareiss: every intermediate entry is a minor of the matrix, so the
+   * divisions are exact and the result is exact as long as the minors fit
+   * in T. Products are formed in 128 bits before dividing.
+   */
+  T det_bareiss() const {
+    size_t n = rows;
+    std::vector<T> m(data);
+    T sign = 1;
+    T previous = 1;
+    for (size_t k = 0; k < n; ++k) {
+      if (m[k * n + k] == 0) {
+        size_t pivot = k + 1;
+        while (pivot < n && m[pivot * n + k] == 0) ++pivot;
+        if (pivot == n) return 0;
+        for (size_t j = k; j < n; ++j) {
+          std::swap(m[k * n + j], m[pivot * n + j]);
+        }
+        sign = -sign;
+      }
+      for (size_t i = k + 1; i < n; ++i) {
+        for (size_t j = k + 1; j < n; ++j) {
+          __int128 value =
+              static_cast<__int128>(m[i * n + j]) * m[k * n + k] -
+              static_cast<__int128>(m[i * n + k]) * m[k * n + j];
+          m[i * n + j] = static_cast<T>(value / previous);
+        }
+      }
+      previous = m[k * n + k];
+    }
+    return n == 0 ? T(1) : sign * m[n * n - 1];
+  }
+};
+
+template <class T>
+BasicMatrix<T> operator*(const T& a, const BasicMatrix<T>& b) {
+  return b * a;
+}
+
+template <class T>
+std::ostream& operator<<(std::ostream& output, const BasicMatrix<T>& matrix) {
+  output.precision(12);
+  for (size_t i = 0; i < matrix.getRows(); ++i)
+    for (size_t j = 0; j < matrix.getColumns(); ++j)
+      output << " " << matrix[i][j];
+  output << std::endl;
+  return output;
+}
+
+using FloatMatrix = BasicMatrix<float>;
+using IntMatrix = BasicMatrix<int64_t>;
+using ComplexMatrix = BasicMatrix<std::complex<double>>;
+
+}  // namespace task
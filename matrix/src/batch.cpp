@@ -0,0 +1,411 @@
+#include "batch.h"
+
+#include <algorithm>  // copy && fill
+
+#include "closed_form.h"
+#include "lu.h"
+#include "simd.h"
+#include "storage.h"
+
+namespace task {
+
+namespace {
+
+/*
+ * Matrices handled per kernel step. A fixed trip count over the lanes lets
+ * the compiler turn every step into whole vectors with no scalar tail.
+ */
+const size_t LANES = 8;
+
+#define TASK_BATCH_INLINE inline __attribute__((always_inline))
+
+/*
+ * Lane loops: element k of the matrices in a block sits at
+ * a[k * stride + lane], so every load and store is a whole vector.
+ */
+TASK_BATCH_INLINE void multiply_lanes(size_t rows, size_t inner, size_t cols,
+                                      const double* __restrict a,
+                                      const double* __restrict b,
+                                      double* __restrict c, size_t stride) {
+  for (size_t block = 0; block < stride; block += LANES) {
+    for (size_t i = 0; i < rows; ++i) {
+      for (size_t j = 0; j < cols; ++j) {
+        double acc[LANES] = {};
+        for (size_t p = 0; p < inner; ++p) {
+          const double* x = a + (i * inner + p) * stride + block;
+          const double* y = b + (p * cols + j) * stride + block;
+          for (size_t l = 0; l < LANES; ++l) acc[l] += x[l] * y[l];
+        }
+        double* z = c + (i * cols + j) * stride + block;
+        for (size_t l = 0; l < LANES; ++l) z[l] = acc[l];
+      }
+    }
+  }
+}
+
+// Square N x N operands: the whole product of a lane stays in registers
+template <size_t N>
+TASK_BATCH_INLINE void multiply_square_lanes(const double* __restrict a,
+                                             const double* __restrict b,
+                                             double* __restrict c,
+                                             size_t stride) {
+  for (size_t block = 0; block < stride; block += LANES) {
+    const double* x = a + block;
+    const double* y = b + block;
+    double* z = c + block;
+#pragma GCC ivdep
+    for (size_t l = 0; l < LANES; ++l) {
+#pragma GCC unroll 16
+      for (size_t i = 0; i < N; ++i) {
+#pragma GCC unroll 16
+        for (size_t j = 0; j < N; ++j) {
+          double sum = 0.;
+#pragma GCC unroll 16
+          for (size_t p = 0; p < N; ++p) {
+            sum += x[(i * N + p) * stride + l] * y[(p * N + j) * stride + l];
+          }
+          z[(i * N + j) * stride + l] = sum;
+        }
+      }
+    }
+  }
+}
+
+template <size_t N>
+TASK_BATCH_INLINE void det_lanes(const double* __restrict a,
+                                 double* __restrict det, size_t stride) {
+  for (size_t block = 0; block < stride; block += LANES) {
+    const double* x = a + block;
+#pragma GCC ivdep
+    for (size_t l = 0; l < LANES; ++l) {
+      auto in = [&](size_t k) { return x[k * stride + l]; };
+      det[block + l] = closed_form::det<N, double>(in);
+    }
+  }
+}
+
+template <size_t N>
+TASK_BATCH_INLINE void inverse_lanes(const double* __restrict a,
+                                     double* __restrict b,
+                                     double* __restrict det, size_t stride) {
+  for (size_t block = 0; block < stride; block += LANES) {
+    const double* x = a + block;
+    double* y = b + block;
+#pragma GCC ivdep
+    for (size_t l = 0; l < LANES; ++l) {
+      auto in = [&](size_t k) { return x[k * stride + l]; };
+      auto out = [&](size_t k) -> double& { return y[k * stride + l]; };
+      det[block + l] = closed_form::inverse<N, double>(in, out);
+    }
+  }
+}
+
+TASK_BATCH_INLINE void multiply_any(size_t rows, size_t inner, size_t cols,
+                                    const double* a, const double* b,
+                                    double* c, size_t stride) {
+  if (rows == inner && inner == cols) {
+    switch (rows) {
+      case 2:
+        return multiply_square_lanes<2>(a, b, c, stride);
+      case 3:
+        return multiply_square_lanes<3>(a, b, c, stride);
+      case 4:
+        return multiply_square_lanes<4>(a, b, c, stride);
+    }
+  }
+  multiply_lanes(rows, inner, cols, a, b, c, stride);
+}
+
+TASK_BATCH_INLINE void det_any(size_t n, const double* a, double* det,
+                               size_t stride) {
+  switch (n) {
+    case 1:
+      return det_lanes<1>(a, det, stride);
+    case 2:
+      return det_lanes<2>(a, det, stride);
+    case 3:
+      return det_lanes<3>(a, det, stride);
+    case 4:
+      return det_lanes<4>(a, det, stride);
+  }
+}
+
+TASK_BATCH_INLINE void inverse_any(size_t n, const double* a, double* b,
+                                   double* det, size_t stride) {
+  switch (n) {
+    case 1:
+      return inverse_lanes<1>(a, b, det, stride);
+    case 2:
+      return inverse_lanes<2>(a, b, det, stride);
+    case 3:
+      return inverse_lanes<3>(a, b, det, stride);
+    case 4:
+      return inverse_lanes<4>(a, b, det, stride);
+  }
+}
+
+struct Kernels {
+  void (*multiply)(size_t, size_t, size_t, const double*, const double*,
+                   double*, size_t);
+  void (*det)(size_t, const double*, double*, size_t);
+  void (*inverse)(size_t, const double*, double*, double*, size_t);
+};
+
+/*
+ * The same lane loops compiled for every instruction set; the target
+ * attribute only changes the vector width the compiler may use.
+ */
+void multiply_base(size_t rows, size_t inner, size_t cols, const double* a,
+                   const double* b, double* c, size_t stride) {
+  multiply_any(rows, inner, cols, a, b, c, stride);
+}
+
+void det_base(size_t n, const double* a, double* det, size_t stride) {
+  det_any(n, a, det, stride);
+}
+
+void inverse_base(size_t n, const double* a, double* b, double* det,
+                  size_t stride) {
+  inverse_any(n, a, b, det, stride);
+}
+
+const Kernels BASE = {multiply_base, det_base, inverse_base};
+
+#ifdef TASK_SIMD_X86
+
+__attribute__((target("avx2"))) void multiply_avx2(
+    size_t rows, size_t inner, size_t cols, const double* a, const double* b,
+    double* c, size_t stride) {
+  multiply_any(rows, inner, cols, a, b, c, stride);
+}
+
+__attribute__((target("avx2"))) void det_avx2(size_t n, const double* a,
+                                              double* det, size_t stride) {
+  det_any(n, a, det, stride);
+}
+
+__attribute__((target("avx2"))) void inverse_avx2(size_t n, const double* a,
+                                                  double* b, double* det,
+                                                  size_t stride) {
+  inverse_any(n, a, b, det, stride);
+}
+
+const Kernels AVX2 = {multiply_avx2, det_avx2, inverse_avx2};
+
+__attribute__((target("avx512f"))) void multiply_avx512(
+    size_t rows, size_t inner, size_t cols, const double* a, const double* b,
+    double* c, size_t stride) {
+  multiply_any(rows, inner, cols, a, b, c, stride);
+}
+
+__attribute__((target("avx512f"))) void det_avx512(size_t n, const double* a,
+                                                   double* det,
+                                                   size_t stride) {
+  det_any(n, a, det, stride);
+}
+
+__attribute__((target("avx512f"))) void inverse_avx512(size_t n,
+                                                       const double* a,
+                                                       double* b, double* det,
+                                                       size_t stride) {
+  inverse_any(n, a, b, det, stride);
+}
+
+const Kernels AVX512 = {multiply_avx512, det_avx512, inverse_avx512};
+
+#endif  // TASK_SIMD_X86
+
+// Follows simd::set_isa(), so both kinds of kernels agree
+const Kernels& kernels() {
+#ifdef TASK_SIMD_X86
+  switch (simd::active_isa()) {
+    case simd::Isa::Avx512:
+      return AVX512;
+    case simd::Isa::Avx2:
+      return AVX2;
+    case simd::Isa::Sse2:
+    case simd::Isa::Scalar:
+      break;
+  }
+#endif
+  return BASE;
+}
+
+}  // namespace
+
+MatrixBatch::MatrixBatch(size_t count, size_t rows, size_t cols,
+                         Uninitialized)
+    : count(count),
+      rows(rows),
+      cols(cols),
+      stride((count + LANES - 1) / LANES * LANES),
+      data(storage::allocate(rows * cols * stride)) {}
+
+MatrixBatch::MatrixBatch(size_t count, size_t rows, size_t cols)
+    : MatrixBatch(count, rows, cols, Uninitialized()) {
+  std::fill(data, data + rows * cols * stride, 0.);
+  if (rows == cols) {
+    for (size_t i = 0; i < rows; ++i) {
+      std::fill(lane(i, i), lane(i, i) + stride, 1.);
+    }
+  }
+}
+
+MatrixBatch::MatrixBatch(const MatrixBatch& other)
+    : MatrixBatch(other.count, other.rows, other.cols, Uninitialized()) {
+  std::copy(other.data, other.data + rows * cols * stride, data);
+}
+
+MatrixBatch& MatrixBatch::operator=(const MatrixBatch& other) {
+  if (this != &other) {
+    *this = MatrixBatch(other);
+  }
+  return *this;
+}
+
+MatrixBatch::MatrixBatch(MatrixBatch&& other) noexcept
+    : count(other.count),
+      rows(other.rows),
+      cols(other.cols),
+      stride(other.stride),
+      data(other.data) {
+  other.count = other.rows = other.cols = other.stride = 0;
+  other.data = nullptr;
+}
+
+MatrixBatch& MatrixBatch::operator=(MatrixBatch&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  storage::release(data);
+  count = other.count;
+  rows = other.rows;
+  cols = other.cols;
+  stride = other.stride;
+  data = other.data;
+  other.count = other.rows = other.cols = other.stride = 0;
+  other.data = nullptr;
+  return *this;
+}
+
+MatrixBatch::~MatrixBatch() { storage::release(data); }
+
+void MatrixBatch::check_index(size_t index, size_t row, size_t col) const {
+  if (index >= count || row >= rows || col >= cols) {
+    throw OutOfBoundsException();
+  }
+}
+
+size_t MatrixBatch::size() const { return count; }
+
+size_t MatrixBatch::getRows() const { return rows; }
+
+size_t MatrixBatch::getColumns() const { return cols; }
+
+double* MatrixBatch::lane(size_t row, size_t col) {
+  return data + (row * cols + col) * stride;
+}
+
+const double* MatrixBatch::lane(size_t row, size_t col) const {
+  return data + (row * cols + col) * stride;
+}
+
+double& MatrixBatch::get(size_t index, size_t row, size_t col) {
+  check_index(index, row, col);
+  return lane(row, col)[index];
+}
+
+const double& MatrixBatch::get(size_t index, size_t row, size_t col) const {
+  check_index(index, row, col);
+  return lane(row, col)[index];
+}
+
+void MatrixBatch::set(size_t index, size_t row, size_t col,
+                      const double& value) {
+  get(index, row, col) = value;
+}
+
+task::Matrix MatrixBatch::getMatrix(size_t index) const {
+  check_index(index, 0, 0);
+  Matrix m(rows, cols, Matrix::Uninitialized());
+  double* dst = m.getRawArray();
+  for (size_t k = 0; k < rows * cols; ++k) dst[k] = data[k * stride + index];
+  return m;
+}
+
+void MatrixBatch::setMatrix(size_t index, const Matrix& matrix) {
+  check_index(index, 0, 0);
+  if (matrix.getRows() != rows || matrix.getColumns() != cols) {
+    throw SizeMismatchException();
+  }
+  const double* src = matrix.view().getRawArray();
+  for (size_t k = 0; k < rows * cols; ++k) data[k * stride + index] = src[k];
+}
+
+MatrixBatch MatrixBatch::multiply(const MatrixBatch& a, const MatrixBatch& b) {
+  if (a.count != b.count || a.cols != b.rows) {
+    throw SizeMismatchException();
+  }
+
+  MatrixBatch m(a.count, a.rows, b.cols, Uninitialized());
+  kernels().multiply(a.rows, a.cols, b.cols, a.data, b.data, m.data,
+                     a.stride);
+  return m;
+}
+
+std::vector<double> MatrixBatch::det() const {
+  if (rows != cols) {
+    throw SizeMismatchException();
+  }
+
+  std::vector<double> result(stride);
+  if (rows == 0) {
+    std::fill(result.begin(), result.end(), 1.);
+  } else if (rows <= closed_form::MAX_ORDER) {
+    kernels().det(rows, data, result.data(), stride);
+  } else {
+    for (size_t k = 0; k < count; ++k) result[k] = getMatrix(k).det();
+  }
+  result.resize(count);
+  return result;
+}
+
+MatrixBatch MatrixBatch::inverse() const {
+  if (rows != cols) {
+    throw SizeMismatchException();
+  }
+
+  if (rows == 0) {
+    return MatrixBatch(count, rows, cols);
+  }
+  if (rows > closed_form::MAX_ORDER) {
+    MatrixBatch m(count, rows, cols);
+    for (size_t k = 0; k < count; ++k) {
+      m.setMatrix(k, LUDecomposition(getMatrix(k)).inverse());
+    }
+    return m;
+  }
+
+  MatrixBatch m(count, rows, cols, Uninitialized());
+  std::vector<double> det(stride);
+  kernels().inverse(rows, data, m.data, det.data(), stride);
+  for (size_t k = 0; k < count; ++k) {
+    if (det[k] < EPS && det[k] > -EPS) {
+      throw SingularMatrixException();
+    }
+  }
+  return m;
+}
+
+MatrixBatch MatrixBatch::transposed() const {
+  MatrixBatch m(count, cols, rows, Uninitialized());
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      std::copy(lane(i, j), lane(i, j) + stride, m.lane(j, i));
+    }
+  }
+  return m;
+}
+
+}  // namespace task
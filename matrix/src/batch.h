@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "matrix.h"
+
+namespace task {
+
+/*
+ * count matrices of the same shape in structure-of-arrays layout: element
+ * (row, col) of all of them forms one lane array, lane(row, col)[k] being
+ * the element of matrix k. The kernels below then run SIMD across
+ * matrices, one matrix per vector lane, with no per-matrix allocation or
+ * call; they pick their instruction set like the simd:: kernels do.
+ *
+ * Lane arrays are padded to a multiple of 8 with identity matrices, so
+ * kernels never need a scalar tail, and come from the Matrix storage
+ * allocator, so they are aligned and batches created in a loop recycle
+ * their memory.
+ *
+ * 1x1 .. 4x4 det() and inverse() use the closed forms of closed_form.h,
+ * shared with FixedMatrix; bigger shapes fall back to LUDecomposition one
+ * matrix at a time.
+ */
+class MatrixBatch {
+ public:
+  // count identity matrices, as Matrix(rows, cols)
+  MatrixBatch(size_t count, size_t rows, size_t cols);
+  MatrixBatch(const MatrixBatch& other);
+  MatrixBatch& operator=(const MatrixBatch& other);
+  // Moved-from batches are left empty
+  MatrixBatch(MatrixBatch&& other) noexcept;
+  MatrixBatch& operator=(MatrixBatch&& other) noexcept;
+  ~MatrixBatch();
+
+  size_t size() const;
+  size_t getRows() const;
+  size_t getColumns() const;
+
+  // Unchecked, size() values of element (row, col)
+  double* lane(size_t row, size_t col);
+  const double* lane(size_t row, size_t col) const;
+
+  double& get(size_t index, size_t row, size_t col);
+  const double& get(size_t index, size_t row, size_t col) const;
+  void set(size_t index, size_t row, size_t col, const double& value);
+
+  Matrix getMatrix(size_t index) const;
+  // Throws SizeMismatchException unless matrix has the batch shape
+  void setMatrix(size_t index, const Matrix& matrix);
+
+  /*
+   * Matrix k of the result is a[k] * b[k]. Throws SizeMismatchException
+   * when the batches differ in size or the shapes do not chain.
+   */
+  static MatrixBatch multiply(const MatrixBatch& a, const MatrixBatch& b);
+
+  // Determinant of every matrix; throws SizeMismatchException if not square
+  std::vector<double> det() const;
+  // Throws SingularMatrixException when any |det| < EPS
+  MatrixBatch inverse() const;
+  MatrixBatch transposed() const;
+
+ private:
+  size_t count;
+  size_t rows;
+  size_t cols;
+  // Lane array length: count rounded up to the kernel block
+  size_t stride;
+  double* data;
+
+  // Results every lane of which a kernel overwrites skip the initialization
+  struct Uninitialized {};
+  MatrixBatch(size_t count, size_t rows, size_t cols, Uninitialized);
+
+  void check_index(size_t index, size_t row, size_t col) const;
+};
+
+}  // namespace task
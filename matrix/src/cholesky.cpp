@@ -0,0 +1,187 @@
+#include "cholesky.h"
+
+#include <algorithm>  // min
+#include <cmath>      // sqrt
+
+#include "gemm.h"
+
+namespace task {
+
+namespace {
+
+// Width of the column panels factored before each trailing update
+const size_t PANEL = 64;
+
+}  // namespace
+
+CholeskyDecomposition::CholeskyDecomposition(const Matrix& a)
+    : CholeskyDecomposition(a, ExecutionPolicy::sequential()) {}
+
+CholeskyDecomposition::CholeskyDecomposition(const Matrix& a,
+                                             const ExecutionPolicy& policy)
+    : size(a.getRows()), l(a), bad_pivot(size) {
+  if (a.getRows() != a.getColumns()) {
+    throw SizeMismatchException();
+  }
+  factor(policy);
+}
+
+/*
+ * Right-looking blocked factorization: factor a panel of PANEL columns
+ * down to the last row, then update the trailing submatrix with
+ * A22 -= L21 * L21^T. gemm wants L21^T row-major, so it is copied out
+ * first. Only the lower half of A22 is read later, so the update runs
+ * one block row at a time, stopping at the diagonal block.
+ */
+void CholeskyDecomposition::factor(const ExecutionPolicy& policy) {
+  double* a = l.getRawArray();
+  size_t n = size;
+  std::vector<double> l21_t;
+
+  for (size_t k0 = 0; k0 < n; k0 += PANEL) {
+    size_t kb = std::min(PANEL, n - k0);
+    size_t k1 = k0 + kb;
+    if (!factor_panel(k0, kb)) return;
+    if (k1 == n) break;
+
+    size_t rest = n - k1;
+    l21_t.resize(kb * rest);
+    for (size_t i = 0; i < rest; ++i)
+      for (size_t j = 0; j < kb; ++j)
+        l21_t[j * rest + i] = a[(k1 + i) * n + k0 + j];
+
+    for (size_t r0 = 0; r0 < rest; r0 += PANEL) {
+      size_t rb = std::min(PANEL, rest - r0);
+      gemm(rb, r0 + rb, kb, -1., a + (k1 + r0) * n + k0, n, l21_t.data(),
+           rest, 1., a + (k1 + r0) * n + k1, n, policy);
+    }
+  }
+}
+
+/*
+ * Unblocked factorization of columns [k0, k0 + kb) over rows [k0, size),
+ * each column first updated by the panel columns left of it.
+ */
+bool CholeskyDecomposition::factor_panel(size_t k0, size_t kb) {
+  double* a = l.getRawArray();
+  size_t n = size;
+  size_t k1 = k0 + kb;
+
+  for (size_t j = k0; j < k1; ++j) {
+    const double* row_j = a + j * n;
+    double pivot = row_j[j];
+    for (size_t p = k0; p < j; ++p) pivot -= row_j[p] * row_j[p];
+    if (!(pivot >= EPS * EPS)) {
+      bad_pivot = j;
+      return false;
+    }
+    pivot = std::sqrt(pivot);
+    a[j * n + j] = pivot;
+
+    for (size_t i = j + 1; i < n; ++i) {
+      double* row_i = a + i * n;
+      double value = row_i[j];
+      for (size_t p = k0; p < j; ++p) value -= row_i[p] * row_j[p];
+      row_i[j] = value / pivot;
+    }
+  }
+  return true;
+}
+
+size_t CholeskyDecomposition::getSize() const { return size; }
+
+bool CholeskyDecomposition::isPositiveDefinite() const {
+  return bad_pivot == size;
+}
+
+double CholeskyDecomposition::det() const {
+  if (!isPositiveDefinite()) {
+    throw SingularMatrixException();
+  }
+
+  const double* a = l.getRawArray();
+  double det = 1.;
+  for (size_t i = 0; i < size; ++i) {
+    det *= a[i * size + i] * a[i * size + i];
+  }
+  return det;
+}
+
+void CholeskyDecomposition::solve_in_place(double* x, size_t nrhs) const {
+  if (!isPositiveDefinite()) {
+    throw SingularMatrixException();
+  }
+
+  const double* a = l.getRawArray();
+  size_t n = size;
+
+  // L * Y = B, row by row so every update streams whole rows of X
+  for (size_t i = 0; i < n; ++i) {
+    double* x_i = x + i * nrhs;
+    for (size_t j = 0; j < i; ++j) {
+      double l_ij = a[i * n + j];
+      const double* x_j = x + j * nrhs;
+      for (size_t c = 0; c < nrhs; ++c) {
+        x_i[c] -= l_ij * x_j[c];
+      }
+    }
+    double l_ii = a[i * n + i];
+    for (size_t c = 0; c < nrhs; ++c) {
+      x_i[c] /= l_ii;
+    }
+  }
+
+  // L^T * X = Y: row j of X, once final, is pushed into the rows above it
+  for (size_t j = n; j-- > 0;) {
+    double* x_j = x + j * nrhs;
+    double l_jj = a[j * n + j];
+    for (size_t c = 0; c < nrhs; ++c) {
+      x_j[c] /= l_jj;
+    }
+    for (size_t i = 0; i < j; ++i) {
+      double l_ji = a[j * n + i];
+      double* x_i = x + i * nrhs;
+      for (size_t c = 0; c < nrhs; ++c) {
+        x_i[c] -= l_ji * x_j[c];
+      }
+    }
+  }
+}
+
+Matrix CholeskyDecomposition::solve(const Matrix& b) const {
+  if (b.getRows() != size) {
+    throw SizeMismatchException();
+  }
+
+  Matrix x(b);
+  solve_in_place(x.getRawArray(), x.getColumns());
+  return x;
+}
+
+std::vector<double> CholeskyDecomposition::solve(
+    const std::vector<double>& b) const {
+  if (b.size() != size) {
+    throw SizeMismatchException();
+  }
+
+  std::vector<double> x(b);
+  solve_in_place(x.data(), 1);
+  return x;
+}
+
+Matrix CholeskyDecomposition::inverse() const {
+  Matrix x(size, size);
+  solve_in_place(x.getRawArray(), size);
+  return x;
+}
+
+Matrix CholeskyDecomposition::getL() const {
+  Matrix result(size, size, Matrix::Uninitialized());
+  const double* a = l.getRawArray();
+  for (size_t i = 0; i < size; ++i)
+    for (size_t j = 0; j < size; ++j)
+      result.set(i, j, (j <= i) ? a[i * size + j] : 0.);
+  return result;
+}
+
+}  // namespace task
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "matrix.h"
+
+namespace task {
+
+/*
+ * Cholesky factorization A = L * L^T of a symmetric positive definite
+ * matrix, computed once into its own buffer; only the lower triangle of A
+ * is read. Half the work of LUDecomposition and no pivoting. The matrix is
+ * factored in column panels and the trailing submatrix is updated through
+ * gemm, so most of the work runs in the blocked kernel.
+ */
+class CholeskyDecomposition {
+ public:
+  explicit CholeskyDecomposition(const Matrix& a);
+  CholeskyDecomposition(const Matrix& a, const ExecutionPolicy& policy);
+
+  size_t getSize() const;
+  // False if a pivot came out below EPS, i.e. A is not positive definite
+  bool isPositiveDefinite() const;
+
+  /*
+   * det() and the solvers throw SingularMatrixException when A is not
+   * positive definite; solve() throws SizeMismatchException when B has a
+   * different number of rows. Solves A * X = B for every column of B.
+   */
+  double det() const;
+
+  Matrix solve(const Matrix& b) const;
+  std::vector<double> solve(const std::vector<double>& b) const;
+  Matrix inverse() const;
+
+  Matrix getL() const;
+
+ private:
+  size_t size;
+  Matrix l;
+  // Index of the first failed pivot, size if there is none
+  size_t bad_pivot;
+
+  void factor(const ExecutionPolicy& policy);
+  // False when a pivot of the panel fails
+  bool factor_panel(size_t k0, size_t kb);
+  void solve_in_place(double* x, size_t nrhs) const;
+};
+
+}  // namespace task
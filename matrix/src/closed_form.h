@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+
+namespace task {
+namespace closed_form {
+
+/*
+ * Determinant and inverse of N x N matrices, N = 1 .. 4, by cofactor
+ * expansion. Shared by FixedMatrix and the MatrixBatch lane kernels: a(k)
+ * reads element k of the row-major input and b(k) refers to element k of
+ * the result, so callers can pass strided accessors without gathering
+ * into a local array. Always inlined, so the lane loops still vectorize.
+ */
+#define TASK_CLOSED_FORM_INLINE inline __attribute__((always_inline))
+
+// Largest order with closed forms
+constexpr size_t MAX_ORDER = 4;
+
+/*
+ * 2x2 minors of the top two rows (s) and the bottom two rows (c) of a
+ * 4x4 matrix; det and adjugate are sums of their products.
+ */
+template <class T>
+struct Minors4 {
+  T s0, s1, s2, s3, s4, s5;
+  T c0, c1, c2, c3, c4, c5;
+
+  constexpr T det() const {
+    return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+  }
+};
+
+template <class T, class In>
+constexpr TASK_CLOSED_FORM_INLINE Minors4<T> minors4(const In& a) {
+  return {a(0) * a(5) - a(4) * a(1),    a(0) * a(6) - a(4) * a(2),
+          a(0) * a(7) - a(4) * a(3),    a(1) * a(6) - a(5) * a(2),
+          a(1) * a(7) - a(5) * a(3),    a(2) * a(7) - a(6) * a(3),
+          a(8) * a(13) - a(12) * a(9),  a(8) * a(14) - a(12) * a(10),
+          a(8) * a(15) - a(12) * a(11), a(9) * a(14) - a(13) * a(10),
+          a(9) * a(15) - a(13) * a(11), a(10) * a(15) - a(14) * a(11)};
+}
+
+template <size_t N, class T, class In>
+constexpr TASK_CLOSED_FORM_INLINE T det(const In& a) {
+  static_assert(N >= 1 && N <= MAX_ORDER, "no closed form for this order");
+  if constexpr (N == 1) {
+    return a(0);
+  } else if constexpr (N == 2) {
+    return a(0) * a(3) - a(1) * a(2);
+  } else if constexpr (N == 3) {
+    return a(0) * (a(4) * a(8) - a(5) * a(7)) -
+           a(1) * (a(3) * a(8) - a(5) * a(6)) +
+           a(2) * (a(3) * a(7) - a(4) * a(6));
+  } else {
+    return minors4<T>(a).det();
+  }
+}
+
+/*
+ * Writes the inverse of a into b and returns the determinant. Nothing is
+ * checked: a singular a gives infinities or NaNs in b, so callers test the
+ * returned determinant.
+ */
+template <size_t N, class T, class In, class Out>
+constexpr TASK_CLOSED_FORM_INLINE T inverse(const In& a, const Out& b) {
+  static_assert(N >= 1 && N <= MAX_ORDER, "no closed form for this order");
+  if constexpr (N == 1) {
+    b(0) = T(1) / a(0);
+    return a(0);
+  } else if constexpr (N == 2) {
+    T d = det<2, T>(a);
+    T r = T(1) / d;
+    b(0) = a(3) * r;
+    b(1) = -a(1) * r;
+    b(2) = -a(2) * r;
+    b(3) = a(0) * r;
+    return d;
+  } else if constexpr (N == 3) {
+    T d = det<3, T>(a);
+    T r = T(1) / d;
+    b(0) = (a(4) * a(8) - a(5) * a(7)) * r;
+    b(1) = (a(2) * a(7) - a(1) * a(8)) * r;
+    b(2) = (a(1) * a(5) - a(2) * a(4)) * r;
+    b(3) = (a(5) * a(6) - a(3) * a(8)) * r;
+    b(4) = (a(0) * a(8) - a(2) * a(6)) * r;
+    b(5) = (a(2) * a(3) - a(0) * a(5)) * r;
+    b(6) = (a(3) * a(7) - a(4) * a(6)) * r;
+    b(7) = (a(1) * a(6) - a(0) * a(7)) * r;
+    b(8) = (a(0) * a(4) - a(1) * a(3)) * r;
+    return d;
+  } else {
+    Minors4<T> m = minors4<T>(a);
+    T d = m.det();
+    T r = T(1) / d;
+    b(0) = (a(5) * m.c5 - a(6) * m.c4 + a(7) * m.c3) * r;
+    b(1) = (-a(1) * m.c5 + a(2) * m.c4 - a(3) * m.c3) * r;
+    b(2) = (a(13) * m.s5 - a(14) * m.s4 + a(15) * m.s3) * r;
+    b(3) = (-a(9) * m.s5 + a(10) * m.s4 - a(11) * m.s3) * r;
+    b(4) = (-a(4) * m.c5 + a(6) * m.c2 - a(7) * m.c1) * r;
+    b(5) = (a(0) * m.c5 - a(2) * m.c2 + a(3) * m.c1) * r;
+    b(6) = (-a(12) * m.s5 + a(14) * m.s2 - a(15) * m.s1) * r;
+    b(7) = (a(8) * m.s5 - a(10) * m.s2 + a(11) * m.s1) * r;
+    b(8) = (a(4) * m.c4 - a(5) * m.c2 + a(7) * m.c0) * r;
+    b(9) = (-a(0) * m.c4 + a(1) * m.c2 - a(3) * m.c0) * r;
+    b(10) = (a(12) * m.s4 - a(13) * m.s2 + a(15) * m.s0) * r;
+    b(11) = (-a(8) * m.s4 + a(9) * m.s2 - a(11) * m.s0) * r;
+    b(12) = (-a(4) * m.c3 + a(5) * m.c1 - a(6) * m.c0) * r;
+    b(13) = (a(0) * m.c3 - a(1) * m.c1 + a(2) * m.c0) * r;
+    b(14) = (-a(12) * m.s3 + a(13) * m.s1 - a(14) * m.s0) * r;
+    b(15) = (a(8) * m.s3 - a(9) * m.s1 + a(10) * m.s0) * r;
+    return d;
+  }
+}
+
+#undef TASK_CLOSED_FORM_INLINE
+
+}  // namespace closed_form
+}  // namespace task
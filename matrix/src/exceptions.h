@@ -0,0 +1,12 @@
+#pragma once
+
+#include <exception>
+
+namespace task {
+
+class OutOfBoundsException : public std::exception {};
+class SizeMismatchException : public std::exception {};
+class SingularMatrixException : public std::exception {};
+class MatrixIOException : public std::exception {};
+
+}  // namespace task
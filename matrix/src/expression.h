@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+#include "exceptions.h"
+#include "simd.h"
+
+namespace task {
+
+class Matrix;
+
+/*
+ * CRTP base of everything that can appear in an element-wise Matrix
+ * expression. A concrete expression E provides
+ *   size_t getRows() const;
+ *   size_t getColumns() const;
+ *   double eval(size_t row, size_t col) const;
+ * Nodes are built lazily and evaluated in a single pass when assigned to a
+ * Matrix, so `a + b - c * 2.` allocates only the result. Operations that
+ * need a whole matrix, such as products and det(), evaluate a node first.
+ *
+ * Nodes keep Matrix operands by reference: a node must not outlive the
+ * matrices it was built from, so do not store one in `auto` when an
+ * operand is a temporary.
+ */
+template <class E>
+class MatrixExpression {
+ public:
+  const E& self() const { return static_cast<const E&>(*this); }
+
+  /*
+   * The value as a Matrix. Concrete expressions also have the element
+   * eval(row, col), so nodes bring this one in with a using-declaration.
+   */
+  Matrix eval() const;
+  // Through eval(), see Matrix; trace() reads the diagonal in place
+  double det() const;
+  double trace() const;
+  Matrix transposed() const;
+};
+
+/*
+ * Operands whose rows are plain arrays of doubles, which evaluate_into()
+ * hands to the simd kernels: each has a leaf_row(leaf, row) overload
+ * found by argument-dependent lookup.
+ */
+template <class E>
+struct ExpressionLeaf : std::false_type {};
+
+/*
+ * How a node stores its operand: matrices by reference, nested nodes by
+ * value (they are a couple of references and a scalar at most).
+ */
+template <class E>
+struct ExpressionOperand {
+  using type = const E;
+};
+
+template <>
+struct ExpressionOperand<Matrix> {
+  using type = const Matrix&;
+};
+
+struct PlusOp {
+  static double apply(double a, double b) { return a + b; }
+};
+
+struct MinusOp {
+  static double apply(double a, double b) { return a - b; }
+};
+
+template <class L, class R, class Op>
+class BinaryExpression : public MatrixExpression<BinaryExpression<L, R, Op>> {
+ public:
+  using MatrixExpression<BinaryExpression<L, R, Op>>::eval;
+
+  BinaryExpression(const L& lhs, const R& rhs) : lhs(lhs), rhs(rhs) {
+    if (lhs.getRows() != rhs.getRows() ||
+        lhs.getColumns() != rhs.getColumns()) {
+      throw SizeMismatchException();
+    }
+  }
+
+  size_t getRows() const { return lhs.getRows(); }
+  size_t getColumns() const { return lhs.getColumns(); }
+  double eval(size_t row, size_t col) const {
+    return Op::apply(lhs.eval(row, col), rhs.eval(row, col));
+  }
+
+  const L& left() const { return lhs; }
+  const R& right() const { return rhs; }
+
+ private:
+  typename ExpressionOperand<L>::type lhs;
+  typename ExpressionOperand<R>::type rhs;
+};
+
+template <class E>
+class ScaledExpression : public MatrixExpression<ScaledExpression<E>> {
+ public:
+  using MatrixExpression<ScaledExpression<E>>::eval;
+
+  ScaledExpression(const E& operand, double factor)
+      : operand(operand), factor(factor) {}
+
+  size_t getRows() const { return operand.getRows(); }
+  size_t getColumns() const { return operand.getColumns(); }
+  double eval(size_t row, size_t col) const {
+    return operand.eval(row, col) * factor;
+  }
+
+  const E& inner() const { return operand; }
+  double getFactor() const { return factor; }
+
+ private:
+  typename ExpressionOperand<E>::type operand;
+  double factor;
+};
+
+template <class E>
+class NegatedExpression : public MatrixExpression<NegatedExpression<E>> {
+ public:
+  using MatrixExpression<NegatedExpression<E>>::eval;
+
+  explicit NegatedExpression(const E& operand) : operand(operand) {}
+
+  size_t getRows() const { return operand.getRows(); }
+  size_t getColumns() const { return operand.getColumns(); }
+  double eval(size_t row, size_t col) const {
+    return -operand.eval(row, col);
+  }
+
+  const E& inner() const { return operand; }
+
+ private:
+  typename ExpressionOperand<E>::type operand;
+};
+
+/*
+ * Writes every element of e to the row-major block dst with leading
+ * dimension ld. Element (r, c) only reads element (r, c) of the operands,
+ * so dst may be one of them, but not a shifted view of one.
+ */
+template <class E>
+void evaluate_into(double* dst, size_t ld, const MatrixExpression<E>& e) {
+  const E& expr = e.self();
+  size_t rows = expr.getRows();
+  size_t cols = expr.getColumns();
+  for (size_t r = 0; r < rows; ++r) {
+    double* dst_row = dst + r * ld;
+    for (size_t c = 0; c < cols; ++c) {
+      dst_row[c] = expr.eval(r, c);
+    }
+  }
+}
+
+/*
+ * Single operations on leaves go to the simd kernels a row at a time.
+ * They work in place, so the row of the left operand is copied into dst
+ * first unless dst already holds it; the result is the same as the loop
+ * above, element for element.
+ */
+template <class L, class R>
+std::enable_if_t<ExpressionLeaf<L>::value && ExpressionLeaf<R>::value>
+evaluate_into(double* dst, size_t ld,
+              const MatrixExpression<BinaryExpression<L, R, PlusOp>>& e) {
+  const BinaryExpression<L, R, PlusOp>& expr = e.self();
+  size_t cols = expr.getColumns();
+  for (size_t r = 0; r < expr.getRows(); ++r) {
+    double* dst_row = dst + r * ld;
+    const double* a = leaf_row(expr.left(), r);
+    const double* b = leaf_row(expr.right(), r);
+    if (dst_row == b) {
+      simd::add(dst_row, a, cols);
+      continue;
+    }
+    if (dst_row != a) std::copy(a, a + cols, dst_row);
+    simd::add(dst_row, b, cols);
+  }
+}
+
+template <class L, class R>
+std::enable_if_t<ExpressionLeaf<L>::value && ExpressionLeaf<R>::value>
+evaluate_into(double* dst, size_t ld,
+              const MatrixExpression<BinaryExpression<L, R, MinusOp>>& e) {
+  const BinaryExpression<L, R, MinusOp>& expr = e.self();
+  size_t cols = expr.getColumns();
+  for (size_t r = 0; r < expr.getRows(); ++r) {
+    double* dst_row = dst + r * ld;
+    const double* a = leaf_row(expr.left(), r);
+    const double* b = leaf_row(expr.right(), r);
+    if (dst_row == b && dst_row != a) {
+      // a - b is exactly -b + a
+      simd::negate(dst_row, dst_row, cols);
+      simd::add(dst_row, a, cols);
+      continue;
+    }
+    if (dst_row != a) std::copy(a, a + cols, dst_row);
+    simd::sub(dst_row, b, cols);
+  }
+}
+
+template <class E>
+std::enable_if_t<ExpressionLeaf<E>::value> evaluate_into(
+    double* dst, size_t ld, const MatrixExpression<ScaledExpression<E>>& e) {
+  const ScaledExpression<E>& expr = e.self();
+  size_t cols = expr.getColumns();
+  for (size_t r = 0; r < expr.getRows(); ++r) {
+    double* dst_row = dst + r * ld;
+    const double* a = leaf_row(expr.inner(), r);
+    if (dst_row != a) std::copy(a, a + cols, dst_row);
+    simd::scale(dst_row, expr.getFactor(), cols);
+  }
+}
+
+template <class E>
+std::enable_if_t<ExpressionLeaf<E>::value> evaluate_into(
+    double* dst, size_t ld, const MatrixExpression<NegatedExpression<E>>& e) {
+  const NegatedExpression<E>& expr = e.self();
+  for (size_t r = 0; r < expr.getRows(); ++r) {
+    simd::negate(dst + r * ld, leaf_row(expr.inner(), r), expr.getColumns());
+  }
+}
+
+template <class L, class R>
+BinaryExpression<L, R, PlusOp> operator+(const MatrixExpression<L>& a,
+                                         const MatrixExpression<R>& b) {
+  return BinaryExpression<L, R, PlusOp>(a.self(), b.self());
+}
+
+template <class L, class R>
+BinaryExpression<L, R, MinusOp> operator-(const MatrixExpression<L>& a,
+                                          const MatrixExpression<R>& b) {
+  return BinaryExpression<L, R, MinusOp>(a.self(), b.self());
+}
+
+template <class E>
+ScaledExpression<E> operator*(const MatrixExpression<E>& a, double factor) {
+  return ScaledExpression<E>(a.self(), factor);
+}
+
+template <class E>
+ScaledExpression<E> operator*(double factor, const MatrixExpression<E>& a) {
+  return ScaledExpression<E>(a.self(), factor);
+}
+
+template <class E>
+NegatedExpression<E> operator-(const MatrixExpression<E>& a) {
+  return NegatedExpression<E>(a.self());
+}
+
+/*
+ * Compares element by element within eps without materializing either
+ * side. Matrices of different shape are not equal.
+ */
+template <class L, class R>
+bool equal_within(const MatrixExpression<L>& a, const MatrixExpression<R>& b,
+                  double eps) {
+  const L& lhs = a.self();
+  const R& rhs = b.self();
+  if (lhs.getRows() != rhs.getRows() || lhs.getColumns() != rhs.getColumns()) {
+    return false;
+  }
+  for (size_t r = 0; r < lhs.getRows(); ++r) {
+    for (size_t c = 0; c < lhs.getColumns(); ++c) {
+      double diff = lhs.eval(r, c) - rhs.eval(r, c);
+      if (diff > eps || diff < -eps) return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace task
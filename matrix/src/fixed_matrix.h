@@ -0,0 +1,311 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+
+#include "closed_form.h"
+#include "exceptions.h"
+#include "matrix.h"
+
+namespace task {
+
+/*
+ * Matrix with dimensions fixed at compile time and storage inside the
+ * object, for the 2x2 .. 4x4 matrices of hot loops: nothing here touches
+ * the allocator. Indexing through operator() and operator[] is unchecked,
+ * get() and set() check bounds like Matrix does.
+ *
+ * Multiplication loops have compile-time trip counts and are unrolled;
+ * det() and inverse() use the closed forms of closed_form.h up to 4x4 and
+ * Gaussian elimination on a local copy beyond that.
+ */
+template <size_t R, size_t C, class T = double>
+class FixedMatrix {
+  static_assert(R > 0 && C > 0, "FixedMatrix dimensions must be positive");
+
+ public:
+  // Ones on the main diagonal, zeros elsewhere, as Matrix(rows, cols)
+  constexpr FixedMatrix() {
+    for (size_t i = 0; i < R && i < C; ++i) data[i * C + i] = T(1);
+  }
+
+  // Row-major values, missing ones are zero
+  constexpr FixedMatrix(std::initializer_list<T> values) {
+    size_t i = 0;
+    for (const T& value : values) {
+      if (i == R * C) break;
+      data[i++] = value;
+    }
+  }
+
+  explicit FixedMatrix(const Matrix& m) {
+    if (m.getRows() != R || m.getColumns() != C) {
+      throw SizeMismatchException();
+    }
+    const double* src = m.view().getRawArray();
+    for (size_t i = 0; i < R * C; ++i) data[i] = static_cast<T>(src[i]);
+  }
+
+  static constexpr FixedMatrix zero() {
+    FixedMatrix m;
+    for (size_t i = 0; i < R * C; ++i) m.data[i] = T(0);
+    return m;
+  }
+
+  static constexpr size_t getRows() { return R; }
+  static constexpr size_t getColumns() { return C; }
+
+  constexpr T& operator()(size_t row, size_t col) {
+    return data[row * C + col];
+  }
+  constexpr const T& operator()(size_t row, size_t col) const {
+    return data[row * C + col];
+  }
+
+  constexpr T* operator[](size_t row) { return data + row * C; }
+  constexpr const T* operator[](size_t row) const { return data + row * C; }
+
+  constexpr T& get(size_t row, size_t col) {
+    check_bound(row, col);
+    return data[row * C + col];
+  }
+  constexpr const T& get(size_t row, size_t col) const {
+    check_bound(row, col);
+    return data[row * C + col];
+  }
+  constexpr void set(size_t row, size_t col, const T& value) {
+    check_bound(row, col);
+    data[row * C + col] = value;
+  }
+
+  constexpr T* getRawArray() { return data; }
+  constexpr const T* getRawArray() const { return data; }
+
+  Matrix toMatrix() const {
+    Matrix m(R, C);
+    double* dst = m.getRawArray();
+    for (size_t i = 0; i < R * C; ++i) dst[i] = static_cast<double>(data[i]);
+    return m;
+  }
+
+  constexpr FixedMatrix& operator+=(const FixedMatrix& a) {
+    for (size_t i = 0; i < R * C; ++i) data[i] += a.data[i];
+    return *this;
+  }
+
+  constexpr FixedMatrix& operator-=(const FixedMatrix& a) {
+    for (size_t i = 0; i < R * C; ++i) data[i] -= a.data[i];
+    return *this;
+  }
+
+  constexpr FixedMatrix& operator*=(const T& number) {
+    for (size_t i = 0; i < R * C; ++i) data[i] *= number;
+    return *this;
+  }
+
+  // Only square right operands keep the shape
+  constexpr FixedMatrix& operator*=(const FixedMatrix<C, C, T>& a) {
+    return *this = *this * a;
+  }
+
+  constexpr FixedMatrix operator+(const FixedMatrix& a) const {
+    FixedMatrix m(*this);
+    return m += a;
+  }
+
+  constexpr FixedMatrix operator-(const FixedMatrix& a) const {
+    FixedMatrix m(*this);
+    return m -= a;
+  }
+
+  constexpr FixedMatrix operator*(const T& number) const {
+    FixedMatrix m(*this);
+    return m *= number;
+  }
+
+  template <size_t K>
+  constexpr FixedMatrix<R, K, T> operator*(
+      const FixedMatrix<C, K, T>& a) const {
+    FixedMatrix<R, K, T> m = FixedMatrix<R, K, T>::zero();
+#pragma GCC unroll 16
+    for (size_t i = 0; i < R; ++i) {
+#pragma GCC unroll 16
+      for (size_t p = 0; p < C; ++p) {
+        T a_ip = data[i * C + p];
+#pragma GCC unroll 16
+        for (size_t j = 0; j < K; ++j) m(i, j) += a_ip * a(p, j);
+      }
+    }
+    return m;
+  }
+
+  constexpr FixedMatrix operator-() const {
+    FixedMatrix m(*this);
+    for (size_t i = 0; i < R * C; ++i) m.data[i] = -m.data[i];
+    return m;
+  }
+
+  constexpr FixedMatrix operator+() const { return *this; }
+
+  constexpr bool operator==(const FixedMatrix& a) const {
+    for (size_t i = 0; i < R * C; ++i) {
+      T diff = data[i] - a.data[i];
+      if (diff > EPS || diff < -EPS) return false;
+    }
+    return true;
+  }
+
+  constexpr bool operator!=(const FixedMatrix& a) const {
+    return !(*this == a);
+  }
+
+  constexpr FixedMatrix<C, R, T> transposed() const {
+    FixedMatrix<C, R, T> m;
+    for (size_t i = 0; i < R; ++i)
+      for (size_t j = 0; j < C; ++j) m(j, i) = data[i * C + j];
+    return m;
+  }
+
+  constexpr T trace() const {
+    static_assert(R == C, "trace() needs a square matrix");
+    T s = T(0);
+    for (size_t i = 0; i < R; ++i) s += data[i * C + i];
+    return s;
+  }
+
+  constexpr T det() const {
+    static_assert(R == C, "det() needs a square matrix");
+    if constexpr (R <= closed_form::MAX_ORDER) {
+      return closed_form::det<R, T>(element());
+    } else {
+      return det_elimination();
+    }
+  }
+
+  /*
+   * Throws SingularMatrixException when |det| < EPS.
+   */
+  constexpr FixedMatrix inverse() const {
+    static_assert(R == C, "inverse() needs a square matrix");
+    if constexpr (R <= closed_form::MAX_ORDER) {
+      FixedMatrix m;
+      T* b = m.data;
+      check_invertible(closed_form::inverse<R, T>(
+          element(), [b](size_t k) -> T& { return b[k]; }));
+      return m;
+    } else {
+      return inverse_elimination();
+    }
+  }
+
+ private:
+  T data[R * C] = {};
+
+  constexpr void check_bound(size_t row, size_t col) const {
+    if (row >= R || col >= C) {
+      throw OutOfBoundsException();
+    }
+  }
+
+  static constexpr void check_invertible(const T& det) {
+    if (det < EPS && det > -EPS) {
+      throw SingularMatrixException();
+    }
+  }
+
+  // Reads element k in row-major order, for the closed forms
+  constexpr auto element() const {
+    const T* a = data;
+    return [a](size_t k) { return a[k]; };
+  }
+
+  static constexpr T abs(const T& value) { return value < 0 ? -value : value; }
+
+  // Same elimination rule as Matrix::det(), on a local copy
+  constexpr T det_elimination() const {
+    FixedMatrix m(*this);
+    T det = T(1);
+    for (size_t i = 0; i < R; ++i) {
+      size_t pivot = i;
+      for (size_t k = i + 1; k < R; ++k) {
+        if (abs(m(k, i)) > abs(m(pivot, i))) pivot = k;
+      }
+      if (pivot != i) {
+        for (size_t j = 0; j < C; ++j) {
+          T tmp = m(i, j);
+          m(i, j) = m(pivot, j);
+          m(pivot, j) = tmp;
+        }
+        det = -det;
+      }
+      T value = m(i, i);
+      if (i + 1 < R && abs(value) < EPS) return T(0);
+      for (size_t r = i + 1; r < R; ++r) {
+        T k = m(r, i) / value;
+        for (size_t j = i; j < C; ++j) m(r, j) -= k * m(i, j);
+      }
+      det *= value;
+    }
+    return det;
+  }
+
+  // Gauss-Jordan with partial pivoting, on a local copy
+  constexpr FixedMatrix inverse_elimination() const {
+    FixedMatrix m(*this);
+    FixedMatrix inv;
+    for (size_t i = 0; i < R; ++i) {
+      size_t pivot = i;
+      for (size_t k = i + 1; k < R; ++k) {
+        if (abs(m(k, i)) > abs(m(pivot, i))) pivot = k;
+      }
+      check_invertible(m(pivot, i));
+      if (pivot != i) {
+        for (size_t j = 0; j < C; ++j) {
+          T tmp = m(i, j);
+          m(i, j) = m(pivot, j);
+          m(pivot, j) = tmp;
+          tmp = inv(i, j);
+          inv(i, j) = inv(pivot, j);
+          inv(pivot, j) = tmp;
+        }
+      }
+      T value = m(i, i);
+      for (size_t j = 0; j < C; ++j) {
+        m(i, j) /= value;
+        inv(i, j) /= value;
+      }
+      for (size_t r = 0; r < R; ++r) {
+        if (r == i) continue;
+        T k = m(r, i);
+        for (size_t j = 0; j < C; ++j) {
+          m(r, j) -= k * m(i, j);
+          inv(r, j) -= k * inv(i, j);
+        }
+      }
+    }
+    return inv;
+  }
+};
+
+template <size_t R, size_t C, class T>
+constexpr FixedMatrix<R, C, T> operator*(const T& a,
+                                         const FixedMatrix<R, C, T>& b) {
+  return b * a;
+}
+
+template <size_t R, size_t C, class T>
+std::ostream& operator<<(std::ostream& output,
+                         const FixedMatrix<R, C, T>& matrix) {
+  output.precision(12);
+  for (size_t i = 0; i < R; ++i)
+    for (size_t j = 0; j < C; ++j) output << " " << matrix(i, j);
+  output << std::endl;
+  return output;
+}
+
+using Matrix2 = FixedMatrix<2, 2>;
+using Matrix3 = FixedMatrix<3, 3>;
+using Matrix4 = FixedMatrix<4, 4>;
+
+}  // namespace task
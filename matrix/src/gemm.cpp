@@ -0,0 +1,325 @@
+#include "gemm.h"
+
+#include <algorithm>  // fill && max && min
+#include <vector>
+
+#include "simd.h"
+
+namespace task {
+
+namespace {
+
+/*
+ * Register tile of the micro-kernel: MR x NR accumulators live in registers
+ * for the whole kc loop.
+ */
+const size_t MR = 4;
+const size_t NR = 8;
+
+/*
+ * Cache blocking: a KC x NR sliver of packed B stays in L1, an MC x KC panel
+ * of packed A stays in L2, a KC x NC panel of packed B stays in L3.
+ */
+const size_t KC = 256;
+const size_t MC = 96;
+const size_t NC = 2048;
+
+// Products smaller than this are cheaper without packing
+const size_t SMALL_VOLUME = 32 * 32 * 32;
+
+// Elements of A each gemv/gevm task reads, enough to amortize the handoff
+const size_t VECTOR_TASK = 1 << 15;
+// Widest gevm column strip, whose slice of y stays in L1
+const size_t GEVM_STRIP = 512;
+// Narrowest one, a few cache lines of every row of A
+const size_t GEVM_MIN_STRIP = 64;
+
+/*
+ * Packing buffers are kept per thread and only grow, so repeated products
+ * do not go through the allocator.
+ */
+double* packed_a_buffer(size_t size) {
+  thread_local std::vector<double> buffer;
+  if (buffer.size() < size) buffer.resize(size);
+  return buffer.data();
+}
+
+/*
+ * Per-thread buffer for data read by every task of a call, such as packed
+ * B. The calling thread may run other queued work in the meantime, so a
+ * call nested on the same thread gets a buffer of its own. Each Use has
+ * its own buffer.
+ */
+enum class BufferUse { PackedB };
+
+template <BufferUse Use>
+class ThreadBuffer {
+ public:
+  explicit ThreadBuffer(size_t size) {
+    thread_local std::vector<double> buffer;
+    thread_local bool busy = false;
+    if (busy) {
+      own.resize(size);
+      buffer_data = own.data();
+      return;
+    }
+    if (buffer.size() < size) buffer.resize(size);
+    buffer_data = buffer.data();
+    busy_flag = &busy;
+    busy = true;
+  }
+  ~ThreadBuffer() {
+    if (busy_flag) *busy_flag = false;
+  }
+
+  ThreadBuffer(const ThreadBuffer&) = delete;
+  ThreadBuffer& operator=(const ThreadBuffer&) = delete;
+
+  double* data() const { return buffer_data; }
+
+ private:
+  double* buffer_data = nullptr;
+  std::vector<double> own;
+  bool* busy_flag = nullptr;
+};
+
+void gemm_small(size_t m, size_t n, size_t k, double alpha, const double* a,
+                size_t lda, const double* b, size_t ldb, double beta,
+                double* c, size_t ldc) {
+  for (size_t i = 0; i < m; ++i) {
+    double* c_row = c + i * ldc;
+    for (size_t j = 0; j < n; ++j) {
+      c_row[j] = (beta == 0.) ? 0. : beta * c_row[j];
+    }
+    for (size_t p = 0; p < k; ++p) {
+      double a_ip = alpha * a[i * lda + p];
+      const double* b_row = b + p * ldb;
+      for (size_t j = 0; j < n; ++j) {
+        c_row[j] += a_ip * b_row[j];
+      }
+    }
+  }
+}
+
+// Each element is a dot product summed in double, then rounded once
+void gemm_small_mixed(size_t m, size_t n, size_t k, double alpha,
+                      const float* a, size_t lda, const float* b, size_t ldb,
+                      double beta, float* c, size_t ldc) {
+  for (size_t i = 0; i < m; ++i) {
+    float* c_row = c + i * ldc;
+    for (size_t j = 0; j < n; ++j) {
+      double sum = 0.;
+      for (size_t p = 0; p < k; ++p) {
+        sum += static_cast<double>(a[i * lda + p]) * b[p * ldb + j];
+      }
+      double value = alpha * sum;
+      c_row[j] =
+          static_cast<float>((beta == 0.) ? value : value + beta * c_row[j]);
+    }
+  }
+}
+
+/*
+ * Packs an mc x kc block of A into MR-row slivers, each stored column by
+ * column, padding the last sliver with zeros.
+ */
+template <class T>
+void pack_a(size_t mc, size_t kc, const T* a, size_t lda, double* packed) {
+  for (size_t i = 0; i < mc; i += MR) {
+    size_t mr = std::min(MR, mc - i);
+    for (size_t r = 0; r < MR; ++r) {
+      const T* a_row = a + (i + r) * lda;
+      for (size_t p = 0; p < kc; ++p) {
+        packed[p * MR + r] = (r < mr) ? static_cast<double>(a_row[p]) : 0.;
+      }
+    }
+    packed += kc * MR;
+  }
+}
+
+/*
+ * Packs a kc x nc block of B into NR-column slivers, each stored row by row,
+ * padding the last sliver with zeros.
+ */
+template <class T>
+void pack_b(size_t kc, size_t nc, const T* b, size_t ldb, double* packed) {
+  for (size_t j = 0; j < nc; j += NR) {
+    size_t nr = std::min(NR, nc - j);
+    for (size_t p = 0; p < kc; ++p) {
+      const T* b_row = b + p * ldb + j;
+      for (size_t c = 0; c < NR; ++c) {
+        *packed++ = (c < nr) ? static_cast<double>(b_row[c]) : 0.;
+      }
+    }
+  }
+}
+
+/*
+ * Computes the MR x NR product of a packed A sliver and a packed B sliver.
+ * Fixed trip counts let the compiler keep acc in vector registers.
+ */
+void micro_kernel(size_t kc, const double* __restrict a,
+                  const double* __restrict b, double* __restrict acc) {
+  double c[MR * NR] = {};
+  for (size_t p = 0; p < kc; ++p) {
+    for (size_t i = 0; i < MR; ++i) {
+      double a_ip = a[p * MR + i];
+      for (size_t j = 0; j < NR; ++j) {
+        c[i * NR + j] += a_ip * b[p * NR + j];
+      }
+    }
+  }
+  for (size_t i = 0; i < MR * NR; ++i) {
+    acc[i] = c[i];
+  }
+}
+
+// Rounds to the storage type of C only here, after accumulating in double
+template <class T>
+void store_tile(size_t mr, size_t nr, const double* acc, double alpha,
+                double beta, T* c, size_t ldc) {
+  for (size_t i = 0; i < mr; ++i) {
+    T* c_row = c + i * ldc;
+    for (size_t j = 0; j < nr; ++j) {
+      double value = alpha * acc[i * NR + j];
+      c_row[j] = static_cast<T>((beta == 0.) ? value : value + beta * c_row[j]);
+    }
+  }
+}
+
+/*
+ * Packed panels are always double, whatever the storage type T of the
+ * operands: conversion happens while packing, which copies anyway.
+ */
+template <class T>
+void gemm_blocked(size_t m, size_t n, size_t k, double alpha, const T* a,
+                  size_t lda, const T* b, size_t ldb, double beta, T* c,
+                  size_t ldc, const ExecutionPolicy& policy) {
+  size_t nc_max = std::min(NC, (n + NR - 1) / NR * NR);
+  size_t kc_max = std::min(KC, k);
+  ThreadBuffer<BufferUse::PackedB> packed_b_buffer(kc_max * nc_max);
+  double* packed_b = packed_b_buffer.data();
+  size_t panels = (m + MC - 1) / MC;
+
+  for (size_t jc = 0; jc < n; jc += NC) {
+    size_t nc = std::min(NC, n - jc);
+    for (size_t pc = 0; pc < k; pc += KC) {
+      size_t kc = std::min(KC, k - pc);
+      // Only the first k-panel applies beta, the rest accumulate
+      double panel_beta = (pc == 0) ? beta : 1.;
+      pack_b(kc, nc, b + pc * ldb + jc, ldb, packed_b);
+
+      // Row panels of C are disjoint, so they can be computed concurrently
+      policy.parallel_for(panels, [&](size_t panel) {
+        size_t ic = panel * MC;
+        size_t mc = std::min(MC, m - ic);
+        double* packed_a = packed_a_buffer((mc + MR - 1) / MR * MR * kc);
+        double acc[MR * NR];
+        pack_a(mc, kc, a + ic * lda + pc, lda, packed_a);
+
+        for (size_t jr = 0; jr < nc; jr += NR) {
+          size_t nr = std::min(NR, nc - jr);
+          const double* b_sliver = packed_b + jr * kc;
+          for (size_t ir = 0; ir < mc; ir += MR) {
+            size_t mr = std::min(MR, mc - ir);
+            micro_kernel(kc, packed_a + ir * kc, b_sliver, acc);
+            store_tile(mr, nr, acc, alpha, panel_beta,
+                       c + (ic + ir) * ldc + jc + jr, ldc);
+          }
+        }
+      });
+    }
+  }
+}
+
+}  // namespace
+
+void gemm(size_t m, size_t n, size_t k, double alpha, const double* a,
+          size_t lda, const double* b, size_t ldb, double beta, double* c,
+          size_t ldc) {
+  gemm(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc,
+       ExecutionPolicy::sequential());
+}
+
+void gemm(size_t m, size_t n, size_t k, double alpha, const double* a,
+          size_t lda, const double* b, size_t ldb, double beta, double* c,
+          size_t ldc, const ExecutionPolicy& policy) {
+  if (m == 0 || n == 0) {
+    return;
+  }
+  if (k == 0 || m * n * k < SMALL_VOLUME) {
+    gemm_small(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    return;
+  }
+  gemm_blocked(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, policy);
+}
+
+void gemm(size_t m, size_t n, size_t k, double alpha, const float* a,
+          size_t lda, const float* b, size_t ldb, double beta, float* c,
+          size_t ldc, const ExecutionPolicy& policy) {
+  if (m == 0 || n == 0) {
+    return;
+  }
+  if (k == 0 || m * n * k < SMALL_VOLUME) {
+    gemm_small_mixed(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    return;
+  }
+  gemm_blocked(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, policy);
+}
+
+void gemv(size_t m, size_t n, double alpha, const double* a, size_t lda,
+          const double* x, double beta, double* y) {
+  gemv(m, n, alpha, a, lda, x, beta, y, ExecutionPolicy::sequential());
+}
+
+void gemv(size_t m, size_t n, double alpha, const double* a, size_t lda,
+          const double* x, double beta, double* y,
+          const ExecutionPolicy& policy) {
+  size_t strip = std::max<size_t>(1, VECTOR_TASK / std::max<size_t>(n, 1));
+  size_t strips = (m + strip - 1) / strip;
+  policy.parallel_for(strips, [&](size_t s) {
+    size_t end = std::min(m, (s + 1) * strip);
+    for (size_t i = s * strip; i < end; ++i) {
+      double value = alpha * simd::dot(a + i * lda, x, n);
+      y[i] = (beta == 0.) ? value : value + beta * y[i];
+    }
+  });
+}
+
+void gevm(size_t m, size_t n, double alpha, const double* x, const double* a,
+          size_t lda, double beta, double* y) {
+  gevm(m, n, alpha, x, a, lda, beta, y, ExecutionPolicy::sequential());
+}
+
+void gevm(size_t m, size_t n, double alpha, const double* x, const double* a,
+          size_t lda, double beta, double* y, const ExecutionPolicy& policy) {
+  if (n == 0) {
+    return;
+  }
+
+  /*
+   * Column strips: every task walks all rows over its slice of y, so each
+   * value of y is summed in row order whatever the strip width. Narrow
+   * matrices get narrower strips to keep the threads busy.
+   */
+  size_t threads = policy.getThreads();
+  size_t width = std::max((n + threads - 1) / threads,
+                          VECTOR_TASK / std::max<size_t>(m, 1));
+  width = std::min(GEVM_STRIP, std::max(GEVM_MIN_STRIP, (width + 7) / 8 * 8));
+  size_t strips = (n + width - 1) / width;
+  policy.parallel_for(strips, [&](size_t s) {
+    size_t begin = s * width;
+    size_t strip_width = std::min(width, n - begin);
+    double* y_strip = y + begin;
+    if (beta == 0.) {
+      std::fill(y_strip, y_strip + strip_width, 0.);
+    } else if (beta != 1.) {
+      simd::scale(y_strip, beta, strip_width);
+    }
+    for (size_t i = 0; i < m; ++i) {
+      simd::axpy(y_strip, alpha * x[i], a + i * lda + begin, strip_width);
+    }
+  });
+}
+
+}  // namespace task
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+
+#include "thread_pool.h"
+
+namespace task {
+
+/*
+ * Blocked matrix multiplication for row-major operands:
+ *   C = alpha * A * B + beta * C
+ * A is m x k with leading dimension lda, B is k x n with leading dimension
+ * ldb, C is m x n with leading dimension ldc. When beta == 0 the contents of
+ * C are never read, so C may point to uninitialized memory.
+ */
+void gemm(size_t m, size_t n, size_t k, double alpha, const double* a,
+          size_t lda, const double* b, size_t ldb, double beta, double* c,
+          size_t ldc);
+
+/*
+ * Same as above, with the row panels of C spread over the threads of
+ * policy. Every element of C is computed by exactly one task, in the same
+ * order as the sequential version.
+ */
+void gemm(size_t m, size_t n, size_t k, double alpha, const double* a,
+          size_t lda, const double* b, size_t ldb, double beta, double* c,
+          size_t ldc, const ExecutionPolicy& policy);
+
+/*
+ * Mixed precision: float storage, double accumulation. Operands are widened
+ * while packing and C is rounded to float once per KC-deep slice of the
+ * inner dimension, so the result is as accurate as the double product
+ * rounded a handful of times, while the operands cost half the bandwidth.
+ */
+void gemm(size_t m, size_t n, size_t k, double alpha, const float* a,
+          size_t lda, const float* b, size_t ldb, double beta, float* c,
+          size_t ldc, const ExecutionPolicy& policy);
+
+/*
+ * Matrix-vector product y = alpha * A * x + beta * y for the m x n
+ * row-major A with leading dimension lda; x has n values, y has m. Each
+ * value of y is one SIMD dot product with a row of A; row strips of tall
+ * matrices are spread over the threads of policy. y is not read when
+ * beta == 0. No allocation.
+ */
+void gemv(size_t m, size_t n, double alpha, const double* a, size_t lda,
+          const double* x, double beta, double* y);
+void gemv(size_t m, size_t n, double alpha, const double* a, size_t lda,
+          const double* x, double beta, double* y,
+          const ExecutionPolicy& policy);
+
+/*
+ * Vector-matrix product y = alpha * x^T * A + beta * y, i.e. A^T * x
+ * without transposing: rows of A are added to y scaled by x, streaming A
+ * once. x has m values, y has n. Column strips of y are spread over the
+ * threads of policy; every value is summed in row order, so results do not
+ * depend on the thread count. No allocation.
+ */
+void gevm(size_t m, size_t n, double alpha, const double* x, const double* a,
+          size_t lda, double beta, double* y);
+void gevm(size_t m, size_t n, double alpha, const double* x, const double* a,
+          size_t lda, double beta, double* y, const ExecutionPolicy& policy);
+
+}  // namespace task
@@ -0,0 +1,177 @@
+#include "instrumentation.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace task {
+namespace instrumentation {
+
+namespace {
+
+const size_t COUNT = static_cast<size_t>(Operation::Count);
+
+/*
+ * Counters of one thread. Only the owner writes them; atomics with relaxed
+ * order let snapshot() read them meanwhile at the cost of plain moves.
+ */
+struct ThreadCounters {
+  std::atomic<uint64_t> calls[COUNT] = {};
+  std::atomic<uint64_t> bytes[COUNT] = {};
+  std::atomic<uint64_t> cycles[COUNT] = {};
+
+  ThreadCounters();
+  ~ThreadCounters();
+};
+
+void add(std::atomic<uint64_t>& counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+/*
+ * Live threads' counters, plus the totals of threads that have exited,
+ * which fold theirs in on the way out.
+ */
+struct Registry {
+  std::mutex mutex;
+  std::vector<ThreadCounters*> threads;
+  Snapshot retired;
+};
+
+Registry& registry() {
+  // Never destroyed: threads may still exit after static destruction
+  static Registry* r = new Registry();
+  return *r;
+}
+
+void accumulate(Snapshot& total, const ThreadCounters& counters) {
+  for (size_t i = 0; i < COUNT; ++i) {
+    total.operations[i].calls +=
+        counters.calls[i].load(std::memory_order_relaxed);
+    total.operations[i].bytes +=
+        counters.bytes[i].load(std::memory_order_relaxed);
+    total.operations[i].cycles +=
+        counters.cycles[i].load(std::memory_order_relaxed);
+  }
+}
+
+ThreadCounters::ThreadCounters() {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.threads.push_back(this);
+}
+
+ThreadCounters::~ThreadCounters() {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  accumulate(r.retired, *this);
+  for (size_t i = 0; i < r.threads.size(); ++i) {
+    if (r.threads[i] == this) {
+      r.threads[i] = r.threads.back();
+      r.threads.pop_back();
+      break;
+    }
+  }
+}
+
+ThreadCounters& local() {
+  thread_local ThreadCounters counters;
+  return counters;
+}
+
+}  // namespace
+
+const char* operationName(Operation operation) {
+  switch (operation) {
+    case Operation::Construct:
+      return "construct";
+    case Operation::Copy:
+      return "copy";
+    case Operation::Move:
+      return "move";
+    case Operation::Allocate:
+      return "allocate";
+    case Operation::Resize:
+      return "resize";
+    case Operation::Multiply:
+      return "multiply";
+    case Operation::Det:
+      return "det";
+    case Operation::DetCached:
+      return "det_cached";
+    case Operation::Transpose:
+      return "transpose";
+    case Operation::Power:
+      return "pow";
+    case Operation::Exponential:
+      return "expm";
+    case Operation::Count:
+      break;
+  }
+  return "unknown";
+}
+
+void record(Operation operation, uint64_t bytes, uint64_t cycles) {
+  ThreadCounters& counters = local();
+  size_t i = static_cast<size_t>(operation);
+  add(counters.calls[i], 1);
+  add(counters.bytes[i], bytes);
+  add(counters.cycles[i], cycles);
+}
+
+uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+Snapshot snapshot() {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  Snapshot total = r.retired;
+  for (const ThreadCounters* counters : r.threads) {
+    accumulate(total, *counters);
+  }
+  return total;
+}
+
+void reset() {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.retired = Snapshot();
+  for (ThreadCounters* counters : r.threads) {
+    for (size_t i = 0; i < COUNT; ++i) {
+      counters->calls[i].store(0, std::memory_order_relaxed);
+      counters->bytes[i].store(0, std::memory_order_relaxed);
+      counters->cycles[i].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void writeJson(std::ostream& output) { writeJson(output, snapshot()); }
+
+void writeJson(std::ostream& output, const Snapshot& snapshot) {
+  output << "{\"enabled\": " << (MATRIX_INSTRUMENTATION ? "true" : "false")
+         << ", \"operations\": {";
+  for (size_t i = 0; i < COUNT; ++i) {
+    const OperationStats& stats = snapshot.operations[i];
+    output << (i ? ", " : "") << "\"" << operationName(Operation(i))
+           << "\": {\"calls\": " << stats.calls
+           << ", \"bytes\": " << stats.bytes
+           << ", \"cycles\": " << stats.cycles << "}";
+  }
+  output << "}}" << std::endl;
+}
+
+}  // namespace instrumentation
+}  // namespace task
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+/*
+ * Counters on the hot paths of Matrix, compiled in with
+ * -DMATRIX_INSTRUMENTATION=1 in every translation unit. Off by default, in
+ * which case the hooks below expand to nothing and the counters stay zero.
+ */
+#ifndef MATRIX_INSTRUMENTATION
+#define MATRIX_INSTRUMENTATION 0
+#endif
+
+namespace task {
+namespace instrumentation {
+
+enum class Operation {
+  // Matrix objects created, whatever the constructor
+  Construct,
+  // Copy construction and assignment; bytes copied
+  Copy,
+  Move,
+  // Heap blocks taken from storage::allocate(); bytes requested
+  Allocate,
+  Resize,
+  // Matrix::multiply, behind operator* and operator*=; bytes of the result
+  Multiply,
+  // det() calls that factor the matrix, and those served from the cache
+  Det,
+  DetCached,
+  Transpose,
+  Power,
+  Exponential,
+  Count
+};
+
+const char* operationName(Operation operation);
+
+struct OperationStats {
+  uint64_t calls = 0;
+  uint64_t bytes = 0;
+  // Time-stamp counter ticks spent inside, for timed operations
+  uint64_t cycles = 0;
+};
+
+struct Snapshot {
+  OperationStats operations[static_cast<size_t>(Operation::Count)];
+
+  const OperationStats& operator[](Operation operation) const {
+    return operations[static_cast<size_t>(operation)];
+  }
+};
+
+// Totals over all threads, including ones that have exited
+Snapshot snapshot();
+// Counts recorded by other threads while it runs may survive it
+void reset();
+/*
+ * {"enabled": ..., "operations": {"multiply": {"calls": ..., "bytes": ...,
+ * "cycles": ...}, ...}}
+ */
+void writeJson(std::ostream& output);
+void writeJson(std::ostream& output, const Snapshot& snapshot);
+
+/*
+ * Hooks behind the macros. Counters are per thread, so recording is a
+ * couple of uncontended stores.
+ */
+void record(Operation operation, uint64_t bytes, uint64_t cycles);
+uint64_t cycles();
+
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Operation operation, uint64_t bytes = 0)
+      : operation(operation), bytes(bytes), start(cycles()) {}
+  ~ScopedTimer() { record(operation, bytes, cycles() - start); }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  Operation operation;
+  uint64_t bytes;
+  uint64_t start;
+};
+
+}  // namespace instrumentation
+}  // namespace task
+
+#define MATRIX_CONCAT_IMPL(a, b) a##b
+#define MATRIX_CONCAT(a, b) MATRIX_CONCAT_IMPL(a, b)
+
+#if MATRIX_INSTRUMENTATION
+// Counts one call of operation moving bytes
+#define MATRIX_COUNT(operation, bytes)                                      \
+  ::task::instrumentation::record(::task::instrumentation::Operation::     \
+                                      operation,                            \
+                                  (bytes), 0)
+// Counts one call and times the rest of the enclosing scope
+#define MATRIX_TIME(operation, bytes)                                       \
+  ::task::instrumentation::ScopedTimer MATRIX_CONCAT(matrix_timer_,         \
+                                                     __LINE__)(             \
+      ::task::instrumentation::Operation::operation, (bytes))
+#else
+#define MATRIX_COUNT(operation, bytes) ((void)0)
+#define MATRIX_TIME(operation, bytes) ((void)0)
+#endif
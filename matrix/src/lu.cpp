@@ -0,0 +1,208 @@
+#include "lu.h"
+
+#include <algorithm>  // min && swap_ranges
+#include <cmath>      // fabs
+
+#include "gemm.h"
+
+namespace task {
+
+namespace {
+
+// Width of the column panels factored before each trailing update
+const size_t PANEL = 64;
+
+}  // namespace
+
+LUDecomposition::LUDecomposition(const Matrix& a)
+    : LUDecomposition(a, ExecutionPolicy::sequential()) {}
+
+LUDecomposition::LUDecomposition(const Matrix& a,
+                                 const ExecutionPolicy& policy)
+    : size(a.getRows()), lu(a), pivots(a.getRows()), small_pivot(size) {
+  if (a.getRows() != a.getColumns()) {
+    throw SizeMismatchException();
+  }
+  factor(policy);
+}
+
+/*
+ * Right-looking blocked factorization: factor a panel of PANEL columns,
+ * apply its row swaps and L11^-1 to the block row on the right, then
+ * update the trailing submatrix with A22 -= L21 * U12.
+ */
+void LUDecomposition::factor(const ExecutionPolicy& policy) {
+  double* a = lu.getRawArray();
+  size_t n = size;
+
+  for (size_t k0 = 0; k0 < n; k0 += PANEL) {
+    size_t kb = std::min(PANEL, n - k0);
+    size_t k1 = k0 + kb;
+    factor_panel(k0, kb);
+    if (k1 == n) break;
+
+    // U12 = L11^-1 * A12, forward substitution with the unit diagonal
+    for (size_t j = k0; j < k1; ++j) {
+      const double* row_j = a + j * n;
+      for (size_t i = j + 1; i < k1; ++i) {
+        double* row_i = a + i * n;
+        double l_ij = row_i[j];
+        for (size_t c = k1; c < n; ++c) {
+          row_i[c] -= l_ij * row_j[c];
+        }
+      }
+    }
+
+    gemm(n - k1, n - k1, kb, -1., a + k1 * n + k0, n, a + k0 * n + k1, n, 1.,
+         a + k1 * n + k1, n, policy);
+  }
+}
+
+/*
+ * Unblocked elimination of columns [k0, k0 + kb) over rows [k0, size).
+ * Row swaps are applied to whole rows, the elimination only to the panel.
+ */
+void LUDecomposition::factor_panel(size_t k0, size_t kb) {
+  double* a = lu.getRawArray();
+  size_t n = size;
+  size_t k1 = k0 + kb;
+
+  for (size_t j = k0; j < k1; ++j) {
+    size_t pivot_row = j;
+    double max_value = std::fabs(a[j * n + j]);
+    for (size_t i = j + 1; i < n; ++i) {
+      double value = std::fabs(a[i * n + j]);
+      if (value > max_value) {
+        pivot_row = i;
+        max_value = value;
+      }
+    }
+
+    pivots[j] = pivot_row;
+    if (pivot_row != j) {
+      std::swap_ranges(a + j * n, a + (j + 1) * n, a + pivot_row * n);
+      odd_swaps = !odd_swaps;
+    }
+
+    if (max_value < EPS) {
+      if (small_pivot == n) small_pivot = j;
+      continue;
+    }
+
+    const double* row_j = a + j * n;
+    double pivot = row_j[j];
+    for (size_t i = j + 1; i < n; ++i) {
+      double* row_i = a + i * n;
+      double l_ij = row_i[j] / pivot;
+      row_i[j] = l_ij;
+      for (size_t c = j + 1; c < k1; ++c) {
+        row_i[c] -= l_ij * row_j[c];
+      }
+    }
+  }
+}
+
+size_t LUDecomposition::getSize() const { return size; }
+
+bool LUDecomposition::isSingular() const { return small_pivot < size; }
+
+double LUDecomposition::det() const {
+  // As Gaussian elimination did, only the pivots it divides by are
+  // checked against EPS; the last one is taken as is
+  if (small_pivot + 1 < size) return 0.;
+
+  const double* a = lu.getRawArray();
+  double det = odd_swaps ? -1. : 1.;
+  for (size_t i = 0; i < size; ++i) {
+    det *= a[i * size + i];
+  }
+  return det;
+}
+
+void LUDecomposition::solve_in_place(double* x, size_t nrhs) const {
+  if (isSingular()) {
+    throw SingularMatrixException();
+  }
+
+  const double* a = lu.getRawArray();
+  size_t n = size;
+
+  for (size_t i = 0; i < n; ++i) {
+    if (pivots[i] != i) {
+      std::swap_ranges(x + i * nrhs, x + (i + 1) * nrhs, x + pivots[i] * nrhs);
+    }
+  }
+
+  // L * Y = P * B, row by row so every update streams whole rows of X
+  for (size_t i = 0; i < n; ++i) {
+    double* x_i = x + i * nrhs;
+    for (size_t j = 0; j < i; ++j) {
+      double l_ij = a[i * n + j];
+      const double* x_j = x + j * nrhs;
+      for (size_t c = 0; c < nrhs; ++c) {
+        x_i[c] -= l_ij * x_j[c];
+      }
+    }
+  }
+
+  // U * X = Y
+  for (size_t i = n; i-- > 0;) {
+    double* x_i = x + i * nrhs;
+    for (size_t j = i + 1; j < n; ++j) {
+      double u_ij = a[i * n + j];
+      const double* x_j = x + j * nrhs;
+      for (size_t c = 0; c < nrhs; ++c) {
+        x_i[c] -= u_ij * x_j[c];
+      }
+    }
+    double u_ii = a[i * n + i];
+    for (size_t c = 0; c < nrhs; ++c) {
+      x_i[c] /= u_ii;
+    }
+  }
+}
+
+Matrix LUDecomposition::solve(const Matrix& b) const {
+  if (b.getRows() != size) {
+    throw SizeMismatchException();
+  }
+
+  Matrix x(b);
+  solve_in_place(x.getRawArray(), x.getColumns());
+  return x;
+}
+
+std::vector<double> LUDecomposition::solve(const std::vector<double>& b) const {
+  if (b.size() != size) {
+    throw SizeMismatchException();
+  }
+
+  std::vector<double> x(b);
+  solve_in_place(x.data(), 1);
+  return x;
+}
+
+Matrix LUDecomposition::inverse() const {
+  Matrix x(size, size);
+  solve_in_place(x.getRawArray(), size);
+  return x;
+}
+
+Matrix LUDecomposition::getL() const {
+  Matrix l(size, size);
+  const double* a = lu.getRawArray();
+  for (size_t i = 0; i < size; ++i)
+    for (size_t j = 0; j < i; ++j) l.set(i, j, a[i * size + j]);
+  return l;
+}
+
+Matrix LUDecomposition::getU() const {
+  Matrix u(size, size, Matrix::Uninitialized());
+  const double* a = lu.getRawArray();
+  for (size_t i = 0; i < size; ++i)
+    for (size_t j = 0; j < size; ++j)
+      u.set(i, j, (j >= i) ? a[i * size + j] : 0.);
+  return u;
+}
+
+}  // namespace task
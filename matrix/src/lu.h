@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "matrix.h"
+
+namespace task {
+
+/*
+ * LU factorization with partial pivoting, P * A = L * U, computed once
+ * into its own buffer. L is unit lower triangular and shares storage with
+ * U. The matrix is factored in column panels and the trailing submatrix
+ * is updated through gemm, so most of the work runs in the blocked kernel.
+ */
+class LUDecomposition {
+ public:
+  explicit LUDecomposition(const Matrix& a);
+  LUDecomposition(const Matrix& a, const ExecutionPolicy& policy);
+
+  size_t getSize() const;
+  // True if some pivot is smaller than EPS
+  bool isSingular() const;
+
+  double det() const;
+
+  /*
+   * Solves A * X = B for every column of B. Throws SizeMismatchException
+   * when B has a different number of rows, SingularMatrixException when
+   * A is singular.
+   */
+  Matrix solve(const Matrix& b) const;
+  std::vector<double> solve(const std::vector<double>& b) const;
+  Matrix inverse() const;
+
+  Matrix getL() const;
+  Matrix getU() const;
+
+ private:
+  size_t size;
+  Matrix lu;
+  // Row i was swapped with row pivots[i] at step i
+  std::vector<size_t> pivots;
+  bool odd_swaps = false;
+  // Index of the first pivot below EPS, size if there is none
+  size_t small_pivot;
+
+  void factor(const ExecutionPolicy& policy);
+  void factor_panel(size_t k0, size_t kb);
+  // Overwrites the size x nrhs row-major block x with A^-1 * x
+  void solve_in_place(double* x, size_t nrhs) const;
+};
+
+}  // namespace task
@@ -1,9 +1,70 @@
 #include "matrix.h"
 
-#include <cmath>  // fabs && swap
+#include <algorithm>  // copy && min && swap
+#include <cmath>      // fabs && frexp && ldexp
+
+#include "gemm.h"
+#include "lu.h"
+#include "simd.h"
+#include "strassen.h"
+#include "transpose.h"
 
 using namespace task;
 
+namespace {
+
+// Rows of the source each transposed() task handles
+const size_t TRANSPOSE_STRIP = 64;
+
+/*
+ * Pade approximants of e^x used by expm(): coefficients of degree 3, 5, 7,
+ * 9 and 13, and the largest 1-norm for which each is accurate to double
+ * precision, from Higham, "The Scaling and Squaring Method for the Matrix
+ * Exponential Revisited", 2005.
+ */
+const double PADE3[] = {120., 60., 12., 1.};
+const double PADE5[] = {30240., 15120., 3360., 420., 30., 1.};
+const double PADE7[] = {17297280., 8648640., 1995840., 277200.,
+                        25200.,    1512.,    56.,      1.};
+const double PADE9[] = {17643225600., 8821612800., 2075673600., 302702400.,
+                        30270240.,    2162160.,    110880.,     3960.,
+                        90.,          1.};
+const double PADE13[] = {64764752532480000., 32382376266240000.,
+                         7771770303897600.,  1187353796428800.,
+                         129060195264000.,   10559470521600.,
+                         670442572800.,      33522128640.,
+                         1323241920.,        40840800.,
+                         960960.,            16380.,
+                         182.,               1.};
+const double THETA3 = 1.495585217958292e-2;
+const double THETA5 = 2.539398330063230e-1;
+const double THETA7 = 9.504178996162932e-1;
+const double THETA9 = 2.097847961257068;
+const double THETA13 = 5.371920351148152;
+
+// c = a * b on n x n matrices, into the existing storage of c
+void square_product(size_t n, const double* a, const double* b, double* c,
+                    const ExecutionPolicy& policy) {
+  size_t cutoff = strassen_cutoff();
+  if (cutoff != 0 && n >= cutoff) {
+    strassen(n, a, n, b, n, c, n, cutoff, policy);
+  } else {
+    gemm(n, n, n, 1., a, n, b, n, 0., c, n, policy);
+  }
+}
+
+double norm1(const Matrix& a) {
+  double norm = 0.;
+  for (size_t j = 0; j < a.getColumns(); ++j) {
+    double sum = 0.;
+    for (size_t i = 0; i < a.getRows(); ++i) sum += std::fabs(a(i, j));
+    norm = std::max(norm, sum);
+  }
+  return norm;
+}
+
+}  // namespace
+
 /*
  * Private methods
  */
@@ -19,29 +80,38 @@ void Matrix::check_size(const Matrix& a) const {
   }
 }
 
+double* Matrix::allocate(size_t size) {
+  if (size <= SMALL_SIZE) return small;
+  MATRIX_COUNT(Allocate, size * sizeof(double));
+  return storage::allocate(size);
+}
+
+void Matrix::release() {
+  if (array != small) storage::release(array);
+}
+
 void Matrix::copy_array(const Matrix& from_array) {
   rows = from_array.getRows();
   cols = from_array.getColumns();
-  array = new double[rows * cols];
-  for (size_t r = 0; r < rows; r++) {
-    for (size_t c = 0; c < cols; c++) {
-      array[r * cols + c] = from_array.getRawArray()[r * cols + c];
-    }
-  }
+  array = allocate(rows * cols);
+  std::copy(from_array.array, from_array.array + rows * cols, array);
+  MATRIX_COUNT(Copy, rows * cols * sizeof(double));
 }
 
 /*
  * Constructors
  */
 Matrix::Matrix() {
-  array = new double[rows * cols];
+  MATRIX_COUNT(Construct, 0);
+  array = allocate(rows * cols);
   array[0] = 1;
 }
 
 Matrix::Matrix(size_t rows, size_t cols) {
+  MATRIX_COUNT(Construct, 0);
   this->rows = rows;
   this->cols = cols;
-  array = new double[rows * cols];
+  array = allocate(rows * cols);
   for (size_t r = 0; r < rows; ++r) {
     for (size_t c = 0; c < cols; ++c) {
       array[r * cols + c] = (rows == cols && r == c) ? 1 : 0;
@@ -49,17 +119,41 @@ Matrix::Matrix(size_t rows, size_t cols) {
   }
 }
 
-Matrix::Matrix(const Matrix& copy) { copy_array(copy); }
+Matrix::Matrix(size_t rows, size_t cols, Uninitialized) {
+  MATRIX_COUNT(Construct, 0);
+  this->rows = rows;
+  this->cols = cols;
+  array = allocate(rows * cols);
+}
 
-Matrix::Row::Row(Matrix& matrix, size_t row) : matrix(matrix), row(row) {}
+Matrix::Matrix(const Matrix& copy) {
+  MATRIX_COUNT(Construct, 0);
+  copy_array(copy);
+}
+
+Matrix::Matrix(Matrix&& other) noexcept
+    : rows(other.rows), cols(other.cols), array(other.array) {
+  MATRIX_COUNT(Construct, 0);
+  MATRIX_COUNT(Move, 0);
+  // Inline elements cannot be stolen, they are few enough to copy
+  if (other.array == other.small) {
+    std::copy(other.small, other.small + rows * cols, small);
+    array = small;
+  }
+  other.modified();
+  other.rows = 0;
+  other.cols = 0;
+  other.array = nullptr;
+}
 
-Matrix::Row::Row(const Matrix& matrix, size_t row) : matrix(matrix), row(row) {}
+Matrix::NoAlias::NoAlias(Matrix& matrix) : matrix(matrix) {}
 
 /*
  * Public methods
  */
 double& Matrix::get(size_t row, size_t col) {
   check_bound(row, col);
+  modified();
   return array[row * cols + col];
 }
 
@@ -70,23 +164,34 @@ const double& Matrix::get(size_t row, size_t col) const {
 
 void Matrix::set(size_t row, size_t col, const double& value) {
   check_bound(row, col);
+  modified();
   array[row * cols + col] = value;
 }
 
 void Matrix::resize(size_t new_rows, size_t new_cols) {
-  double* new_array = new double[new_rows * new_cols];
+  MATRIX_COUNT(Resize, new_rows * new_cols * sizeof(double));
+  modified();
+  double* new_array = allocate(new_rows * new_cols);
+
+  // Both shapes fit in the small buffer: read from a copy of it
+  double old_small[SMALL_SIZE];
+  const double* old_array = array;
+  if (new_array == array) {
+    std::copy(array, array + rows * cols, old_small);
+    old_array = old_small;
+  }
 
   for (size_t r = 0; r < new_rows; ++r) {
     for (size_t c = 0; c < new_cols; ++c) {
       new_array[r * new_cols + c] =
-          (r < rows && c < cols) ? array[r * cols + c] : 0;
+          (r < rows && c < cols) ? old_array[r * cols + c] : 0;
     }
   }
 
   rows = new_rows;
   cols = new_cols;
 
-  delete[] array;
+  if (new_array != array) release();
   array = new_array;
 }
 
@@ -99,118 +204,147 @@ task::Matrix& Matrix::operator=(const Matrix& a) {
     return *this;
   }
 
-  delete[] array;
+  modified();
+  // Same number of elements: overwrite in place instead of reallocating
+  if (rows * cols == a.getRows() * a.getColumns()) {
+    rows = a.getRows();
+    cols = a.getColumns();
+    std::copy(a.array, a.array + rows * cols, array);
+    MATRIX_COUNT(Copy, rows * cols * sizeof(double));
+    return *this;
+  }
+
+  release();
   copy_array(a);
   return *this;
 }
 
+task::Matrix& Matrix::operator=(Matrix&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  MATRIX_COUNT(Move, 0);
+  modified();
+  other.modified();
+  release();
+  rows = other.rows;
+  cols = other.cols;
+  array = other.array;
+  if (other.array == other.small) {
+    std::copy(other.small, other.small + rows * cols, small);
+    array = small;
+  }
+  other.rows = 0;
+  other.cols = 0;
+  other.array = nullptr;
+  return *this;
+}
+
 task::Matrix& Matrix::operator+=(const Matrix& a) {
   check_size(a);
-  for (size_t i = 0; i < rows * cols; ++i) {
-    array[i] += a.getRawArray()[i];
-  }
+  modified();
+  simd::add(array, a.array, rows * cols);
 
   return *this;
 }
 
 task::Matrix& Matrix::operator-=(const Matrix& a) {
   check_size(a);
-  for (size_t i = 0; i < rows * cols; ++i) {
-    array[i] -= a.getRawArray()[i];
-  }
+  modified();
+  simd::sub(array, a.array, rows * cols);
 
   return *this;
 }
 
-task::Matrix& Matrix::operator*=(const Matrix& a) {
+task::Matrix& Matrix::operator*=(const ConstMatrixView& a) {
   if (cols != a.getRows()) {
     throw SizeMismatchException();
   }
 
-  Matrix old_matrix(*this);
-
-  this->resize(rows, a.getColumns());
-
-  for (size_t i = 0; i < rows; ++i) {
-    for (size_t j = 0; j < a.getColumns(); ++j) {
-      array[i * a.getColumns() + j] = 0;
-      for (size_t k = 0; k < old_matrix.getColumns(); ++k)
-        array[i * a.getColumns() + j] += old_matrix[i][k] * a[k][j];
-    }
-  }
-
+  *this = multiply(*this, a, ExecutionPolicy::sequential());
   return *this;
 }
 
 task::Matrix& Matrix::operator*=(const double& number) {
-  for (size_t i = 0; i < rows * cols; ++i) array[i] *= number;
+  modified();
+  simd::scale(array, number, rows * cols);
 
   return *this;
 }
 
-task::Matrix Matrix::operator+(const Matrix& a) const {
-  Matrix m(*this);
-  m += a;
-  return m;
+task::Matrix task::operator*(const ConstMatrixView& a,
+                             const ConstMatrixView& b) {
+  return Matrix::multiply(a, b, ExecutionPolicy::sequential());
 }
 
-task::Matrix Matrix::operator-(const Matrix& a) const {
-  Matrix m(*this);
-  m -= a;
-  return m;
+void task::gemv(const ConstMatrixView& a, const std::vector<double>& x,
+                std::vector<double>& y) {
+  gemv(a, x, y, ExecutionPolicy::sequential());
 }
 
-task::Matrix Matrix::operator*(const Matrix& a) const {
-  Matrix m(*this);
-  m *= a;
-  return m;
+void task::gemv(const ConstMatrixView& a, const std::vector<double>& x,
+                std::vector<double>& y, const ExecutionPolicy& policy) {
+  if (x.size() != a.getColumns() || y.size() != a.getRows()) {
+    throw SizeMismatchException();
+  }
+  gemv(a.getRows(), a.getColumns(), 1., a.getRawArray(),
+       a.getLeadingDimension(), x.data(), 0., y.data(), policy);
 }
 
-task::Matrix Matrix::operator*(const double& a) const {
-  Matrix m(*this);
-  m *= a;
-  return m;
+void task::gevm(const std::vector<double>& x, const ConstMatrixView& a,
+                std::vector<double>& y) {
+  gevm(x, a, y, ExecutionPolicy::sequential());
+}
+
+void task::gevm(const std::vector<double>& x, const ConstMatrixView& a,
+                std::vector<double>& y, const ExecutionPolicy& policy) {
+  if (x.size() != a.getRows() || y.size() != a.getColumns()) {
+    throw SizeMismatchException();
+  }
+  gevm(a.getRows(), a.getColumns(), 1., x.data(), a.getRawArray(),
+       a.getLeadingDimension(), 0., y.data(), policy);
 }
 
-task::Matrix task::operator*(const double& a, const Matrix& b) { return b * a; }
+std::vector<double> task::operator*(const ConstMatrixView& a,
+                                    const std::vector<double>& x) {
+  std::vector<double> y(a.getRows());
+  gemv(a, x, y);
+  return y;
+}
+
+std::vector<double> task::operator*(const std::vector<double>& x,
+                                    const ConstMatrixView& a) {
+  std::vector<double> y(a.getColumns());
+  gevm(x, a, y);
+  return y;
+}
 
 bool Matrix::operator==(const Matrix& a) const {
-  for (size_t i = 0; i < rows * cols; ++i) {
-    double tmp = array[i] - a.getRawArray()[i];
-    if (std::fabs(tmp) > task::EPS) return false;
+  if (rows != a.rows || cols != a.cols) {
+    return false;
   }
-  return true;
+  return simd::equal(array, a.array, rows * cols, task::EPS);
 }
 
 bool Matrix::operator!=(const Matrix& a) const { return !(*this == a); }
 
-task::Matrix Matrix::operator-() const {
-  Matrix m(*this);
-  m *= -1.;
-  return m;
-}
-
 task::Matrix Matrix::operator+() const { return Matrix(*this); }
 
-task::Matrix::Row Matrix::operator[](size_t row) {
-  if (row > rows) {
-    throw OutOfBoundsException();
-  }
-  return Row(*this, row);
-}
+task::Matrix::NoAlias Matrix::noalias() { return NoAlias(*this); }
 
-task::Matrix::Row Matrix::operator[](size_t row) const {
-  if (row > rows) {
-    throw OutOfBoundsException();
-  }
-  return Row(*this, row);
+task::MatrixView Matrix::view() { return MatrixView(*this); }
+
+task::ConstMatrixView Matrix::view() const { return ConstMatrixView(*this); }
+
+task::MatrixView Matrix::block(size_t row, size_t col, size_t block_rows,
+                               size_t block_cols) {
+  return view().block(row, col, block_rows, block_cols);
 }
 
-double& task::Matrix::Row::operator[](size_t col) {
-  if (col > matrix.cols) {
-    throw OutOfBoundsException();
-  }
-  return matrix.array[row * matrix.cols + col];
+task::ConstMatrixView Matrix::block(size_t row, size_t col, size_t block_rows,
+                                    size_t block_cols) const {
+  return view().block(row, col, block_rows, block_cols);
 }
 
 std::vector<double> Matrix::getRow(size_t row) {
@@ -225,7 +359,12 @@ std::vector<double> Matrix::getColumn(size_t column) {
 }
 
 // get access for raw data
-double* Matrix::getRawArray() const { return array; }
+double* Matrix::getRawArray() {
+  modified();
+  return array;
+}
+
+const double* Matrix::getRawArray() const { return array; }
 
 std::ostream& task::operator<<(std::ostream& output,
                                const task::Matrix& matrix) {
@@ -249,17 +388,49 @@ std::istream& task::operator>>(std::istream& input, task::Matrix& matrix) {
 }
 
 void Matrix::transpose() {
-  Matrix old_matrix(*this);
-  size_t old_rows = rows, old_cols = cols;
-  resize(cols, rows);
-  for (size_t i = 0; i < old_rows; ++i)
-    for (size_t j = 0; j < old_cols; ++j)
-      array[j * cols + i] = old_matrix.getRawArray()[i * old_cols + j];
+  MATRIX_TIME(Transpose, rows * cols * sizeof(double));
+  modified();
+  transpose_in_place(rows, cols, array);
+  std::swap(rows, cols);
 }
 
 task::Matrix Matrix::transposed() const {
-  Matrix m(*this);
-  m.transpose();
+  return transposed(ExecutionPolicy::sequential());
+}
+
+task::Matrix Matrix::transposed(const ExecutionPolicy& policy) const {
+  MATRIX_TIME(Transpose, rows * cols * sizeof(double));
+  Matrix m(cols, rows, Uninitialized());
+  size_t strips = (rows + TRANSPOSE_STRIP - 1) / TRANSPOSE_STRIP;
+  policy.parallel_for(strips, [&](size_t strip) {
+    size_t r_begin = strip * TRANSPOSE_STRIP;
+    size_t r_count = std::min(TRANSPOSE_STRIP, rows - r_begin);
+    transpose_copy(r_count, cols, array + r_begin * cols, cols,
+                   m.array + r_begin, rows);
+  });
+  return m;
+}
+
+task::Matrix Matrix::multiply(const ConstMatrixView& a,
+                              const ConstMatrixView& b,
+                              const ExecutionPolicy& policy) {
+  if (a.getColumns() != b.getRows()) {
+    throw SizeMismatchException();
+  }
+
+  MATRIX_TIME(Multiply, a.getRows() * b.getColumns() * sizeof(double));
+  Matrix m(a.getRows(), b.getColumns());
+  size_t n = a.getRows();
+  size_t cutoff = strassen_cutoff();
+  if (cutoff != 0 && n >= cutoff && a.getColumns() == n &&
+      b.getColumns() == n) {
+    strassen(n, a.getRawArray(), a.getLeadingDimension(), b.getRawArray(),
+             b.getLeadingDimension(), m.array, n, cutoff, policy);
+    return m;
+  }
+  gemm(a.getRows(), b.getColumns(), a.getColumns(), 1., a.getRawArray(),
+       a.getLeadingDimension(), b.getRawArray(), b.getLeadingDimension(), 0.,
+       m.array, b.getColumns(), policy);
   return m;
 }
 
@@ -274,42 +445,113 @@ double Matrix::trace() const {
   return s;
 }
 
-double Matrix::det() const {
+double Matrix::det() const { return det(ExecutionPolicy::sequential()); }
+
+double Matrix::det(const ExecutionPolicy& policy) const {
+  if (det_version.load(std::memory_order_acquire) == version) {
+    MATRIX_COUNT(DetCached, 0);
+    return det_value.load(std::memory_order_relaxed);
+  }
+  MATRIX_TIME(Det, 0);
+  double value = LUDecomposition(*this, policy).det();
+  det_value.store(value, std::memory_order_relaxed);
+  det_version.store(version, std::memory_order_release);
+  return value;
+}
+
+task::Matrix Matrix::pow(size_t k) const {
+  return pow(k, ExecutionPolicy::sequential());
+}
+
+task::Matrix Matrix::pow(size_t k, const ExecutionPolicy& policy) const {
+  MATRIX_TIME(Power, 0);
   if (rows != cols) {
     throw SizeMismatchException();
   }
+  if (k == 0) {
+    return Matrix(rows, cols);
+  }
 
-  double det = 1;
-
-  for (size_t i = 0; i < rows - 1; ++i) {
-    size_t max_col = i;
-    double max_value = std::fabs(array[i * cols + i]);
-    for (size_t k = i + 1; k < rows; ++k) {
-      double val = std::fabs(array[k * cols + i]);
-      if (val > max_value) {
-        max_col = k;
-        max_value = val;
-      }
-    }
-    if (max_col != i) {
-      for (size_t j = i; j < rows; ++j) {
-        std::swap(array[i * cols + j], array[max_col * cols + j]);
-      }
-      det = -det;
+  // Left to right over the bits of k: square, then multiply by A on a 1
+  size_t bit = size_t(1) << (sizeof(size_t) * 8 - 1);
+  while (!(k & bit)) bit >>= 1;
+  Matrix result(*this);
+  Matrix scratch(rows, cols, Uninitialized());
+  for (bit >>= 1; bit != 0; bit >>= 1) {
+    square_product(rows, result.array, result.array, scratch.array, policy);
+    std::swap(result, scratch);
+    if (k & bit) {
+      square_product(rows, result.array, array, scratch.array, policy);
+      std::swap(result, scratch);
     }
+  }
+  return result;
+}
 
-    double value = array[i * cols + i];
-    if (std::fabs(value) < EPS) return 0.0;
+task::Matrix Matrix::expm() const {
+  return expm(ExecutionPolicy::sequential());
+}
 
-    for (size_t r = i + 1; r < rows; ++r) {
-      double k = array[r * cols + i] / value;
-      for (size_t j = i; j < cols; j++) {
-        array[r * cols + j] -= k * array[i * cols + j];
-      }
+task::Matrix Matrix::expm(const ExecutionPolicy& policy) const {
+  MATRIX_TIME(Exponential, 0);
+  if (rows != cols) {
+    throw SizeMismatchException();
+  }
+  size_t n = rows;
+  double norm = norm1(*this);
+  Matrix identity(n, n);
+  Matrix a2 = multiply(*this, *this, policy);
+  Matrix u;
+  Matrix v;
+
+  // Numerator V + U and denominator V - U, U holding the odd powers
+  auto low_degree = [&](const double* b, size_t degree) {
+    Matrix odd = b[1] * identity + b[3] * a2;
+    v = b[0] * identity + b[2] * a2;
+    Matrix power = a2;
+    for (size_t j = 4; j <= degree; j += 2) {
+      power = multiply(power, a2, policy);
+      odd.noalias() += b[j + 1] * power;
+      v.noalias() += b[j] * power;
+    }
+    u = multiply(*this, odd, policy);
+  };
+
+  int squarings = 0;
+  if (norm <= THETA3) {
+    low_degree(PADE3, 3);
+  } else if (norm <= THETA5) {
+    low_degree(PADE5, 5);
+  } else if (norm <= THETA7) {
+    low_degree(PADE7, 7);
+  } else if (norm <= THETA9) {
+    low_degree(PADE9, 9);
+  } else {
+    // Scale A by 2^-s, which is exact, until its norm is below THETA13
+    if (norm > THETA13) {
+      std::frexp(norm / THETA13, &squarings);
     }
-    det *= value;
+    double scale = std::ldexp(1., -squarings);
+    Matrix a = *this * scale;
+    a2 *= scale * scale;
+    Matrix a4 = multiply(a2, a2, policy);
+    Matrix a6 = multiply(a4, a2, policy);
+    const double* b = PADE13;
+
+    Matrix inner = b[13] * a6 + b[11] * a4 + b[9] * a2;
+    Matrix odd = multiply(a6, inner, policy);
+    odd.noalias() += b[7] * a6 + b[5] * a4 + b[3] * a2 + b[1] * identity;
+    u = multiply(a, odd, policy);
+    inner = b[12] * a6 + b[10] * a4 + b[8] * a2;
+    v = multiply(a6, inner, policy);
+    v.noalias() += b[6] * a6 + b[4] * a4 + b[2] * a2 + b[0] * identity;
   }
 
-  det *= array[(rows - 1) * cols + cols - 1];
-  return det;
+  Matrix result = LUDecomposition(v - u, policy).solve(v + u);
+  Matrix scratch(n, n, Uninitialized());
+  for (int i = 0; i < squarings; ++i) {
+    square_product(n, result.array, result.array, scratch.array, policy);
+    std::swap(result, scratch);
+  }
+  return result;
 }
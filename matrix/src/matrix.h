@@ -1,89 +1,426 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <type_traits>
 #include <vector>
 
-namespace task {
+#include "exceptions.h"
+#include "expression.h"
+#include "instrumentation.h"
+#include "storage.h"
+#include "thread_pool.h"
+#include "view.h"
+
+/*
+ * Bounds checks of operator[] and operator(): on by default, compiled out
+ * with NDEBUG. Define MATRIX_BOUNDS_CHECK to 0 or 1 to override, the same
+ * way in every translation unit. get() and set() always check.
+ */
+#ifndef MATRIX_BOUNDS_CHECK
+#ifdef NDEBUG
+#define MATRIX_BOUNDS_CHECK 0
+#else
+#define MATRIX_BOUNDS_CHECK 1
+#endif
+#endif
 
-const double EPS = 1e-6;
+namespace task {
 
-class OutOfBoundsException : public std::exception {};
-class SizeMismatchException : public std::exception {};
+constexpr double EPS = 1e-6;
 
-class Matrix {
+class Matrix : public MatrixExpression<Matrix> {
  public:
   /*
-   * Proxy-class for matrix row
+   * Proxy-class for matrix row. Inline, so m[i][j] in a loop compiles to the
+   * same indexed load as operator(). A row of a non-const matrix drops its
+   * cached det() on each access, so a Row kept past det() is still seen.
    */
   class Row {
     friend class Matrix;
 
    private:
-    const Matrix& matrix;
-    const size_t row;
+    double* const data;
+    const size_t cols;
+    // nullptr for rows of a const matrix
+    Matrix* const matrix;
 
-    Row(Matrix& matrix, size_t row);
-    Row(const Matrix& matrix, size_t row);
+    Row(double* data, size_t cols, Matrix* matrix)
+        : data(data), cols(cols), matrix(matrix) {}
 
    public:
-    double& operator[](size_t col);
+    double& operator[](size_t col) const {
+      if (MATRIX_BOUNDS_CHECK && col >= cols) {
+        throw OutOfBoundsException();
+      }
+      if (matrix) {
+        matrix->modified();
+      }
+      return data[col];
+    }
   };
 
   Matrix();
   Matrix(size_t rows, size_t cols);
+  // Elements left uninitialized, for callers that overwrite all of them
+  struct Uninitialized {};
+  Matrix(size_t rows, size_t cols, Uninitialized);
   Matrix(const Matrix& copy);
   Matrix& operator=(const Matrix& a);
+  // Moved-from matrices are left empty (0 x 0)
+  Matrix(Matrix&& other) noexcept;
+  Matrix& operator=(Matrix&& other) noexcept;
+
+  /*
+   * Evaluates an element-wise expression in one pass. Assignment reuses
+   * the storage when the shape matches.
+   */
+  template <class E>
+  Matrix(const MatrixExpression<E>& e);
+  template <class E>
+  Matrix& operator=(const MatrixExpression<E>& e);
 
   double& get(size_t row, size_t col);
   const double& get(size_t row, size_t col) const;
   void set(size_t row, size_t col, const double& value);
   void resize(size_t new_rows, size_t new_cols);
 
-  Row operator[](size_t row);
-  Row operator[](size_t row) const;
+  Row operator[](size_t row) {
+    if (MATRIX_BOUNDS_CHECK && row >= rows) {
+      throw OutOfBoundsException();
+    }
+    return Row(array + row * cols, cols, this);
+  }
+  Row operator[](size_t row) const {
+    if (MATRIX_BOUNDS_CHECK && row >= rows) {
+      throw OutOfBoundsException();
+    }
+    return Row(array + row * cols, cols, nullptr);
+  }
+
+  // Fast element access for inner loops, checked as operator[] is
+  double& operator()(size_t row, size_t col) {
+    if (MATRIX_BOUNDS_CHECK && (row >= rows || col >= cols)) {
+      throw OutOfBoundsException();
+    }
+    modified();
+    return array[row * cols + col];
+  }
+  const double& operator()(size_t row, size_t col) const {
+    if (MATRIX_BOUNDS_CHECK && (row >= rows || col >= cols)) {
+      throw OutOfBoundsException();
+    }
+    return array[row * cols + col];
+  }
 
   Matrix& operator+=(const Matrix& a);
   Matrix& operator-=(const Matrix& a);
-  Matrix& operator*=(const Matrix& a);
+  Matrix& operator*=(const ConstMatrixView& a);
   Matrix& operator*=(const double& number);
+  template <class E>
+  Matrix& operator+=(const MatrixExpression<E>& e);
+  template <class E>
+  Matrix& operator-=(const MatrixExpression<E>& e);
 
-  Matrix operator+(const Matrix& a) const;
-  Matrix operator-(const Matrix& a) const;
-  Matrix operator*(const Matrix& a) const;
-  Matrix operator*(const double& a) const;
-
-  Matrix operator-() const;
+  // +, - and scalar * build lazy expressions, see expression.h
   Matrix operator+() const;
 
+  /*
+   * Proxy for assigning into the existing storage of the matrix, never
+   * reallocating: m.noalias() = a + b * 2.; throws SizeMismatchException
+   * when the shape differs.
+   */
+  class NoAlias {
+    friend class Matrix;
+
+   private:
+    Matrix& matrix;
+
+    explicit NoAlias(Matrix& matrix);
+
+   public:
+    template <class E>
+    NoAlias& operator=(const MatrixExpression<E>& e);
+    template <class E>
+    NoAlias& operator+=(const MatrixExpression<E>& e);
+    template <class E>
+    NoAlias& operator-=(const MatrixExpression<E>& e);
+  };
+
+  NoAlias noalias();
+
+  // Non-owning views, invalidated when the matrix is resized or destroyed
+  MatrixView view();
+  ConstMatrixView view() const;
+  MatrixView block(size_t row, size_t col, size_t block_rows,
+                   size_t block_cols);
+  ConstMatrixView block(size_t row, size_t col, size_t block_rows,
+                        size_t block_cols) const;
+
+  /*
+   * LU factorization of a copy, see lu.h. The result is kept until the
+   * matrix is next handed out for writing: through set(), or the non-const
+   * get(), operator[], operator() and getRawArray(), through any write via
+   * a Row or MatrixView of it, even one taken before det(), or through any
+   * assignment or in-place operator. Const access keeps it. Writes through
+   * a raw pointer or reference kept from before the last det() are not
+   * seen. Copies and moves start without a cached value.
+   */
   double det() const;
   void transpose();
   Matrix transposed() const;
+
+  /*
+   * Parallel versions, opt-in through an ExecutionPolicy. Results are the
+   * same as the sequential ones for any thread count. multiply reads its
+   * operands in place, so blocks of larger matrices need no copying, and
+   * switches to Strassen-Winograd for large square products once enabled
+   * through set_strassen_cutoff(), see strassen.h.
+   */
+  static Matrix multiply(const ConstMatrixView& a, const ConstMatrixView& b,
+                         const ExecutionPolicy& policy);
+  double det(const ExecutionPolicy& policy) const;
+  Matrix transposed(const ExecutionPolicy& policy) const;
   double trace() const;
 
+  /*
+   * A^k by binary exponentiation; pow(0) is the identity. Squarings and
+   * products alternate between the same two matrices, so nothing is
+   * allocated per step, whatever k.
+   */
+  Matrix pow(size_t k) const;
+  Matrix pow(size_t k, const ExecutionPolicy& policy) const;
+  /*
+   * e^A through a diagonal Pade approximant of degree 3 .. 13 chosen from
+   * the 1-norm of A, with scaling and squaring for larger norms (Higham,
+   * 2005). Accurate to about double precision for well-behaved A.
+   */
+  Matrix expm() const;
+  Matrix expm(const ExecutionPolicy& policy) const;
+
   std::vector<double> getRow(size_t row);
   std::vector<double> getColumn(size_t column);
 
   bool operator==(const Matrix& a) const;
   bool operator!=(const Matrix& a) const;
+  // Without these, m == expression is ambiguous with converting to Matrix
+  template <class E>
+  bool operator==(const MatrixExpression<E>& e) const {
+    return equal_within(*this, e, EPS);
+  }
+  template <class E>
+  bool operator!=(const MatrixExpression<E>& e) const {
+    return !equal_within(*this, e, EPS);
+  }
 
   size_t getRows() const;
   size_t getColumns() const;
   Matrix(size_t cols, double* column);
-  double* getRawArray() const;
+  // The non-const overload is writable, so it drops the cached det()
+  double* getRawArray();
+  const double* getRawArray() const;
+
+  // Unchecked element access, as required by MatrixExpression
+  double eval(size_t row, size_t col) const { return array[row * cols + col]; }
 
-  ~Matrix() { delete[] array; }
+  ~Matrix() { release(); }
 
  private:
+  friend class ConstMatrixView;
+  friend class MatrixView;
+
+  /*
+   * Elements live in small when they fit, otherwise in a 64-byte aligned
+   * block from the current MatrixAllocator, see storage.h. array points to
+   * one of the two, or is nullptr for a moved-from matrix.
+   */
+  static constexpr size_t SMALL_SIZE = 16;
+
   size_t rows = 1;
   size_t cols = 1;
   double* array = nullptr;
+  alignas(STORAGE_ALIGNMENT) double small[SMALL_SIZE];
+
+  /*
+   * version changes whenever the elements may be written; det_value holds
+   * det() of the elements as of det_version. version is a plain counter,
+   * so an accessor in a loop increments it in a register and stores it
+   * once, instead of storing to an atomic on every element.
+   */
+  static constexpr uint64_t NO_DET = ~uint64_t(0);
+  uint64_t version = 0;
+  mutable std::atomic<uint64_t> det_version{NO_DET};
+  mutable std::atomic<double> det_value{0.};
+
+  // Called before any write to the elements
+  void modified() { ++version; }
+  /*
+   * Called by views before they write. Only drops the cached det(), so
+   * views of disjoint blocks may write from several threads at once.
+   */
+  void modified_through_view() {
+    det_version.store(NO_DET, std::memory_order_relaxed);
+  }
+
+  /*
+   * Storage for size elements. Returns the small buffer, possibly the
+   * current array, whenever size fits in it.
+   */
+  double* allocate(size_t size);
+  // Frees array unless it is the small buffer
+  void release();
 
   void check_bound(size_t row, size_t col) const;
   void check_size(const Matrix& a) const;
   void copy_array(const Matrix& from_array);
 };
 
-Matrix operator*(const double& a, const Matrix& b);
+template <>
+struct ExpressionLeaf<Matrix> : std::true_type {};
+
+inline const double* leaf_row(const Matrix& matrix, size_t row) {
+  return matrix.getRawArray() + row * matrix.getColumns();
+}
+
+template <class E>
+Matrix MatrixExpression<E>::eval() const {
+  return Matrix(*this);
+}
+
+template <class E>
+double MatrixExpression<E>::det() const {
+  return eval().det();
+}
+
+template <class E>
+double MatrixExpression<E>::trace() const {
+  const E& expr = self();
+  if (expr.getRows() != expr.getColumns()) {
+    throw SizeMismatchException();
+  }
+  double s = 0.;
+  for (size_t i = 0; i < expr.getRows(); ++i) {
+    s += expr.eval(i, i);
+  }
+  return s;
+}
+
+template <class E>
+Matrix MatrixExpression<E>::transposed() const {
+  return eval().transposed();
+}
+
+template <class L, class R>
+bool operator==(const MatrixExpression<L>& a, const MatrixExpression<R>& b) {
+  return equal_within(a, b, EPS);
+}
+
+template <class L, class R>
+bool operator!=(const MatrixExpression<L>& a, const MatrixExpression<R>& b) {
+  return !equal_within(a, b, EPS);
+}
+
+template <class E>
+Matrix::Matrix(const MatrixExpression<E>& e)
+    : rows(e.self().getRows()), cols(e.self().getColumns()) {
+  MATRIX_COUNT(Construct, 0);
+  array = allocate(rows * cols);
+  evaluate_into(array, cols, e);
+}
+
+template <class E>
+Matrix& Matrix::operator=(const MatrixExpression<E>& e) {
+  const E& expr = e.self();
+  modified();
+  if (expr.getRows() == rows && expr.getColumns() == cols) {
+    evaluate_into(array, cols, e);
+    return *this;
+  }
+
+  /*
+   * Evaluated into a separate buffer: an operand may still be a view of
+   * this matrix, e.g. a block of it, so writing in place is not safe.
+   */
+  double* new_array = allocate(expr.getRows() * expr.getColumns());
+  evaluate_into(new_array, expr.getColumns(), e);
+  rows = expr.getRows();
+  cols = expr.getColumns();
+  if (new_array != array) release();
+  array = new_array;
+  return *this;
+}
+
+template <class E>
+Matrix& Matrix::operator+=(const MatrixExpression<E>& e) {
+  return *this = *this + e;
+}
+
+template <class E>
+Matrix& Matrix::operator-=(const MatrixExpression<E>& e) {
+  return *this = *this - e;
+}
+
+template <class E>
+Matrix::NoAlias& Matrix::NoAlias::operator=(const MatrixExpression<E>& e) {
+  const E& expr = e.self();
+  if (expr.getRows() != matrix.rows || expr.getColumns() != matrix.cols) {
+    throw SizeMismatchException();
+  }
+  matrix.modified();
+  evaluate_into(matrix.array, matrix.cols, e);
+  return *this;
+}
+
+template <class E>
+Matrix::NoAlias& Matrix::NoAlias::operator+=(const MatrixExpression<E>& e) {
+  return *this = matrix + e;
+}
+
+template <class E>
+Matrix::NoAlias& Matrix::NoAlias::operator-=(const MatrixExpression<E>& e) {
+  return *this = matrix - e;
+}
+
+// Matrix product; matrices convert to views, so any mix of the two works
+Matrix operator*(const ConstMatrixView& a, const ConstMatrixView& b);
+
+// Matrices and views as they are, other expressions evaluated first
+template <class E>
+using ProductOperand =
+    std::conditional_t<std::is_convertible<E, ConstMatrixView>::value,
+                       const E&, Matrix>;
+
+// Products with an expression operand, e.g. (a + b) * c
+template <class L, class R,
+          class = std::enable_if_t<
+              !(std::is_convertible<L, ConstMatrixView>::value &&
+                std::is_convertible<R, ConstMatrixView>::value)>>
+Matrix operator*(const MatrixExpression<L>& a, const MatrixExpression<R>& b) {
+  ProductOperand<L> lhs = a.self();
+  ProductOperand<R> rhs = b.self();
+  return ConstMatrixView(lhs) * ConstMatrixView(rhs);
+}
+
+/*
+ * y = a * x and y = x^T * a into caller storage, through the kernels of
+ * gemm.h; y must already have its size, nothing is allocated. Throw
+ * SizeMismatchException when a size does not match.
+ */
+void gemv(const ConstMatrixView& a, const std::vector<double>& x,
+          std::vector<double>& y);
+void gemv(const ConstMatrixView& a, const std::vector<double>& x,
+          std::vector<double>& y, const ExecutionPolicy& policy);
+void gevm(const std::vector<double>& x, const ConstMatrixView& a,
+          std::vector<double>& y);
+void gevm(const std::vector<double>& x, const ConstMatrixView& a,
+          std::vector<double>& y, const ExecutionPolicy& policy);
+
+// Allocating forms of gemv and gevm
+std::vector<double> operator*(const ConstMatrixView& a,
+                              const std::vector<double>& x);
+std::vector<double> operator*(const std::vector<double>& x,
+                              const ConstMatrixView& a);
 
 std::ostream& operator<<(std::ostream& output, const Matrix& matrix);
 std::istream& operator>>(std::istream& input, Matrix& matrix);
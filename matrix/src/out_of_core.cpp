@@ -0,0 +1,71 @@
+#include "out_of_core.h"
+
+#include <algorithm>  // fill
+
+#include "gemm.h"
+#include "transpose.h"
+
+namespace task {
+
+Matrix streamGramian(MatrixReader& a, size_t block_rows) {
+  return streamGramian(a, block_rows, ExecutionPolicy::sequential());
+}
+
+Matrix streamGramian(MatrixReader& a, size_t block_rows,
+                     const ExecutionPolicy& policy) {
+  size_t n = a.getColumns();
+  Matrix result(n, n, Matrix::Uninitialized());
+  std::fill(result.getRawArray(), result.getRawArray() + n * n, 0.);
+
+  // result += B^T * B for every block B, B^T copied out for gemm
+  Matrix block;
+  std::vector<double> block_t;
+  while (a.next(block, block_rows)) {
+    size_t rows = block.getRows();
+    block_t.resize(n * rows);
+    transpose_copy(rows, n, block.getRawArray(), n, block_t.data(), rows);
+    gemm(n, n, rows, 1., block_t.data(), rows, block.getRawArray(), n, 1.,
+         result.getRawArray(), n, policy);
+  }
+  return result;
+}
+
+std::vector<double> streamMultiply(MatrixReader& a,
+                                   const std::vector<double>& x,
+                                   size_t block_rows) {
+  size_t n = a.getColumns();
+  if (x.size() != n) {
+    throw SizeMismatchException();
+  }
+
+  std::vector<double> result(a.getRemainingRows());
+  Matrix block;
+  size_t offset = 0;
+  while (a.next(block, block_rows)) {
+    gemv(block.getRows(), n, 1., block.getRawArray(), n, x.data(), 0.,
+         result.data() + offset);
+    offset += block.getRows();
+  }
+  return result;
+}
+
+std::vector<double> streamMultiplyTransposed(MatrixReader& a,
+                                             const std::vector<double>& y,
+                                             size_t block_rows) {
+  size_t n = a.getColumns();
+  if (y.size() != a.getRemainingRows()) {
+    throw SizeMismatchException();
+  }
+
+  std::vector<double> result(n, 0.);
+  Matrix block;
+  size_t offset = 0;
+  while (a.next(block, block_rows)) {
+    gevm(block.getRows(), n, 1., y.data() + offset, block.getRawArray(), n,
+         1., result.data());
+    offset += block.getRows();
+  }
+  return result;
+}
+
+}  // namespace task
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "matrix.h"
+#include "serialization.h"
+
+namespace task {
+
+/*
+ * Products over a matrix A streamed through a MatrixReader, which none of
+ * them holds in memory: A is read once, block_rows rows at a time, from
+ * where the reader stands to its last row. Memory use is one block plus
+ * the operands and the result, whatever the number of rows of A. A
+ * block_rows of 0 throws std::invalid_argument, see MatrixReader::next().
+ */
+
+const size_t DEFAULT_BLOCK_ROWS = 1024;
+
+// A^T * A, cols x cols
+Matrix streamGramian(MatrixReader& a, size_t block_rows = DEFAULT_BLOCK_ROWS);
+Matrix streamGramian(MatrixReader& a, size_t block_rows,
+                     const ExecutionPolicy& policy);
+
+/*
+ * A * x, one value per row read. Throws SizeMismatchException unless x
+ * has one value per column of A.
+ */
+std::vector<double> streamMultiply(MatrixReader& a,
+                                   const std::vector<double>& x,
+                                   size_t block_rows = DEFAULT_BLOCK_ROWS);
+
+/*
+ * A^T * y, one value per column of A; with streamGramian() this gives the
+ * normal equations of a tall least-squares problem. Throws
+ * SizeMismatchException unless y has one value per row left to read.
+ */
+std::vector<double> streamMultiplyTransposed(
+    MatrixReader& a, const std::vector<double>& y,
+    size_t block_rows = DEFAULT_BLOCK_ROWS);
+
+}  // namespace task
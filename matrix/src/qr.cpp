@@ -0,0 +1,261 @@
+#include "qr.h"
+
+#include <algorithm>  // copy && min
+#include <cmath>      // copysign && fabs && sqrt
+
+#include "gemm.h"
+
+namespace task {
+
+namespace {
+
+// Reflectors aggregated into each block update
+const size_t PANEL = 32;
+
+}  // namespace
+
+QRDecomposition::QRDecomposition(const Matrix& a)
+    : QRDecomposition(a, ExecutionPolicy::sequential()) {}
+
+QRDecomposition::QRDecomposition(const Matrix& a,
+                                 const ExecutionPolicy& policy)
+    : rows(a.getRows()), cols(a.getColumns()), qr(a), tau(a.getColumns()) {
+  if (rows < cols) {
+    throw SizeMismatchException();
+  }
+  factor(policy);
+}
+
+/*
+ * Factor a panel of PANEL columns, then apply its reflectors to the
+ * columns on the right at once as Q1^T = I - V * T^T * V^T (Schreiber and
+ * Van Loan): W = V^T * A2, W = T^T * W, A2 -= V * W. V is copied out with
+ * its implicit unit diagonal, once as is and once transposed, since gemm
+ * takes row-major operands.
+ */
+void QRDecomposition::factor(const ExecutionPolicy& policy) {
+  double* a = qr.getRawArray();
+  size_t m = rows;
+  size_t n = cols;
+  std::vector<double> v;
+  std::vector<double> v_t;
+  std::vector<double> t(PANEL * PANEL);
+  std::vector<double> w;
+
+  for (size_t k0 = 0; k0 < n; k0 += PANEL) {
+    size_t kb = std::min(PANEL, n - k0);
+    size_t k1 = k0 + kb;
+    factor_panel(k0, kb);
+    if (k1 == n) break;
+
+    size_t mr = m - k0;
+    size_t nc = n - k1;
+    v.assign(mr * kb, 0.);
+    v_t.assign(kb * mr, 0.);
+    for (size_t i = 0; i < mr; ++i) {
+      for (size_t j = 0; j < kb && j <= i; ++j) {
+        double value = (i == j) ? 1. : a[(k0 + i) * n + k0 + j];
+        v[i * kb + j] = value;
+        v_t[j * mr + i] = value;
+      }
+    }
+
+    // T upper triangular: T[0:j, j] = -tau_j * T[0:j, 0:j] * V[:, 0:j]^T v_j
+    for (size_t j = 0; j < kb; ++j) {
+      t[j * kb + j] = tau[k0 + j];
+      for (size_t p = 0; p < j; ++p) {
+        double dot = 0.;
+        for (size_t i = j; i < mr; ++i) dot += v_t[p * mr + i] * v[i * kb + j];
+        t[p * kb + j] = dot;
+      }
+      for (size_t p = 0; p < j; ++p) {
+        double sum = 0.;
+        for (size_t q = p; q < j; ++q) sum += t[p * kb + q] * t[q * kb + j];
+        t[p * kb + j] = sum;
+      }
+      for (size_t p = 0; p < j; ++p) t[p * kb + j] *= -tau[k0 + j];
+    }
+
+    double* a2 = a + k0 * n + k1;
+    w.resize(kb * nc);
+    gemm(kb, nc, mr, 1., v_t.data(), mr, a2, n, 0., w.data(), nc, policy);
+    // W = T^T * W, bottom row first as T^T is lower triangular
+    for (size_t i = kb; i-- > 0;) {
+      double* w_i = w.data() + i * nc;
+      double t_ii = t[i * kb + i];
+      for (size_t c = 0; c < nc; ++c) w_i[c] *= t_ii;
+      for (size_t p = 0; p < i; ++p) {
+        double t_pi = t[p * kb + i];
+        const double* w_p = w.data() + p * nc;
+        for (size_t c = 0; c < nc; ++c) w_i[c] += t_pi * w_p[c];
+      }
+    }
+    gemm(mr, nc, kb, -1., v.data(), kb, w.data(), nc, 1., a2, n, policy);
+  }
+}
+
+/*
+ * Unblocked Householder QR of columns [k0, k0 + kb) over rows [k0, rows).
+ * Reflectors are built as in LAPACK's dlarfg, so that beta = -sign(alpha) *
+ * ||x|| lands on the diagonal and v has a unit first element.
+ */
+void QRDecomposition::factor_panel(size_t k0, size_t kb) {
+  double* a = qr.getRawArray();
+  size_t m = rows;
+  size_t n = cols;
+  size_t k1 = k0 + kb;
+
+  for (size_t j = k0; j < k1; ++j) {
+    double alpha = a[j * n + j];
+    double sigma = 0.;
+    for (size_t i = j + 1; i < m; ++i) sigma += a[i * n + j] * a[i * n + j];
+    if (sigma == 0.) {
+      tau[j] = 0.;
+      continue;
+    }
+
+    double beta = -std::copysign(std::sqrt(alpha * alpha + sigma), alpha);
+    tau[j] = (beta - alpha) / beta;
+    double scale = 1. / (alpha - beta);
+    for (size_t i = j + 1; i < m; ++i) a[i * n + j] *= scale;
+    a[j * n + j] = beta;
+
+    // Remaining panel columns: w = v^T * A, A -= tau * v * w
+    size_t width = k1 - j - 1;
+    if (width == 0) continue;
+    double w[PANEL];
+    double* row_j = a + j * n + j + 1;
+    for (size_t c = 0; c < width; ++c) w[c] = row_j[c];
+    for (size_t i = j + 1; i < m; ++i) {
+      double v_i = a[i * n + j];
+      const double* row_i = a + i * n + j + 1;
+      for (size_t c = 0; c < width; ++c) w[c] += v_i * row_i[c];
+    }
+    for (size_t c = 0; c < width; ++c) w[c] *= tau[j];
+    for (size_t c = 0; c < width; ++c) row_j[c] -= w[c];
+    for (size_t i = j + 1; i < m; ++i) {
+      double v_i = a[i * n + j];
+      double* row_i = a + i * n + j + 1;
+      for (size_t c = 0; c < width; ++c) row_i[c] -= v_i * w[c];
+    }
+  }
+}
+
+void QRDecomposition::apply_reflector(size_t j, double* x, size_t nrhs,
+                                      double* w) const {
+  if (tau[j] == 0.) return;
+
+  const double* a = qr.getRawArray();
+  size_t n = cols;
+  std::copy(x + j * nrhs, x + (j + 1) * nrhs, w);
+  for (size_t i = j + 1; i < rows; ++i) {
+    double v_i = a[i * n + j];
+    const double* x_i = x + i * nrhs;
+    for (size_t c = 0; c < nrhs; ++c) w[c] += v_i * x_i[c];
+  }
+  for (size_t c = 0; c < nrhs; ++c) w[c] *= tau[j];
+
+  double* x_j = x + j * nrhs;
+  for (size_t c = 0; c < nrhs; ++c) x_j[c] -= w[c];
+  for (size_t i = j + 1; i < rows; ++i) {
+    double v_i = a[i * n + j];
+    double* x_i = x + i * nrhs;
+    for (size_t c = 0; c < nrhs; ++c) x_i[c] -= v_i * w[c];
+  }
+}
+
+size_t QRDecomposition::getRows() const { return rows; }
+
+size_t QRDecomposition::getColumns() const { return cols; }
+
+bool QRDecomposition::isFullRank() const {
+  const double* a = qr.getRawArray();
+  for (size_t i = 0; i < cols; ++i) {
+    if (std::fabs(a[i * cols + i]) < EPS) return false;
+  }
+  return true;
+}
+
+void QRDecomposition::solve_in_place(double* x, size_t nrhs) const {
+  if (!isFullRank()) {
+    throw SingularMatrixException();
+  }
+
+  // Q^T * B = H_n ... H_1 * B
+  std::vector<double> w(nrhs);
+  for (size_t j = 0; j < cols; ++j) apply_reflector(j, x, nrhs, w.data());
+
+  // R * X = (Q^T * B)[0:n]
+  const double* a = qr.getRawArray();
+  size_t n = cols;
+  for (size_t i = n; i-- > 0;) {
+    double* x_i = x + i * nrhs;
+    for (size_t j = i + 1; j < n; ++j) {
+      double r_ij = a[i * n + j];
+      const double* x_j = x + j * nrhs;
+      for (size_t c = 0; c < nrhs; ++c) {
+        x_i[c] -= r_ij * x_j[c];
+      }
+    }
+    double r_ii = a[i * n + i];
+    for (size_t c = 0; c < nrhs; ++c) {
+      x_i[c] /= r_ii;
+    }
+  }
+}
+
+Matrix QRDecomposition::solve(const Matrix& b) const {
+  if (b.getRows() != rows) {
+    throw SizeMismatchException();
+  }
+
+  Matrix x(b);
+  solve_in_place(x.getRawArray(), x.getColumns());
+  x.resize(cols, b.getColumns());
+  return x;
+}
+
+std::vector<double> QRDecomposition::solve(const std::vector<double>& b) const {
+  if (b.size() != rows) {
+    throw SizeMismatchException();
+  }
+
+  std::vector<double> x(b);
+  solve_in_place(x.data(), 1);
+  x.resize(cols);
+  return x;
+}
+
+Matrix QRDecomposition::getQ() const {
+  // Q * [I; 0] = H_1 ... H_n * [I; 0]
+  Matrix q(rows, cols, Matrix::Uninitialized());
+  double* x = q.getRawArray();
+  for (size_t i = 0; i < rows; ++i)
+    for (size_t j = 0; j < cols; ++j) x[i * cols + j] = (i == j) ? 1. : 0.;
+  std::vector<double> w(cols);
+  for (size_t j = cols; j-- > 0;) apply_reflector(j, x, cols, w.data());
+  return q;
+}
+
+Matrix QRDecomposition::getR() const {
+  Matrix r(cols, cols, Matrix::Uninitialized());
+  const double* a = qr.getRawArray();
+  for (size_t i = 0; i < cols; ++i)
+    for (size_t j = 0; j < cols; ++j)
+      r.set(i, j, (j >= i) ? a[i * cols + j] : 0.);
+  return r;
+}
+
+Matrix lstsq(const Matrix& a, const Matrix& b) {
+  return QRDecomposition(a).solve(b);
+}
+
+Matrix lstsq(const Matrix& a, const Matrix& b, const ExecutionPolicy& policy) {
+  return QRDecomposition(a, policy).solve(b);
+}
+
+std::vector<double> lstsq(const Matrix& a, const std::vector<double>& b) {
+  return QRDecomposition(a).solve(b);
+}
+
+}  // namespace task
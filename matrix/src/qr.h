@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "matrix.h"
+
+namespace task {
+
+/*
+ * Householder QR factorization A = Q * R of an m x n matrix with m >= n,
+ * computed once into its own buffer. R is kept in the upper triangle, the
+ * reflector vectors below it. Columns are factored in panels whose
+ * reflectors are aggregated into the compact WY form I - V * T * V^T, so
+ * the trailing update is two products through gemm.
+ */
+class QRDecomposition {
+ public:
+  // Throws SizeMismatchException when A has fewer rows than columns
+  explicit QRDecomposition(const Matrix& a);
+  QRDecomposition(const Matrix& a, const ExecutionPolicy& policy);
+
+  size_t getRows() const;
+  size_t getColumns() const;
+  // False if some diagonal element of R is smaller than EPS
+  bool isFullRank() const;
+
+  /*
+   * Least-squares solution X minimizing ||A * X - B|| for every column of
+   * B; the exact solution when A is square. Throws SizeMismatchException
+   * when B has a different number of rows, SingularMatrixException when A
+   * is rank deficient.
+   */
+  Matrix solve(const Matrix& b) const;
+  std::vector<double> solve(const std::vector<double>& b) const;
+
+  // Thin factors: Q is m x n with orthonormal columns, R is n x n
+  Matrix getQ() const;
+  Matrix getR() const;
+
+ private:
+  size_t rows;
+  size_t cols;
+  Matrix qr;
+  // Scale of each reflector, H_j = I - tau[j] * v_j * v_j^T
+  std::vector<double> tau;
+
+  void factor(const ExecutionPolicy& policy);
+  void factor_panel(size_t k0, size_t kb);
+  /*
+   * Applies H_j to rows [j, rows) of the row-major block x with nrhs
+   * columns; w is scratch space for nrhs values.
+   */
+  void apply_reflector(size_t j, double* x, size_t nrhs, double* w) const;
+  // Overwrites x (rows x nrhs) with R^-1 * (Q^T * x) in its first cols rows
+  void solve_in_place(double* x, size_t nrhs) const;
+};
+
+// Least-squares solution of A * X = B through QRDecomposition
+Matrix lstsq(const Matrix& a, const Matrix& b);
+Matrix lstsq(const Matrix& a, const Matrix& b, const ExecutionPolicy& policy);
+std::vector<double> lstsq(const Matrix& a, const std::vector<double>& b);
+
+}  // namespace task
@@ -0,0 +1,358 @@
+#include "serialization.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>  // copy, min
+#include <cstring>    // memcmp && memcpy
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace task {
+
+namespace {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "the binary format stores little-endian doubles");
+
+const char MAGIC[8] = {'T', 'M', 'A', 'T', 'R', 'I', 'X', '\0'};
+const uint32_t VERSION = 1;
+const uint32_t DTYPE_FLOAT64 = 1;
+const uint64_t DATA_ALIGNMENT = 64;
+
+// Checks the header and returns the number of elements
+size_t validate(const BinaryHeader& header) {
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION || header.dtype != DTYPE_FLOAT64 ||
+      header.data_offset < sizeof(BinaryHeader) ||
+      header.data_offset % DATA_ALIGNMENT != 0) {
+    throw MatrixIOException();
+  }
+  uint64_t limit = std::numeric_limits<size_t>::max() / sizeof(double);
+  if (header.cols != 0 && header.rows > limit / header.cols) {
+    throw MatrixIOException();
+  }
+  return header.rows * header.cols;
+}
+
+BinaryHeader make_header(size_t rows, size_t cols) {
+  BinaryHeader header = {};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.dtype = DTYPE_FLOAT64;
+  header.rows = rows;
+  header.cols = cols;
+  header.data_offset = sizeof(BinaryHeader);
+  return header;
+}
+
+/*
+ * Bytes from the current position of input to its end, or -1 when input
+ * cannot seek, e.g. a pipe. The position is left where it was.
+ */
+std::streamoff remaining_bytes(std::istream& input) {
+  std::streampos here = input.tellg();
+  if (here == std::streampos(-1)) {
+    return -1;
+  }
+  input.seekg(0, std::ios::end);
+  std::streampos end = input.tellg();
+  input.clear();
+  input.seekg(here);
+  return (end == std::streampos(-1)) ? -1 : std::streamoff(end - here);
+}
+
+// Elements readBinary() reads at a time from a stream of unknown length
+const size_t READ_CHUNK = 1 << 16;
+
+// Reads and checks a header, leaving input at the first element
+BinaryHeader read_header(std::istream& input) {
+  BinaryHeader header;
+  if (!input.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    throw MatrixIOException();
+  }
+  validate(header);
+  if (!input.ignore(header.data_offset - sizeof(header))) {
+    throw MatrixIOException();
+  }
+  return header;
+}
+
+}  // namespace
+
+void writeBinary(std::ostream& output, const Matrix& matrix) {
+  BinaryHeader header = make_header(matrix.getRows(), matrix.getColumns());
+  output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  output.write(reinterpret_cast<const char*>(matrix.view().getRawArray()),
+               matrix.getRows() * matrix.getColumns() * sizeof(double));
+  if (!output) {
+    throw MatrixIOException();
+  }
+}
+
+Matrix readBinary(std::istream& input) {
+  BinaryHeader header = read_header(input);
+  size_t size = header.rows * header.cols;
+  std::streamoff available = remaining_bytes(input);
+  if (available >= 0) {
+    // Checked before allocating, a corrupt header may claim any size
+    if (static_cast<uint64_t>(available) / sizeof(double) < size) {
+      throw MatrixIOException();
+    }
+    // Every element is read below, so skip the identity fill
+    Matrix matrix(header.rows, header.cols, Matrix::Uninitialized());
+    if (!input.read(reinterpret_cast<char*>(matrix.getRawArray()),
+                    size * sizeof(double))) {
+      throw MatrixIOException();
+    }
+    return matrix;
+  }
+
+  // Length unknown: grow a chunk at a time, so memory follows the input
+  std::vector<double> values;
+  while (values.size() < size) {
+    size_t chunk = std::min(size - values.size(), READ_CHUNK);
+    values.resize(values.size() + chunk);
+    if (!input.read(
+            reinterpret_cast<char*>(values.data() + values.size() - chunk),
+            chunk * sizeof(double))) {
+      throw MatrixIOException();
+    }
+  }
+  Matrix matrix(header.rows, header.cols, Matrix::Uninitialized());
+  std::copy(values.begin(), values.end(), matrix.getRawArray());
+  return matrix;
+}
+
+void saveBinary(const std::string& path, const Matrix& matrix) {
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  if (!output) {
+    throw MatrixIOException();
+  }
+  writeBinary(output, matrix);
+}
+
+Matrix loadBinary(const std::string& path) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input) {
+    throw MatrixIOException();
+  }
+  return readBinary(input);
+}
+
+/*
+ * MappedMatrix
+ */
+MappedMatrix::MappedMatrix(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw MatrixIOException();
+  }
+
+  struct stat info;
+  if (::fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(BinaryHeader)) {
+    ::close(fd);
+    throw MatrixIOException();
+  }
+
+  mapping_size = info.st_size;
+  mapping = ::mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive, the descriptor is no longer needed
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    throw MatrixIOException();
+  }
+
+  BinaryHeader header;
+  std::memcpy(&header, mapping, sizeof(header));
+  size_t size;
+  try {
+    size = validate(header);
+  } catch (...) {
+    unmap();
+    throw;
+  }
+  if (header.data_offset > mapping_size ||
+      (mapping_size - header.data_offset) / sizeof(double) < size) {
+    unmap();
+    throw MatrixIOException();
+  }
+
+  rows = header.rows;
+  cols = header.cols;
+  data = reinterpret_cast<const double*>(static_cast<const char*>(mapping) +
+                                         header.data_offset);
+}
+
+MappedMatrix::~MappedMatrix() { unmap(); }
+
+MappedMatrix::MappedMatrix(MappedMatrix&& other) noexcept
+    : rows(other.rows),
+      cols(other.cols),
+      data(other.data),
+      mapping(other.mapping),
+      mapping_size(other.mapping_size) {
+  other.rows = 0;
+  other.cols = 0;
+  other.data = nullptr;
+  other.mapping = nullptr;
+  other.mapping_size = 0;
+}
+
+MappedMatrix& MappedMatrix::operator=(MappedMatrix&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  unmap();
+  rows = other.rows;
+  cols = other.cols;
+  data = other.data;
+  mapping = other.mapping;
+  mapping_size = other.mapping_size;
+  other.rows = 0;
+  other.cols = 0;
+  other.data = nullptr;
+  other.mapping = nullptr;
+  other.mapping_size = 0;
+  return *this;
+}
+
+void MappedMatrix::unmap() {
+  if (mapping) {
+    ::munmap(mapping, mapping_size);
+    mapping = nullptr;
+  }
+}
+
+size_t MappedMatrix::getRows() const { return rows; }
+
+size_t MappedMatrix::getColumns() const { return cols; }
+
+const double* MappedMatrix::getRawArray() const { return data; }
+
+const double& MappedMatrix::get(size_t row, size_t col) const {
+  if (row >= rows || col >= cols) {
+    throw OutOfBoundsException();
+  }
+  return data[row * cols + col];
+}
+
+const double* MappedMatrix::operator[](size_t row) const {
+  if (row >= rows) {
+    throw OutOfBoundsException();
+  }
+  return data + row * cols;
+}
+
+Matrix MappedMatrix::toMatrix() const { return Matrix(*this); }
+
+ConstMatrixView MappedMatrix::view() const {
+  return ConstMatrixView(data, rows, cols, cols);
+}
+
+/*
+ * MatrixReader
+ */
+MatrixReader::MatrixReader(std::istream& input, MatrixFormat format)
+    : input(input), format(format) {
+  if (format == MatrixFormat::Binary) {
+    BinaryHeader header = read_header(input);
+    rows = header.rows;
+    cols = header.cols;
+  } else if (!(input >> rows >> cols)) {
+    throw MatrixIOException();
+  }
+}
+
+size_t MatrixReader::getRows() const { return rows; }
+
+size_t MatrixReader::getColumns() const { return cols; }
+
+size_t MatrixReader::getRemainingRows() const { return rows - next_row; }
+
+bool MatrixReader::next(Matrix& block, size_t max_rows) {
+  if (max_rows == 0) {
+    throw std::invalid_argument("MatrixReader::next: max_rows is 0");
+  }
+  size_t count = std::min(max_rows, rows - next_row);
+  if (count == 0) {
+    return false;
+  }
+
+  if (block.getRows() != count || block.getColumns() != cols) {
+    // Every element is read below, so skip the identity fill
+    block = Matrix(count, cols, Matrix::Uninitialized());
+  }
+  double* data = block.getRawArray();
+  if (format == MatrixFormat::Binary) {
+    if (!input.read(reinterpret_cast<char*>(data),
+                    count * cols * sizeof(double))) {
+      throw MatrixIOException();
+    }
+  } else {
+    for (size_t i = 0; i < count * cols; ++i) {
+      if (!(input >> data[i])) {
+        throw MatrixIOException();
+      }
+    }
+  }
+  next_row += count;
+  return true;
+}
+
+/*
+ * MatrixWriter
+ */
+MatrixWriter::MatrixWriter(std::ostream& output, MatrixFormat format,
+                           size_t rows, size_t cols)
+    : output(output), format(format), rows(rows), cols(cols) {
+  if (format == MatrixFormat::Binary) {
+    BinaryHeader header = make_header(rows, cols);
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  } else {
+    output << rows << " " << cols << "\n";
+  }
+  if (!output) {
+    throw MatrixIOException();
+  }
+}
+
+void MatrixWriter::write(const ConstMatrixView& block) {
+  if (block.getColumns() != cols || block.getRows() > rows - next_row) {
+    throw SizeMismatchException();
+  }
+
+  // Set for this call only, the stream belongs to the caller
+  std::streamsize precision =
+      output.precision(std::numeric_limits<double>::max_digits10);
+
+  for (size_t i = 0; i < block.getRows(); ++i) {
+    const double* row = block[i];
+    if (format == MatrixFormat::Binary) {
+      output.write(reinterpret_cast<const char*>(row), cols * sizeof(double));
+    } else {
+      for (size_t j = 0; j < cols; ++j) output << " " << row[j];
+      output << "\n";
+    }
+  }
+  output.precision(precision);
+  if (!output) {
+    throw MatrixIOException();
+  }
+  next_row += block.getRows();
+}
+
+void MatrixWriter::finish() {
+  if (next_row != rows || !output.flush()) {
+    throw MatrixIOException();
+  }
+}
+
+}  // namespace task
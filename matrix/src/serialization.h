@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "matrix.h"
+
+namespace task {
+
+/*
+ * Binary matrix file: a 64-byte header followed by the elements in
+ * row-major order, starting at a 64-byte aligned offset.
+ *
+ *   offset  size  field
+ *        0     8  magic "TMATRIX\0"
+ *        8     4  version, currently 1
+ *       12     4  dtype, 1 for little-endian IEEE double
+ *       16     8  rows
+ *       24     8  cols
+ *       32     8  data offset from the start of the file
+ *       40    24  zero padding
+ *
+ * Malformed or truncated input and failed system calls throw
+ * MatrixIOException.
+ */
+struct BinaryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t dtype;
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t data_offset;
+  uint8_t padding[24];
+};
+
+static_assert(sizeof(BinaryHeader) == 64, "BinaryHeader must be 64 bytes");
+
+void writeBinary(std::ostream& output, const Matrix& matrix);
+Matrix readBinary(std::istream& input);
+
+void saveBinary(const std::string& path, const Matrix& matrix);
+Matrix loadBinary(const std::string& path);
+
+/*
+ * Read-only view of a binary matrix file mapped into memory. Opening does
+ * no parsing beyond the header and no copy: pages are loaded on first
+ * access. Usable wherever a MatrixExpression is, e.g.
+ *   Matrix sum = mapped + other;
+ * and converts to a ConstMatrixView without copying, so products, gemv
+ * and the other functions taking views read the mapping in place.
+ */
+class MappedMatrix : public MatrixExpression<MappedMatrix> {
+ public:
+  using MatrixExpression<MappedMatrix>::eval;
+
+  explicit MappedMatrix(const std::string& path);
+  ~MappedMatrix();
+
+  MappedMatrix(const MappedMatrix&) = delete;
+  MappedMatrix& operator=(const MappedMatrix&) = delete;
+  MappedMatrix(MappedMatrix&& other) noexcept;
+  MappedMatrix& operator=(MappedMatrix&& other) noexcept;
+
+  size_t getRows() const;
+  size_t getColumns() const;
+  const double* getRawArray() const;
+
+  const double& get(size_t row, size_t col) const;
+  const double* operator[](size_t row) const;
+  double eval(size_t row, size_t col) const { return data[row * cols + col]; }
+
+  Matrix toMatrix() const;
+  ConstMatrixView view() const;
+  operator ConstMatrixView() const { return view(); }
+
+ private:
+  size_t rows = 0;
+  size_t cols = 0;
+  const double* data = nullptr;
+  void* mapping = nullptr;
+  size_t mapping_size = 0;
+
+  void unmap();
+};
+
+enum class MatrixFormat {
+  // rows and cols, then the elements, as read by operator>>
+  Text,
+  // BinaryHeader and the elements, as written by writeBinary()
+  Binary
+};
+
+/*
+ * Reads a matrix from a stream a block of rows at a time, for matrices
+ * too large to hold in memory. Only the header is read up front; next()
+ * then parses just the rows it returns. The stream must outlive the
+ * reader.
+ */
+class MatrixReader {
+ public:
+  // Reads the header; throws MatrixIOException when it is malformed
+  MatrixReader(std::istream& input, MatrixFormat format);
+
+  size_t getRows() const;
+  size_t getColumns() const;
+  // Rows not returned by next() yet
+  size_t getRemainingRows() const;
+
+  /*
+   * Reads the next min(max_rows, getRemainingRows()) rows into block,
+   * reusing its storage when it already has that shape. Returns false,
+   * leaving block alone, once every row has been read. Throws
+   * MatrixIOException on malformed or truncated input and
+   * std::invalid_argument when max_rows is 0.
+   */
+  bool next(Matrix& block, size_t max_rows);
+
+ private:
+  std::istream& input;
+  MatrixFormat format;
+  size_t rows = 0;
+  size_t cols = 0;
+  size_t next_row = 0;
+};
+
+/*
+ * Writes a rows x cols matrix to a stream a block of rows at a time, in
+ * the format MatrixReader reads. Text output keeps 17 significant digits,
+ * so doubles read back exactly; the stream's own precision is left as it
+ * was.
+ */
+class MatrixWriter {
+ public:
+  // Writes the header; the stream must outlive the writer
+  MatrixWriter(std::ostream& output, MatrixFormat format, size_t rows,
+               size_t cols);
+
+  /*
+   * Appends the rows of block. Throws SizeMismatchException when its
+   * width differs or it runs past the last row, MatrixIOException when
+   * the stream fails.
+   */
+  void write(const ConstMatrixView& block);
+  // Throws MatrixIOException unless every row was written and flushed
+  void finish();
+
+ private:
+  std::ostream& output;
+  MatrixFormat format;
+  size_t rows;
+  size_t cols;
+  size_t next_row = 0;
+};
+
+template <>
+struct ExpressionOperand<MappedMatrix> {
+  using type = const MappedMatrix&;
+};
+
+template <>
+struct ExpressionLeaf<MappedMatrix> : std::true_type {};
+
+inline const double* leaf_row(const MappedMatrix& matrix, size_t row) {
+  return matrix.getRawArray() + row * matrix.getColumns();
+}
+
+}  // namespace task
@@ -0,0 +1,499 @@
+#include "simd.h"
+
+#include <atomic>
+#include <cmath>  // fabs
+
+#ifdef TASK_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace task {
+namespace simd {
+
+namespace {
+
+struct Kernels {
+  void (*add)(double*, const double*, size_t);
+  void (*sub)(double*, const double*, size_t);
+  void (*scale)(double*, double, size_t);
+  void (*negate)(double*, const double*, size_t);
+  bool (*equal)(const double*, const double*, size_t, double);
+  double (*dot)(const double*, const double*, size_t);
+  void (*axpy)(double*, double, const double*, size_t);
+};
+
+/*
+ * Scalar kernels, also used for the tails the vector kernels leave over.
+ */
+void add_scalar(double* dst, const double* src, size_t size) {
+  for (size_t i = 0; i < size; ++i) dst[i] += src[i];
+}
+
+void sub_scalar(double* dst, const double* src, size_t size) {
+  for (size_t i = 0; i < size; ++i) dst[i] -= src[i];
+}
+
+void scale_scalar(double* dst, double factor, size_t size) {
+  for (size_t i = 0; i < size; ++i) dst[i] *= factor;
+}
+
+void negate_scalar(double* dst, const double* src, size_t size) {
+  for (size_t i = 0; i < size; ++i) dst[i] = -src[i];
+}
+
+bool equal_scalar(const double* a, const double* b, size_t size, double eps) {
+  for (size_t i = 0; i < size; ++i) {
+    if (std::fabs(a[i] - b[i]) > eps) return false;
+  }
+  return true;
+}
+
+double dot_scalar(const double* a, const double* b, size_t size) {
+  double sum = 0.;
+  for (size_t i = 0; i < size; ++i) sum += a[i] * b[i];
+  return sum;
+}
+
+void axpy_scalar(double* dst, double factor, const double* src, size_t size) {
+  for (size_t i = 0; i < size; ++i) dst[i] += factor * src[i];
+}
+
+const Kernels SCALAR = {add_scalar,   sub_scalar, scale_scalar, negate_scalar,
+                        equal_scalar, dot_scalar, axpy_scalar};
+
+#ifdef TASK_SIMD_X86
+
+/*
+ * SSE2: 2 doubles per register. Loads are unaligned: Matrix storage is
+ * aligned, but views and row offsets into it are not.
+ */
+__attribute__((target("sse2"))) void add_sse2(double* dst, const double* src,
+                                              size_t size) {
+  size_t i = 0;
+  for (; i + 2 <= size; i += 2) {
+    __m128d x = _mm_loadu_pd(dst + i);
+    _mm_storeu_pd(dst + i, _mm_add_pd(x, _mm_loadu_pd(src + i)));
+  }
+  add_scalar(dst + i, src + i, size - i);
+}
+
+__attribute__((target("sse2"))) void sub_sse2(double* dst, const double* src,
+                                              size_t size) {
+  size_t i = 0;
+  for (; i + 2 <= size; i += 2) {
+    __m128d x = _mm_loadu_pd(dst + i);
+    _mm_storeu_pd(dst + i, _mm_sub_pd(x, _mm_loadu_pd(src + i)));
+  }
+  sub_scalar(dst + i, src + i, size - i);
+}
+
+__attribute__((target("sse2"))) void scale_sse2(double* dst, double factor,
+                                                size_t size) {
+  __m128d f = _mm_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 2 <= size; i += 2) {
+    _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(dst + i), f));
+  }
+  scale_scalar(dst + i, factor, size - i);
+}
+
+__attribute__((target("sse2"))) void negate_sse2(double* dst,
+                                                 const double* src,
+                                                 size_t size) {
+  // Flipping the sign bit matches scalar unary minus, including -0.0
+  __m128d sign = _mm_set1_pd(-0.);
+  size_t i = 0;
+  for (; i + 2 <= size; i += 2) {
+    _mm_storeu_pd(dst + i, _mm_xor_pd(_mm_loadu_pd(src + i), sign));
+  }
+  negate_scalar(dst + i, src + i, size - i);
+}
+
+__attribute__((target("sse2"))) bool equal_sse2(const double* a,
+                                                const double* b, size_t size,
+                                                double eps) {
+  __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+  __m128d e = _mm_set1_pd(eps);
+  size_t i = 0;
+  for (; i + 2 <= size; i += 2) {
+    __m128d diff = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+    // Ordered compare: NaN differences pass, as with fabs(x) > eps
+    __m128d gt = _mm_cmpgt_pd(_mm_and_pd(diff, abs_mask), e);
+    if (_mm_movemask_pd(gt)) return false;
+  }
+  return equal_scalar(a + i, b + i, size - i, eps);
+}
+
+// Two accumulators hide the latency of the dependent additions
+__attribute__((target("sse2"))) double dot_sse2(const double* a,
+                                                const double* b, size_t size) {
+  __m128d s0 = _mm_setzero_pd();
+  __m128d s1 = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2),
+                                   _mm_loadu_pd(b + i + 2)));
+  }
+  double partial[2];
+  _mm_storeu_pd(partial, _mm_add_pd(s0, s1));
+  return partial[0] + partial[1] + dot_scalar(a + i, b + i, size - i);
+}
+
+__attribute__((target("sse2"))) void axpy_sse2(double* dst, double factor,
+                                               const double* src,
+                                               size_t size) {
+  __m128d f = _mm_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 2 <= size; i += 2) {
+    __m128d x = _mm_mul_pd(_mm_loadu_pd(src + i), f);
+    _mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(dst + i), x));
+  }
+  axpy_scalar(dst + i, factor, src + i, size - i);
+}
+
+const Kernels SSE2 = {add_sse2,   sub_sse2, scale_sse2, negate_sse2,
+                      equal_sse2, dot_sse2, axpy_sse2};
+
+/*
+ * AVX2: 4 doubles per register, two registers per iteration.
+ */
+__attribute__((target("avx2"))) void add_avx2(double* dst, const double* src,
+                                              size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256d x0 = _mm256_loadu_pd(dst + i);
+    __m256d x1 = _mm256_loadu_pd(dst + i + 4);
+    _mm256_storeu_pd(dst + i, _mm256_add_pd(x0, _mm256_loadu_pd(src + i)));
+    _mm256_storeu_pd(dst + i + 4,
+                     _mm256_add_pd(x1, _mm256_loadu_pd(src + i + 4)));
+  }
+  add_sse2(dst + i, src + i, size - i);
+}
+
+__attribute__((target("avx2"))) void sub_avx2(double* dst, const double* src,
+                                              size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256d x0 = _mm256_loadu_pd(dst + i);
+    __m256d x1 = _mm256_loadu_pd(dst + i + 4);
+    _mm256_storeu_pd(dst + i, _mm256_sub_pd(x0, _mm256_loadu_pd(src + i)));
+    _mm256_storeu_pd(dst + i + 4,
+                     _mm256_sub_pd(x1, _mm256_loadu_pd(src + i + 4)));
+  }
+  sub_sse2(dst + i, src + i, size - i);
+}
+
+__attribute__((target("avx2"))) void scale_avx2(double* dst, double factor,
+                                                size_t size) {
+  __m256d f = _mm256_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(dst + i), f));
+    _mm256_storeu_pd(dst + i + 4,
+                     _mm256_mul_pd(_mm256_loadu_pd(dst + i + 4), f));
+  }
+  scale_sse2(dst + i, factor, size - i);
+}
+
+__attribute__((target("avx2"))) void negate_avx2(double* dst,
+                                                 const double* src,
+                                                 size_t size) {
+  __m256d sign = _mm256_set1_pd(-0.);
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    _mm256_storeu_pd(dst + i, _mm256_xor_pd(_mm256_loadu_pd(src + i), sign));
+  }
+  negate_sse2(dst + i, src + i, size - i);
+}
+
+__attribute__((target("avx2"))) bool equal_avx2(const double* a,
+                                                const double* b, size_t size,
+                                                double eps) {
+  __m256d abs_mask =
+      _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+  __m256d e = _mm256_set1_pd(eps);
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m256d diff =
+        _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+    __m256d gt = _mm256_cmp_pd(_mm256_and_pd(diff, abs_mask), e, _CMP_GT_OQ);
+    if (_mm256_movemask_pd(gt)) return false;
+  }
+  return equal_sse2(a + i, b + i, size - i, eps);
+}
+
+__attribute__((target("avx2"))) double dot_avx2(const double* a,
+                                                const double* b, size_t size) {
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    s0 = _mm256_add_pd(
+        s0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4),
+                                         _mm256_loadu_pd(b + i + 4)));
+  }
+  __m256d s = _mm256_add_pd(s0, s1);
+  __m128d half =
+      _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+  double partial[2];
+  _mm_storeu_pd(partial, half);
+  return partial[0] + partial[1] + dot_sse2(a + i, b + i, size - i);
+}
+
+__attribute__((target("avx2"))) void axpy_avx2(double* dst, double factor,
+                                               const double* src,
+                                               size_t size) {
+  __m256d f = _mm256_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256d x0 = _mm256_mul_pd(_mm256_loadu_pd(src + i), f);
+    __m256d x1 = _mm256_mul_pd(_mm256_loadu_pd(src + i + 4), f);
+    _mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_loadu_pd(dst + i), x0));
+    _mm256_storeu_pd(dst + i + 4,
+                     _mm256_add_pd(_mm256_loadu_pd(dst + i + 4), x1));
+  }
+  axpy_sse2(dst + i, factor, src + i, size - i);
+}
+
+const Kernels AVX2 = {add_avx2,   sub_avx2, scale_avx2, negate_avx2,
+                      equal_avx2, dot_avx2, axpy_avx2};
+
+/*
+ * AVX-512: 8 doubles per register, tails handled with masked loads/stores.
+ */
+__attribute__((target("avx512f"))) void add_avx512(double* dst,
+                                                   const double* src,
+                                                   size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m512d x = _mm512_loadu_pd(dst + i);
+    _mm512_storeu_pd(dst + i, _mm512_add_pd(x, _mm512_loadu_pd(src + i)));
+  }
+  if (i < size) {
+    __mmask8 m = (__mmask8)((1u << (size - i)) - 1);
+    __m512d x = _mm512_maskz_loadu_pd(m, dst + i);
+    __m512d y = _mm512_maskz_loadu_pd(m, src + i);
+    _mm512_mask_storeu_pd(dst + i, m, _mm512_add_pd(x, y));
+  }
+}
+
+__attribute__((target("avx512f"))) void sub_avx512(double* dst,
+                                                   const double* src,
+                                                   size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m512d x = _mm512_loadu_pd(dst + i);
+    _mm512_storeu_pd(dst + i, _mm512_sub_pd(x, _mm512_loadu_pd(src + i)));
+  }
+  if (i < size) {
+    __mmask8 m = (__mmask8)((1u << (size - i)) - 1);
+    __m512d x = _mm512_maskz_loadu_pd(m, dst + i);
+    __m512d y = _mm512_maskz_loadu_pd(m, src + i);
+    _mm512_mask_storeu_pd(dst + i, m, _mm512_sub_pd(x, y));
+  }
+}
+
+__attribute__((target("avx512f"))) void scale_avx512(double* dst,
+                                                     double factor,
+                                                     size_t size) {
+  __m512d f = _mm512_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    _mm512_storeu_pd(dst + i, _mm512_mul_pd(_mm512_loadu_pd(dst + i), f));
+  }
+  if (i < size) {
+    __mmask8 m = (__mmask8)((1u << (size - i)) - 1);
+    __m512d x = _mm512_maskz_loadu_pd(m, dst + i);
+    _mm512_mask_storeu_pd(dst + i, m, _mm512_mul_pd(x, f));
+  }
+}
+
+__attribute__((target("avx512f"))) void negate_avx512(double* dst,
+                                                      const double* src,
+                                                      size_t size) {
+  __m512i sign = _mm512_set1_epi64(0x8000000000000000LL);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m512i x = _mm512_castpd_si512(_mm512_loadu_pd(src + i));
+    _mm512_storeu_pd(dst + i, _mm512_castsi512_pd(_mm512_xor_si512(x, sign)));
+  }
+  negate_avx2(dst + i, src + i, size - i);
+}
+
+__attribute__((target("avx512f"))) bool equal_avx512(const double* a,
+                                                     const double* b,
+                                                     size_t size, double eps) {
+  __m512d e = _mm512_set1_pd(eps);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m512d diff =
+        _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+    if (_mm512_cmp_pd_mask(_mm512_abs_pd(diff), e, _CMP_GT_OQ)) return false;
+  }
+  return equal_avx2(a + i, b + i, size - i, eps);
+}
+
+__attribute__((target("avx512f"))) double dot_avx512(const double* a,
+                                                    const double* b,
+                                                    size_t size) {
+  __m512d s0 = _mm512_setzero_pd();
+  __m512d s1 = _mm512_setzero_pd();
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+    s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8),
+                         s1);
+  }
+  for (; i < size; i += 8) {
+    __mmask8 m = (size - i >= 8) ? (__mmask8)0xff
+                                 : (__mmask8)((1u << (size - i)) - 1);
+    s0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, a + i),
+                         _mm512_maskz_loadu_pd(m, b + i), s0);
+  }
+  double partial[8];
+  _mm512_storeu_pd(partial, _mm512_add_pd(s0, s1));
+  return ((partial[0] + partial[1]) + (partial[2] + partial[3])) +
+         ((partial[4] + partial[5]) + (partial[6] + partial[7]));
+}
+
+__attribute__((target("avx512f"))) void axpy_avx512(double* dst,
+                                                    double factor,
+                                                    const double* src,
+                                                    size_t size) {
+  __m512d f = _mm512_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m512d x = _mm512_loadu_pd(dst + i);
+    _mm512_storeu_pd(dst + i, _mm512_fmadd_pd(_mm512_loadu_pd(src + i), f, x));
+  }
+  if (i < size) {
+    __mmask8 m = (__mmask8)((1u << (size - i)) - 1);
+    __m512d x = _mm512_maskz_loadu_pd(m, dst + i);
+    __m512d y = _mm512_maskz_loadu_pd(m, src + i);
+    _mm512_mask_storeu_pd(dst + i, m, _mm512_fmadd_pd(y, f, x));
+  }
+}
+
+const Kernels AVX512 = {add_avx512,   sub_avx512, scale_avx512, negate_avx512,
+                        equal_avx512, dot_avx512, axpy_avx512};
+
+#endif  // TASK_SIMD_X86
+
+Isa detect_isa() {
+#ifdef TASK_SIMD_X86
+  // __builtin_cpu_supports reads CPUID and also checks XCR0, so a feature
+  // the OS does not save on context switch is reported as missing
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return Isa::Avx512;
+  if (__builtin_cpu_supports("avx2")) return Isa::Avx2;
+  if (__builtin_cpu_supports("sse2")) return Isa::Sse2;
+#endif
+  return Isa::Scalar;
+}
+
+Isa supported_isa() {
+  static const Isa isa = detect_isa();
+  return isa;
+}
+
+const Kernels* kernels_for(Isa isa) {
+#ifdef TASK_SIMD_X86
+  switch (isa) {
+    case Isa::Avx512:
+      return &AVX512;
+    case Isa::Avx2:
+      return &AVX2;
+    case Isa::Sse2:
+      return &SSE2;
+    case Isa::Scalar:
+      break;
+  }
+#endif
+  (void)isa;
+  return &SCALAR;
+}
+
+struct Dispatch {
+  std::atomic<Isa> isa;
+  std::atomic<const Kernels*> kernels;
+
+  Dispatch() : isa(supported_isa()), kernels(kernels_for(supported_isa())) {}
+};
+
+Dispatch& dispatch() {
+  static Dispatch d;
+  return d;
+}
+
+const Kernels& active() {
+  return *dispatch().kernels.load(std::memory_order_acquire);
+}
+
+// Below this many elements the call through the table costs more than it saves
+const size_t SMALL_SIZE = 4;
+
+}  // namespace
+
+Isa active_isa() { return dispatch().isa.load(std::memory_order_acquire); }
+
+const char* isa_name(Isa isa) {
+  switch (isa) {
+    case Isa::Avx512:
+      return "avx512";
+    case Isa::Avx2:
+      return "avx2";
+    case Isa::Sse2:
+      return "sse2";
+    case Isa::Scalar:
+      break;
+  }
+  return "scalar";
+}
+
+Isa set_isa(Isa isa) {
+  if (isa > supported_isa()) isa = supported_isa();
+  Dispatch& d = dispatch();
+  d.isa.store(isa, std::memory_order_release);
+  d.kernels.store(kernels_for(isa), std::memory_order_release);
+  return isa;
+}
+
+void add(double* dst, const double* src, size_t size) {
+  if (size < SMALL_SIZE) return add_scalar(dst, src, size);
+  active().add(dst, src, size);
+}
+
+void sub(double* dst, const double* src, size_t size) {
+  if (size < SMALL_SIZE) return sub_scalar(dst, src, size);
+  active().sub(dst, src, size);
+}
+
+void scale(double* dst, double factor, size_t size) {
+  if (size < SMALL_SIZE) return scale_scalar(dst, factor, size);
+  active().scale(dst, factor, size);
+}
+
+void negate(double* dst, const double* src, size_t size) {
+  if (size < SMALL_SIZE) return negate_scalar(dst, src, size);
+  active().negate(dst, src, size);
+}
+
+bool equal(const double* a, const double* b, size_t size, double eps) {
+  if (size < SMALL_SIZE) return equal_scalar(a, b, size, eps);
+  return active().equal(a, b, size, eps);
+}
+
+double dot(const double* a, const double* b, size_t size) {
+  if (size < SMALL_SIZE) return dot_scalar(a, b, size);
+  return active().dot(a, b, size);
+}
+
+void axpy(double* dst, double factor, const double* src, size_t size) {
+  if (size < SMALL_SIZE) return axpy_scalar(dst, factor, src, size);
+  active().axpy(dst, factor, src, size);
+}
+
+}  // namespace simd
+}  // namespace task
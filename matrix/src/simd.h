@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+// Defined where the x86 kernels are built, for every file that has some
+#if defined(__x86_64__) || defined(__i386__)
+#define TASK_SIMD_X86 1
+#endif
+
+namespace task {
+namespace simd {
+
+/*
+ * Instruction sets the element-wise kernels are compiled for. The best one
+ * supported by the running CPU is picked through CPUID on first use.
+ */
+enum class Isa { Scalar, Sse2, Avx2, Avx512 };
+
+Isa active_isa();
+const char* isa_name(Isa isa);
+
+/*
+ * Forces the kernels to a given instruction set, clamped to what the CPU
+ * supports. Returns the instruction set actually selected.
+ */
+Isa set_isa(Isa isa);
+
+// dst[i] += src[i]
+void add(double* dst, const double* src, size_t size);
+// dst[i] -= src[i]
+void sub(double* dst, const double* src, size_t size);
+// dst[i] *= factor
+void scale(double* dst, double factor, size_t size);
+// dst[i] = -src[i], dst may alias src
+void negate(double* dst, const double* src, size_t size);
+// true if |a[i] - b[i]| <= eps for every i
+bool equal(const double* a, const double* b, size_t size, double eps);
+// Sum of a[i] * b[i], summed in a vector of partial sums
+double dot(const double* a, const double* b, size_t size);
+// dst[i] += factor * src[i]
+void axpy(double* dst, double factor, const double* src, size_t size);
+
+}  // namespace simd
+}  // namespace task
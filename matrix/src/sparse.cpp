@@ -0,0 +1,466 @@
+#include "sparse.h"
+
+#include <algorithm>  // fill && lower_bound && min && sort && swap
+#include <cmath>      // fabs
+
+namespace task {
+
+namespace {
+
+// Rows handled by one task of a CSR product
+const size_t SPMV_ROWS_PER_TASK = 256;
+
+}  // namespace
+
+/*
+ * Constructors
+ */
+SparseMatrix::SparseMatrix() : SparseMatrix(1, 1) {}
+
+SparseMatrix::SparseMatrix(size_t rows, size_t cols, Format format)
+    : rows(rows), cols(cols), format(format) {
+  size_t diagonal = std::min(rows, cols);
+  offsets.resize(major() + 1);
+  for (size_t i = 0; i <= major(); ++i) offsets[i] = std::min(i, diagonal);
+  indices.resize(diagonal);
+  values.assign(diagonal, 1.);
+  for (size_t i = 0; i < diagonal; ++i) indices[i] = i;
+}
+
+SparseMatrix::SparseMatrix(const Matrix& dense, Format format, double drop)
+    : rows(dense.getRows()), cols(dense.getColumns()), format(format) {
+  const double* a = dense.view().getRawArray();
+  offsets.assign(major() + 1, 0);
+  for (size_t i = 0; i < major(); ++i) {
+    for (size_t j = 0; j < minor(); ++j) {
+      double value =
+          (format == Format::Csr) ? a[i * cols + j] : a[j * cols + i];
+      if (std::fabs(value) > drop) {
+        indices.push_back(j);
+        values.push_back(value);
+      }
+    }
+    offsets[i + 1] = indices.size();
+  }
+}
+
+SparseMatrix SparseMatrix::fromTriplets(size_t rows, size_t cols,
+                                        const std::vector<Triplet>& triplets,
+                                        Format format) {
+  // Build CSR and convert if needed; summing duplicates needs sorted rows
+  SparseMatrix m(rows, cols, Format::Csr);
+  m.offsets.assign(rows + 1, 0);
+  for (const Triplet& t : triplets) {
+    m.check_bound(t.row, t.col);
+    ++m.offsets[t.row + 1];
+  }
+  for (size_t i = 0; i < rows; ++i) m.offsets[i + 1] += m.offsets[i];
+
+  std::vector<size_t> next(m.offsets.begin(), m.offsets.end() - 1);
+  std::vector<size_t> indices(triplets.size());
+  std::vector<double> values(triplets.size());
+  for (const Triplet& t : triplets) {
+    size_t k = next[t.row]++;
+    indices[k] = t.col;
+    values[k] = t.value;
+  }
+
+  m.indices.clear();
+  m.values.clear();
+  std::vector<std::pair<size_t, double>> row;
+  size_t begin = 0;
+  for (size_t i = 0; i < rows; ++i) {
+    size_t end = m.offsets[i + 1];
+    row.clear();
+    for (size_t k = begin; k < end; ++k) {
+      row.emplace_back(indices[k], values[k]);
+    }
+    std::sort(row.begin(), row.end(),
+              [](const std::pair<size_t, double>& a,
+                 const std::pair<size_t, double>& b) {
+                return a.first < b.first;
+              });
+    for (size_t k = 0; k < row.size();) {
+      size_t col = row[k].first;
+      double sum = 0.;
+      for (; k < row.size() && row[k].first == col; ++k) sum += row[k].second;
+      if (sum != 0.) {
+        m.indices.push_back(col);
+        m.values.push_back(sum);
+      }
+    }
+    begin = end;
+    m.offsets[i + 1] = m.indices.size();
+  }
+
+  if (format == Format::Csc) return m.converted();
+  return m;
+}
+
+/*
+ * Private methods
+ */
+size_t SparseMatrix::major() const {
+  return (format == Format::Csr) ? rows : cols;
+}
+
+size_t SparseMatrix::minor() const {
+  return (format == Format::Csr) ? cols : rows;
+}
+
+void SparseMatrix::check_bound(size_t row, size_t col) const {
+  if (row >= rows || col >= cols) {
+    throw OutOfBoundsException();
+  }
+}
+
+void SparseMatrix::check_size(const SparseMatrix& a) const {
+  if (a.rows != rows || a.cols != cols) {
+    throw SizeMismatchException();
+  }
+}
+
+SparseMatrix SparseMatrix::converted() const {
+  SparseMatrix m(rows, cols,
+                 (format == Format::Csr) ? Format::Csc : Format::Csr);
+  m.offsets.assign(minor() + 1, 0);
+  for (size_t index : indices) ++m.offsets[index + 1];
+  for (size_t i = 0; i < minor(); ++i) m.offsets[i + 1] += m.offsets[i];
+
+  // Walking the old major slices in order keeps the new slices sorted
+  std::vector<size_t> next(m.offsets.begin(), m.offsets.end() - 1);
+  m.indices.resize(indices.size());
+  m.values.resize(values.size());
+  for (size_t i = 0; i < major(); ++i) {
+    for (size_t k = offsets[i]; k < offsets[i + 1]; ++k) {
+      size_t dst = next[indices[k]]++;
+      m.indices[dst] = i;
+      m.values[dst] = values[k];
+    }
+  }
+  return m;
+}
+
+const SparseMatrix& SparseMatrix::in_my_format(const SparseMatrix& a,
+                                               SparseMatrix& storage) const {
+  if (a.format == format) return a;
+  storage = a.converted();
+  return storage;
+}
+
+SparseMatrix SparseMatrix::add(const SparseMatrix& a, double sign) const {
+  check_size(a);
+  SparseMatrix storage;
+  const SparseMatrix& b = in_my_format(a, storage);
+
+  SparseMatrix m(rows, cols, format);
+  m.indices.clear();
+  m.values.clear();
+  m.indices.reserve(indices.size() + b.indices.size());
+  m.values.reserve(values.size() + b.values.size());
+
+  for (size_t i = 0; i < major(); ++i) {
+    size_t p = offsets[i], p_end = offsets[i + 1];
+    size_t q = b.offsets[i], q_end = b.offsets[i + 1];
+    while (p < p_end || q < q_end) {
+      size_t index;
+      double value;
+      if (q == q_end || (p < p_end && indices[p] < b.indices[q])) {
+        index = indices[p];
+        value = values[p++];
+      } else if (p == p_end || b.indices[q] < indices[p]) {
+        index = b.indices[q];
+        value = sign * b.values[q++];
+      } else {
+        index = indices[p];
+        value = values[p++] + sign * b.values[q++];
+      }
+      if (value != 0.) {
+        m.indices.push_back(index);
+        m.values.push_back(value);
+      }
+    }
+    m.offsets[i + 1] = m.indices.size();
+  }
+  return m;
+}
+
+/*
+ * Public methods
+ */
+Matrix SparseMatrix::toDense() const {
+  Matrix m(rows, cols, Matrix::Uninitialized());
+  double* a = m.getRawArray();
+  std::fill(a, a + rows * cols, 0.);
+  for (size_t i = 0; i < major(); ++i) {
+    for (size_t k = offsets[i]; k < offsets[i + 1]; ++k) {
+      if (format == Format::Csr) {
+        a[i * cols + indices[k]] = values[k];
+      } else {
+        a[indices[k] * cols + i] = values[k];
+      }
+    }
+  }
+  return m;
+}
+
+SparseMatrix SparseMatrix::toCsr() const {
+  return (format == Format::Csr) ? *this : converted();
+}
+
+SparseMatrix SparseMatrix::toCsc() const {
+  return (format == Format::Csc) ? *this : converted();
+}
+
+double SparseMatrix::get(size_t row, size_t col) const {
+  check_bound(row, col);
+  size_t i = (format == Format::Csr) ? row : col;
+  size_t j = (format == Format::Csr) ? col : row;
+  auto begin = indices.begin() + offsets[i];
+  auto end = indices.begin() + offsets[i + 1];
+  auto it = std::lower_bound(begin, end, j);
+  return (it != end && *it == j) ? values[it - indices.begin()] : 0.;
+}
+
+size_t SparseMatrix::getRows() const { return rows; }
+
+size_t SparseMatrix::getColumns() const { return cols; }
+
+size_t SparseMatrix::getNonZeros() const { return values.size(); }
+
+SparseMatrix::Format SparseMatrix::getFormat() const { return format; }
+
+const std::vector<size_t>& SparseMatrix::getOffsets() const {
+  return offsets;
+}
+
+const std::vector<size_t>& SparseMatrix::getIndices() const {
+  return indices;
+}
+
+const std::vector<double>& SparseMatrix::getValues() const { return values; }
+
+SparseMatrix& SparseMatrix::operator+=(const SparseMatrix& a) {
+  return *this = add(a, 1.);
+}
+
+SparseMatrix& SparseMatrix::operator-=(const SparseMatrix& a) {
+  return *this = add(a, -1.);
+}
+
+/*
+ * Gustavson's row-by-row product. In CSR, row i of A * B is the sum of
+ * rows k of B scaled by A(i, k). In CSC the same loop over columns computes
+ * B^T * A^T with the operands swapped, which is A * B stored by column.
+ */
+SparseMatrix& SparseMatrix::operator*=(const SparseMatrix& a) {
+  if (cols != a.rows) {
+    throw SizeMismatchException();
+  }
+
+  SparseMatrix storage;
+  const SparseMatrix& b = in_my_format(a, storage);
+  const SparseMatrix& outer = (format == Format::Csr) ? *this : b;
+  const SparseMatrix& inner = (format == Format::Csr) ? b : *this;
+
+  SparseMatrix m(rows, a.cols, format);
+  m.indices.clear();
+  m.values.clear();
+
+  std::vector<double> accumulator(m.minor(), 0.);
+  std::vector<bool> touched(m.minor(), false);
+  std::vector<size_t> pattern;
+
+  for (size_t i = 0; i < m.major(); ++i) {
+    pattern.clear();
+    for (size_t p = outer.offsets[i]; p < outer.offsets[i + 1]; ++p) {
+      size_t k = outer.indices[p];
+      double scale = outer.values[p];
+      for (size_t q = inner.offsets[k]; q < inner.offsets[k + 1]; ++q) {
+        size_t j = inner.indices[q];
+        if (!touched[j]) {
+          touched[j] = true;
+          pattern.push_back(j);
+        }
+        accumulator[j] += scale * inner.values[q];
+      }
+    }
+
+    std::sort(pattern.begin(), pattern.end());
+    for (size_t j : pattern) {
+      if (accumulator[j] != 0.) {
+        m.indices.push_back(j);
+        m.values.push_back(accumulator[j]);
+      }
+      accumulator[j] = 0.;
+      touched[j] = false;
+    }
+    m.offsets[i + 1] = m.indices.size();
+  }
+
+  return *this = std::move(m);
+}
+
+SparseMatrix& SparseMatrix::operator*=(const double& number) {
+  if (number == 0.) {
+    indices.clear();
+    values.clear();
+    std::fill(offsets.begin(), offsets.end(), 0);
+    return *this;
+  }
+  for (double& value : values) value *= number;
+  return *this;
+}
+
+SparseMatrix SparseMatrix::operator+(const SparseMatrix& a) const {
+  return add(a, 1.);
+}
+
+SparseMatrix SparseMatrix::operator-(const SparseMatrix& a) const {
+  return add(a, -1.);
+}
+
+SparseMatrix SparseMatrix::operator*(const SparseMatrix& a) const {
+  SparseMatrix m(*this);
+  m *= a;
+  return m;
+}
+
+SparseMatrix SparseMatrix::operator*(const double& a) const {
+  SparseMatrix m(*this);
+  m *= a;
+  return m;
+}
+
+SparseMatrix operator*(const double& a, const SparseMatrix& b) {
+  return b * a;
+}
+
+Matrix SparseMatrix::operator*(const Matrix& a) const {
+  if (cols != a.getRows()) {
+    throw SizeMismatchException();
+  }
+
+  size_t n = a.getColumns();
+  Matrix m(rows, n, Matrix::Uninitialized());
+  double* c = m.getRawArray();
+  const double* b = a.view().getRawArray();
+  std::fill(c, c + rows * n, 0.);
+
+  // Row i of the result gathers rows k of a scaled by A(i, k)
+  for (size_t i = 0; i < major(); ++i) {
+    for (size_t p = offsets[i]; p < offsets[i + 1]; ++p) {
+      size_t row = (format == Format::Csr) ? i : indices[p];
+      size_t k = (format == Format::Csr) ? indices[p] : i;
+      double scale = values[p];
+      double* c_row = c + row * n;
+      const double* b_row = b + k * n;
+      for (size_t j = 0; j < n; ++j) c_row[j] += scale * b_row[j];
+    }
+  }
+  return m;
+}
+
+std::vector<double> SparseMatrix::operator*(
+    const std::vector<double>& x) const {
+  return multiply(x, ExecutionPolicy::sequential());
+}
+
+std::vector<double> SparseMatrix::multiply(
+    const std::vector<double>& x, const ExecutionPolicy& policy) const {
+  if (x.size() != cols) {
+    throw SizeMismatchException();
+  }
+
+  std::vector<double> y(rows, 0.);
+
+  if (format == Format::Csr) {
+    size_t tasks = (rows + SPMV_ROWS_PER_TASK - 1) / SPMV_ROWS_PER_TASK;
+    policy.parallel_for(tasks, [&](size_t t) {
+      size_t end = std::min(rows, (t + 1) * SPMV_ROWS_PER_TASK);
+      for (size_t i = t * SPMV_ROWS_PER_TASK; i < end; ++i) {
+        double sum = 0.;
+        for (size_t k = offsets[i]; k < offsets[i + 1]; ++k) {
+          sum += values[k] * x[indices[k]];
+        }
+        y[i] = sum;
+      }
+    });
+    return y;
+  }
+
+  // Columns scatter into y: each task sums its own columns into a private
+  // vector, then the partial vectors are added in task order
+  size_t tasks = std::min(policy.getThreads(), cols);
+  if (tasks <= 1) {
+    for (size_t j = 0; j < cols; ++j) {
+      for (size_t k = offsets[j]; k < offsets[j + 1]; ++k) {
+        y[indices[k]] += values[k] * x[j];
+      }
+    }
+    return y;
+  }
+
+  std::vector<std::vector<double>> partial(tasks);
+  policy.parallel_for(tasks, [&](size_t t) {
+    std::vector<double>& local = partial[t];
+    local.assign(rows, 0.);
+    for (size_t j = cols * t / tasks; j < cols * (t + 1) / tasks; ++j) {
+      for (size_t k = offsets[j]; k < offsets[j + 1]; ++k) {
+        local[indices[k]] += values[k] * x[j];
+      }
+    }
+  });
+  for (const std::vector<double>& local : partial) {
+    for (size_t i = 0; i < rows; ++i) y[i] += local[i];
+  }
+  return y;
+}
+
+SparseMatrix SparseMatrix::operator-() const {
+  SparseMatrix m(*this);
+  for (double& value : m.values) value = -value;
+  return m;
+}
+
+SparseMatrix SparseMatrix::operator+() const { return SparseMatrix(*this); }
+
+SparseMatrix SparseMatrix::transposed() const {
+  SparseMatrix m(*this);
+  m.transpose();
+  return m;
+}
+
+void SparseMatrix::transpose() {
+  std::swap(rows, cols);
+  format = (format == Format::Csr) ? Format::Csc : Format::Csr;
+}
+
+bool SparseMatrix::operator==(const SparseMatrix& a) const {
+  if (a.rows != rows || a.cols != cols) return false;
+  SparseMatrix storage;
+  const SparseMatrix& b = in_my_format(a, storage);
+
+  for (size_t i = 0; i < major(); ++i) {
+    size_t p = offsets[i], p_end = offsets[i + 1];
+    size_t q = b.offsets[i], q_end = b.offsets[i + 1];
+    while (p < p_end || q < q_end) {
+      double diff;
+      if (q == q_end || (p < p_end && indices[p] < b.indices[q])) {
+        diff = values[p++];
+      } else if (p == p_end || b.indices[q] < indices[p]) {
+        diff = b.values[q++];
+      } else {
+        diff = values[p++] - b.values[q++];
+      }
+      if (std::fabs(diff) > EPS) return false;
+    }
+  }
+  return true;
+}
+
+bool SparseMatrix::operator!=(const SparseMatrix& a) const {
+  return !(*this == a);
+}
+
+}  // namespace task
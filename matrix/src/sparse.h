@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "matrix.h"
+
+namespace task {
+
+/*
+ * Compressed sparse matrix in row (CSR) or column (CSC) form. Along the
+ * major dimension (rows for CSR, columns for CSC) offsets[i]..offsets[i+1]
+ * index the stored entries of slice i, sorted by their minor index.
+ * Explicit zeros are never stored.
+ *
+ * Operators mirror Matrix: results of +, - and * take the format of the
+ * left operand, shape mismatches throw SizeMismatchException and ==
+ * compares with EPS, treating missing entries as zeros.
+ */
+class SparseMatrix {
+ public:
+  enum class Format { Csr, Csc };
+
+  struct Triplet {
+    size_t row;
+    size_t col;
+    double value;
+  };
+
+  // Ones on the main diagonal, zeros elsewhere, as Matrix(rows, cols)
+  SparseMatrix();
+  SparseMatrix(size_t rows, size_t cols, Format format = Format::Csr);
+
+  // Keeps the entries of dense with |value| > drop
+  explicit SparseMatrix(const Matrix& dense, Format format = Format::Csr,
+                        double drop = 0.);
+
+  // Duplicate positions are summed
+  static SparseMatrix fromTriplets(size_t rows, size_t cols,
+                                   const std::vector<Triplet>& triplets,
+                                   Format format = Format::Csr);
+
+  Matrix toDense() const;
+  SparseMatrix toCsr() const;
+  SparseMatrix toCsc() const;
+
+  // Zero for entries that are not stored
+  double get(size_t row, size_t col) const;
+
+  SparseMatrix& operator+=(const SparseMatrix& a);
+  SparseMatrix& operator-=(const SparseMatrix& a);
+  SparseMatrix& operator*=(const SparseMatrix& a);
+  SparseMatrix& operator*=(const double& number);
+
+  SparseMatrix operator+(const SparseMatrix& a) const;
+  SparseMatrix operator-(const SparseMatrix& a) const;
+  SparseMatrix operator*(const SparseMatrix& a) const;
+  SparseMatrix operator*(const double& a) const;
+  Matrix operator*(const Matrix& a) const;
+  std::vector<double> operator*(const std::vector<double>& x) const;
+
+  SparseMatrix operator-() const;
+  SparseMatrix operator+() const;
+
+  /*
+   * y = A * x with the rows (CSR) or columns (CSC) split over the threads
+   * of policy. CSC partial sums are reduced in a fixed order, so results
+   * are reproducible for a given thread count.
+   */
+  std::vector<double> multiply(const std::vector<double>& x,
+                               const ExecutionPolicy& policy) const;
+
+  // No reordering: CSR of A^T has the same arrays as CSC of A
+  SparseMatrix transposed() const;
+  void transpose();
+
+  bool operator==(const SparseMatrix& a) const;
+  bool operator!=(const SparseMatrix& a) const;
+
+  size_t getRows() const;
+  size_t getColumns() const;
+  size_t getNonZeros() const;
+  Format getFormat() const;
+
+  const std::vector<size_t>& getOffsets() const;
+  const std::vector<size_t>& getIndices() const;
+  const std::vector<double>& getValues() const;
+
+ private:
+  size_t rows = 1;
+  size_t cols = 1;
+  Format format = Format::Csr;
+  std::vector<size_t> offsets;
+  std::vector<size_t> indices;
+  std::vector<double> values;
+
+  size_t major() const;
+  size_t minor() const;
+  void check_bound(size_t row, size_t col) const;
+  void check_size(const SparseMatrix& a) const;
+  // Same matrix in the other storage format
+  SparseMatrix converted() const;
+  // a itself, or a converted into storage when its format differs
+  const SparseMatrix& in_my_format(const SparseMatrix& a,
+                                   SparseMatrix& storage) const;
+  // this + sign * a, entry by entry
+  SparseMatrix add(const SparseMatrix& a, double sign) const;
+};
+
+SparseMatrix operator*(const double& a, const SparseMatrix& b);
+
+}  // namespace task
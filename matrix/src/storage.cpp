@@ -0,0 +1,202 @@
+#include "storage.h"
+
+#include <new>
+
+namespace task {
+
+namespace {
+
+/*
+ * Every block starts with a header recording where it came from, padded to
+ * a full alignment unit so the elements stay aligned.
+ */
+struct BlockHeader {
+  MatrixAllocator* allocator;
+  size_t bytes;
+};
+
+const size_t HEADER_BYTES = STORAGE_ALIGNMENT;
+static_assert(sizeof(BlockHeader) <= HEADER_BYTES, "header does not fit");
+
+// Size classes are powers of two from 256 bytes to POOL_MAX_BYTES
+const size_t POOL_MIN_SHIFT = 8;
+const size_t POOL_MAX_SHIFT = 22;
+const size_t POOL_MAX_BYTES = size_t(1) << POOL_MAX_SHIFT;
+const size_t POOL_CLASSES = POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1;
+// Cached blocks per size class and thread, within MAX_CACHED_BYTES
+const size_t POOL_DEPTH = 8;
+
+thread_local MatrixAllocator* current_allocator = nullptr;
+
+MatrixAllocator& current() {
+  if (!current_allocator) current_allocator = &PoolAllocator::instance();
+  return *current_allocator;
+}
+
+void* aligned_new(size_t bytes) {
+  return ::operator new(bytes, std::align_val_t(STORAGE_ALIGNMENT));
+}
+
+void aligned_delete(void* block) {
+  ::operator delete(block, std::align_val_t(STORAGE_ALIGNMENT));
+}
+
+size_t size_class(size_t bytes) {
+  size_t shift = POOL_MIN_SHIFT;
+  while ((size_t(1) << shift) < bytes) ++shift;
+  return shift - POOL_MIN_SHIFT;
+}
+
+// Set once the free lists of the thread are gone, during thread exit
+thread_local bool free_lists_destroyed = false;
+
+/*
+ * Free lists of the calling thread. Blocks may be freed by another thread
+ * than the one that allocated them; they simply join its lists.
+ */
+struct FreeLists {
+  std::vector<void*> blocks[POOL_CLASSES];
+  // Bytes in all of blocks, at most PoolAllocator::MAX_CACHED_BYTES
+  size_t cached_bytes = 0;
+
+  void trim() {
+    for (std::vector<void*>& list : blocks) {
+      for (void* block : list) aligned_delete(block);
+      list.clear();
+    }
+    cached_bytes = 0;
+  }
+
+  ~FreeLists() {
+    trim();
+    free_lists_destroyed = true;
+  }
+};
+
+// nullptr when called after the lists were destroyed
+FreeLists* free_lists() {
+  if (free_lists_destroyed) {
+    return nullptr;
+  }
+  thread_local FreeLists lists;
+  return &lists;
+}
+
+}  // namespace
+
+/*
+ * PoolAllocator
+ */
+PoolAllocator& PoolAllocator::instance() {
+  static PoolAllocator allocator;
+  return allocator;
+}
+
+void* PoolAllocator::allocate(size_t bytes) {
+  if (bytes > POOL_MAX_BYTES) {
+    return aligned_new(bytes);
+  }
+  size_t index = size_class(bytes);
+  size_t class_bytes = size_t(1) << (index + POOL_MIN_SHIFT);
+  FreeLists* lists = free_lists();
+  if (lists && !lists->blocks[index].empty()) {
+    void* block = lists->blocks[index].back();
+    lists->blocks[index].pop_back();
+    lists->cached_bytes -= class_bytes;
+    return block;
+  }
+  return aligned_new(class_bytes);
+}
+
+void PoolAllocator::deallocate(void* block, size_t bytes) {
+  if (bytes > POOL_MAX_BYTES) {
+    aligned_delete(block);
+    return;
+  }
+  size_t index = size_class(bytes);
+  size_t class_bytes = size_t(1) << (index + POOL_MIN_SHIFT);
+  FreeLists* lists = free_lists();
+  if (lists && lists->blocks[index].size() < POOL_DEPTH &&
+      lists->cached_bytes + class_bytes <= MAX_CACHED_BYTES) {
+    lists->blocks[index].push_back(block);
+    lists->cached_bytes += class_bytes;
+    return;
+  }
+  aligned_delete(block);
+}
+
+void PoolAllocator::trim() {
+  FreeLists* lists = free_lists();
+  if (lists) lists->trim();
+}
+
+size_t PoolAllocator::getCachedBytes() const {
+  FreeLists* lists = free_lists();
+  return lists ? lists->cached_bytes : 0;
+}
+
+/*
+ * ArenaAllocator
+ */
+ArenaAllocator::ArenaAllocator(size_t chunk_bytes)
+    : chunk_bytes(chunk_bytes) {}
+
+ArenaAllocator::~ArenaAllocator() {
+  for (Chunk& chunk : chunks) aligned_delete(chunk.data);
+}
+
+void* ArenaAllocator::allocate(size_t bytes) {
+  bytes = (bytes + STORAGE_ALIGNMENT - 1) / STORAGE_ALIGNMENT *
+          STORAGE_ALIGNMENT;
+  while (current < chunks.size() && offset + bytes > chunks[current].size) {
+    ++current;
+    offset = 0;
+  }
+  if (current == chunks.size()) {
+    size_t size = bytes > chunk_bytes ? bytes : chunk_bytes;
+    chunks.push_back({static_cast<char*>(aligned_new(size)), size});
+    offset = 0;
+  }
+  void* block = chunks[current].data + offset;
+  offset += bytes;
+  return block;
+}
+
+void ArenaAllocator::deallocate(void*, size_t) {}
+
+void ArenaAllocator::reset() {
+  current = 0;
+  offset = 0;
+}
+
+/*
+ * ScopedAllocator
+ */
+ScopedAllocator::ScopedAllocator(MatrixAllocator& allocator)
+    : previous(&current()) {
+  current_allocator = &allocator;
+}
+
+ScopedAllocator::~ScopedAllocator() { current_allocator = previous; }
+
+/*
+ * storage
+ */
+double* storage::allocate(size_t size) {
+  MatrixAllocator& allocator = current();
+  size_t bytes = HEADER_BYTES + size * sizeof(double);
+  char* block = static_cast<char*>(allocator.allocate(bytes));
+  new (block) BlockHeader{&allocator, bytes};
+  return reinterpret_cast<double*>(block + HEADER_BYTES);
+}
+
+void storage::release(double* data) {
+  if (!data) {
+    return;
+  }
+  char* block = reinterpret_cast<char*>(data) - HEADER_BYTES;
+  BlockHeader* header = reinterpret_cast<BlockHeader*>(block);
+  header->allocator->deallocate(block, header->bytes);
+}
+
+}  // namespace task
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace task {
+
+// Alignment of every heap block handed to Matrix, one cache line
+const size_t STORAGE_ALIGNMENT = 64;
+
+/*
+ * Source of Matrix element storage. allocate() must return memory aligned
+ * to STORAGE_ALIGNMENT; deallocate() gets back the same pointer and size.
+ * A block is always returned to the allocator that produced it, whichever
+ * allocator is current at that time.
+ */
+class MatrixAllocator {
+ public:
+  virtual ~MatrixAllocator() = default;
+  virtual void* allocate(size_t bytes) = 0;
+  virtual void deallocate(void* block, size_t bytes) = 0;
+};
+
+/*
+ * Default allocator. Freed blocks up to 4 MiB are kept in per thread free
+ * lists by power-of-two size class and handed out again, so temporaries
+ * created and dropped in a loop stop reaching malloc. A thread caches at
+ * most MAX_CACHED_BYTES in all; blocks freed beyond that, and larger
+ * blocks, go straight back to the system. The cache of a thread is freed
+ * when it exits, or earlier by trim().
+ */
+class PoolAllocator : public MatrixAllocator {
+ public:
+  static constexpr size_t MAX_CACHED_BYTES = size_t(8) << 20;
+
+  static PoolAllocator& instance();
+
+  void* allocate(size_t bytes) override;
+  void deallocate(void* block, size_t bytes) override;
+
+  // Returns the blocks cached by the calling thread to the system
+  void trim();
+  // Bytes in the blocks cached by the calling thread
+  size_t getCachedBytes() const;
+
+ private:
+  PoolAllocator() = default;
+};
+
+/*
+ * Monotonic arena: allocation bumps a pointer inside large chunks and
+ * deallocation does nothing until reset(). Meant for a batch of
+ * short-lived matrices; the arena must outlive every matrix it backs.
+ *
+ * Not thread-safe: allocate() and reset() must not run concurrently, so
+ * give each thread its own arena. A ScopedAllocator only affects its own
+ * thread, and the worker threads of a parallel ExecutionPolicy keep their
+ * pools, so one arena per thread is enough. Matrices it backs may be read
+ * and destroyed on any thread.
+ */
+class ArenaAllocator : public MatrixAllocator {
+ public:
+  explicit ArenaAllocator(size_t chunk_bytes = 1 << 20);
+  ~ArenaAllocator() override;
+
+  ArenaAllocator(const ArenaAllocator&) = delete;
+  ArenaAllocator& operator=(const ArenaAllocator&) = delete;
+
+  void* allocate(size_t bytes) override;
+  void deallocate(void* block, size_t bytes) override;
+
+  // Makes all the memory reusable; matrices backed by it must be gone
+  void reset();
+
+ private:
+  struct Chunk {
+    char* data;
+    size_t size;
+  };
+
+  size_t chunk_bytes;
+  std::vector<Chunk> chunks;
+  size_t current = 0;
+  size_t offset = 0;
+};
+
+/*
+ * Makes allocator the current one of the calling thread for the lifetime
+ * of the guard. Guards nest.
+ */
+class ScopedAllocator {
+ public:
+  explicit ScopedAllocator(MatrixAllocator& allocator);
+  ~ScopedAllocator();
+
+  ScopedAllocator(const ScopedAllocator&) = delete;
+  ScopedAllocator& operator=(const ScopedAllocator&) = delete;
+
+ private:
+  MatrixAllocator* previous;
+};
+
+namespace storage {
+
+// size doubles from the current allocator of the calling thread
+double* allocate(size_t size);
+// Gives a block from allocate() back to its allocator, nullptr is ignored
+void release(double* data);
+
+}  // namespace storage
+}  // namespace task
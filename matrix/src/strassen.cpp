@@ -0,0 +1,123 @@
+#include "strassen.h"
+
+#include <algorithm>  // max
+#include <atomic>
+#include <vector>
+
+#include "gemm.h"
+
+namespace task {
+
+namespace {
+
+// Below this the extra additions cost more than the saved product
+const size_t MIN_CUTOFF = 32;
+
+std::atomic<size_t> cutoff_setting{0};
+
+// c = a + b on n x n blocks
+void add(size_t n, const double* a, size_t lda, const double* b, size_t ldb,
+         double* c, size_t ldc) {
+  for (size_t i = 0; i < n; ++i) {
+    const double* a_row = a + i * lda;
+    const double* b_row = b + i * ldb;
+    double* c_row = c + i * ldc;
+    for (size_t j = 0; j < n; ++j) c_row[j] = a_row[j] + b_row[j];
+  }
+}
+
+// c = a - b on n x n blocks
+void sub(size_t n, const double* a, size_t lda, const double* b, size_t ldb,
+         double* c, size_t ldc) {
+  for (size_t i = 0; i < n; ++i) {
+    const double* a_row = a + i * lda;
+    const double* b_row = b + i * ldb;
+    double* c_row = c + i * ldc;
+    for (size_t j = 0; j < n; ++j) c_row[j] = a_row[j] - b_row[j];
+  }
+}
+
+size_t workspace_size(size_t n, size_t cutoff) {
+  size_t size = 0;
+  for (; n >= cutoff; n /= 2) size += 2 * (n / 2) * (n / 2);
+  return size;
+}
+
+/*
+ * One level of the Winograd variant, scheduled after Boyer, Dumas, Pernet
+ * and Zhou so that the seven products land in the quadrants of C and in
+ * two h x h temporaries X and Y.
+ */
+void winograd(size_t n, const double* a, size_t lda, const double* b,
+              size_t ldb, double* c, size_t ldc, size_t cutoff, double* work,
+              const ExecutionPolicy& policy) {
+  if (n < cutoff) {
+    gemm(n, n, n, 1., a, lda, b, ldb, 0., c, ldc, policy);
+    return;
+  }
+
+  size_t h = n / 2;
+  const double* a11 = a;
+  const double* a12 = a + h;
+  const double* a21 = a + h * lda;
+  const double* a22 = a21 + h;
+  const double* b11 = b;
+  const double* b12 = b + h;
+  const double* b21 = b + h * ldb;
+  const double* b22 = b21 + h;
+  double* c11 = c;
+  double* c12 = c + h;
+  double* c21 = c + h * ldc;
+  double* c22 = c21 + h;
+  double* x = work;
+  double* y = work + h * h;
+  double* rest = y + h * h;
+
+  sub(h, a11, lda, a21, lda, x, h);                         // S3
+  sub(h, b22, ldb, b12, ldb, y, h);                         // T3
+  winograd(h, x, h, y, h, c21, ldc, cutoff, rest, policy);  // P7
+  add(h, a21, lda, a22, lda, x, h);                         // S1
+  sub(h, b12, ldb, b11, ldb, y, h);                         // T1
+  winograd(h, x, h, y, h, c22, ldc, cutoff, rest, policy);  // P5
+  sub(h, x, h, a11, lda, x, h);                             // S2
+  sub(h, b22, ldb, y, h, y, h);                             // T2
+  winograd(h, x, h, y, h, c12, ldc, cutoff, rest, policy);  // P6
+  sub(h, a12, lda, x, h, x, h);                             // S4
+  winograd(h, x, h, b22, ldb, c11, ldc, cutoff, rest, policy);  // P3
+  winograd(h, a11, lda, b11, ldb, x, h, cutoff, rest, policy);  // P1
+  add(h, x, h, c12, ldc, c12, ldc);                             // U2
+  add(h, c12, ldc, c21, ldc, c21, ldc);                         // U3
+  add(h, c12, ldc, c22, ldc, c12, ldc);                         // U4
+  add(h, c21, ldc, c22, ldc, c22, ldc);                         // U7
+  add(h, c12, ldc, c11, ldc, c12, ldc);                         // U5
+  sub(h, y, h, b21, ldb, y, h);                                 // T4
+  winograd(h, a22, lda, y, h, c11, ldc, cutoff, rest, policy);  // P4
+  sub(h, c21, ldc, c11, ldc, c21, ldc);                         // U6
+  winograd(h, a12, lda, b21, ldb, c11, ldc, cutoff, rest, policy);  // P2
+  add(h, x, h, c11, ldc, c11, ldc);                                 // U1
+
+  if (n % 2 == 0) {
+    return;
+  }
+  // Odd order: add the peeled rank-1 term, then the last column and row
+  size_t m = n - 1;
+  gemm(m, m, 1, 1., a + m, lda, b + m * ldb, ldb, 1., c, ldc, policy);
+  gemm(m, 1, n, 1., a, lda, b + m, ldb, 0., c + m, ldc, policy);
+  gemm(1, n, n, 1., a + m * lda, lda, b, ldb, 0., c + m * ldc, ldc, policy);
+}
+
+}  // namespace
+
+void strassen(size_t n, const double* a, size_t lda, const double* b,
+              size_t ldb, double* c, size_t ldc, size_t cutoff,
+              const ExecutionPolicy& policy) {
+  cutoff = std::max(cutoff, MIN_CUTOFF);
+  std::vector<double> work(workspace_size(n, cutoff));
+  winograd(n, a, lda, b, ldb, c, ldc, cutoff, work.data(), policy);
+}
+
+void set_strassen_cutoff(size_t cutoff) { cutoff_setting = cutoff; }
+
+size_t strassen_cutoff() { return cutoff_setting; }
+
+}  // namespace task
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+#include "thread_pool.h"
+
+namespace task {
+
+/*
+ * Strassen-Winograd multiplication of square row-major blocks:
+ *   C = A * B, all three n x n
+ * Each level replaces 8 half-size products by 7 products and 15 additions,
+ * recursing while n >= cutoff and handing smaller blocks to gemm. Odd
+ * orders peel off the last row and column and fix them up with gemm.
+ *
+ * Scratch is two half-size temporaries per level, allocated once per call:
+ * less than 2/3 * n * n doubles in total.
+ *
+ * Accuracy: the classic product is accurate element by element, the
+ * error of every c_ij being bounded by sum_k |a_ik| * |b_kj|. The
+ * Strassen-Winograd error is only bounded normwise, by max|A| * max|B|
+ * times a factor that grows by about 12 per level instead of 2. Elements
+ * much smaller than the largest of the product can lose all their
+ * significant digits, so keep this path for well-scaled operands.
+ */
+void strassen(size_t n, const double* a, size_t lda, const double* b,
+              size_t ldb, double* c, size_t ldc, size_t cutoff,
+              const ExecutionPolicy& policy);
+
+/*
+ * Square Matrix products of order >= cutoff go through strassen(), with the
+ * same cutoff as the base case. 0, the default, keeps the classic path for
+ * every size.
+ */
+void set_strassen_cutoff(size_t cutoff);
+size_t strassen_cutoff();
+
+}  // namespace task
@@ -0,0 +1,166 @@
+#include "thread_pool.h"
+
+#include <algorithm>  // min, max
+#include <exception>
+#include <map>
+
+namespace task {
+
+namespace {
+
+// Slot of the current thread in the pool it belongs to, 0 for outsiders
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_slot = 0;
+
+// Tasks per thread a batch is cut into, so that stealing can balance load
+const size_t CHUNKS_PER_THREAD = 4;
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t threads) {
+  threads = std::max<size_t>(threads, 1);
+  for (size_t i = 0; i < threads; ++i) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  // Slot 0 belongs to callers of parallel_for
+  for (size_t i = 1; i < threads; ++i) {
+    workers.emplace_back(&ThreadPool::worker_loop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    stop = true;
+  }
+  wake.notify_all();
+  for (std::thread& worker : workers) worker.join();
+}
+
+size_t ThreadPool::size() const { return queues.size(); }
+
+void ThreadPool::push(size_t slot, Task task) {
+  {
+    std::lock_guard<std::mutex> lock(queues[slot]->mutex);
+    queues[slot]->tasks.push_back(std::move(task));
+  }
+  queued.fetch_add(1, std::memory_order_release);
+}
+
+bool ThreadPool::pop(size_t self, Task& task) {
+  if (queued.load(std::memory_order_acquire) == 0) return false;
+
+  for (size_t i = 0; i < queues.size(); ++i) {
+    size_t slot = (self + i) % queues.size();
+    Queue& queue = *queues[slot];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) continue;
+    if (slot == self) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    queued.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::worker_loop(size_t self) {
+  current_pool = this;
+  current_slot = self;
+
+  Task task;
+  while (true) {
+    if (pop(self, task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    wake.wait(lock, [this] {
+      return stop || queued.load(std::memory_order_acquire) > 0;
+    });
+    if (stop) return;
+  }
+}
+
+void ThreadPool::parallel_for(size_t count,
+                              const std::function<void(size_t)>& body) {
+  if (count == 0) return;
+
+  size_t chunks = std::min(count, size() * CHUNKS_PER_THREAD);
+  if (chunks == 1) {
+    for (size_t i = 0; i < count; ++i) body(i);
+    return;
+  }
+
+  std::atomic<size_t> remaining{chunks};
+  std::mutex error_mutex;
+  std::exception_ptr error;
+
+  size_t self = (current_pool == this) ? current_slot : 0;
+  for (size_t c = 0; c < chunks; ++c) {
+    size_t begin = count * c / chunks;
+    size_t end = count * (c + 1) / chunks;
+    push((self + c) % size(), [&, begin, end] {
+      try {
+        for (size_t i = begin; i < end; ++i) body(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = std::current_exception();
+      }
+      remaining.fetch_sub(1, std::memory_order_acq_rel);
+    });
+  }
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+  }
+  wake.notify_all();
+
+  // Help with the batch (or anything else queued) until it is finished
+  Task task;
+  while (remaining.load(std::memory_order_acquire) > 0) {
+    if (pop(self, task)) {
+      task();
+      task = nullptr;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  if (error) std::rethrow_exception(error);
+}
+
+ThreadPool& ThreadPool::shared(size_t threads) {
+  static std::mutex mutex;
+  static std::map<size_t, std::unique_ptr<ThreadPool>> pools;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unique_ptr<ThreadPool>& pool = pools[threads];
+  if (!pool) pool = std::make_unique<ThreadPool>(threads);
+  return *pool;
+}
+
+/*
+ * ExecutionPolicy
+ */
+ExecutionPolicy::ExecutionPolicy(size_t threads) : threads(threads) {}
+
+ExecutionPolicy ExecutionPolicy::sequential() { return ExecutionPolicy(1); }
+
+ExecutionPolicy ExecutionPolicy::parallel(size_t threads) {
+  if (threads == 0) threads = std::thread::hardware_concurrency();
+  return ExecutionPolicy(std::max<size_t>(threads, 1));
+}
+
+size_t ExecutionPolicy::getThreads() const { return threads; }
+
+void ExecutionPolicy::run_parallel(
+    size_t count, const std::function<void(size_t)>& body) const {
+  ThreadPool::shared(threads).parallel_for(count, body);
+}
+
+}  // namespace task
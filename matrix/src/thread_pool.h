@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace task {
+
+/*
+ * Work-stealing thread pool. Every worker owns a deque: it pops its own
+ * tasks from the back and steals from the front of the others when empty.
+ * The thread calling parallel_for works on the batch too, so a pool of
+ * size n runs n - 1 background threads.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t size() const;
+
+  /*
+   * Calls body(i) for every i in [0, count) and returns when all calls are
+   * done. The first exception thrown by body is rethrown here.
+   */
+  void parallel_for(size_t count, const std::function<void(size_t)>& body);
+
+  // Process-wide pool with the given number of threads, created on demand
+  static ThreadPool& shared(size_t threads);
+
+ private:
+  using Task = std::function<void()>;
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  std::mutex wake_mutex;
+  std::condition_variable wake;
+  std::atomic<size_t> queued{0};
+  bool stop = false;
+
+  void push(size_t slot, Task task);
+  bool pop(size_t self, Task& task);
+  void worker_loop(size_t self);
+};
+
+/*
+ * Opt-in execution policy for Matrix operations. Work is split into
+ * independent pieces whose results do not depend on which thread runs
+ * them, so results are the same for any thread count.
+ */
+class ExecutionPolicy {
+ public:
+  static ExecutionPolicy sequential();
+  // threads == 0 means std::thread::hardware_concurrency()
+  static ExecutionPolicy parallel(size_t threads = 0);
+
+  size_t getThreads() const;
+
+  /*
+   * Runs body(i) for i in [0, count). The sequential case calls body
+   * directly, without wrapping it into a std::function.
+   */
+  template <class F>
+  void parallel_for(size_t count, const F& body) const {
+    if (threads <= 1 || count <= 1) {
+      for (size_t i = 0; i < count; ++i) body(i);
+      return;
+    }
+    run_parallel(count, std::cref(body));
+  }
+
+ private:
+  size_t threads = 1;
+
+  explicit ExecutionPolicy(size_t threads);
+
+  void run_parallel(size_t count,
+                    const std::function<void(size_t)>& body) const;
+};
+
+}  // namespace task
@@ -0,0 +1,91 @@
+#include "transpose.h"
+
+#include <utility>  // swap
+#include <vector>
+
+namespace task {
+
+namespace {
+
+// Blocks with at most this many rows and columns are handled directly
+const size_t LEAF = 16;
+
+/*
+ * Swaps block a (rows x cols) with the transpose of block b (cols x rows),
+ * i.e. a[i][j] <-> b[j][i]. Used for the off-diagonal halves of a square.
+ */
+void transpose_swap(size_t rows, size_t cols, double* a, double* b,
+                    size_t ld) {
+  if (rows <= LEAF && cols <= LEAF) {
+    for (size_t i = 0; i < rows; ++i)
+      for (size_t j = 0; j < cols; ++j) std::swap(a[i * ld + j], b[j * ld + i]);
+    return;
+  }
+  if (rows >= cols) {
+    size_t half = rows / 2;
+    transpose_swap(half, cols, a, b, ld);
+    transpose_swap(rows - half, cols, a + half * ld, b + half, ld);
+  } else {
+    size_t half = cols / 2;
+    transpose_swap(rows, half, a, b, ld);
+    transpose_swap(rows, cols - half, a + half, b + half * ld, ld);
+  }
+}
+
+}  // namespace
+
+void transpose_copy(size_t rows, size_t cols, const double* src, size_t lds,
+                    double* dst, size_t ldd) {
+  if (rows <= LEAF && cols <= LEAF) {
+    for (size_t i = 0; i < rows; ++i)
+      for (size_t j = 0; j < cols; ++j) dst[j * ldd + i] = src[i * lds + j];
+    return;
+  }
+  if (rows >= cols) {
+    size_t half = rows / 2;
+    transpose_copy(half, cols, src, lds, dst, ldd);
+    transpose_copy(rows - half, cols, src + half * lds, lds, dst + half, ldd);
+  } else {
+    size_t half = cols / 2;
+    transpose_copy(rows, half, src, lds, dst, ldd);
+    transpose_copy(rows, cols - half, src + half, lds, dst + half * ldd, ldd);
+  }
+}
+
+void transpose_square(size_t n, double* a, size_t lda) {
+  if (n <= LEAF) {
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = i + 1; j < n; ++j)
+        std::swap(a[i * lda + j], a[j * lda + i]);
+    return;
+  }
+  size_t half = n / 2;
+  transpose_square(half, a, lda);
+  transpose_square(n - half, a + half * lda + half, lda);
+  transpose_swap(half, n - half, a + half, a + half * lda, lda);
+}
+
+void transpose_in_place(size_t rows, size_t cols, double* a) {
+  if (rows == cols) {
+    transpose_square(rows, a, cols);
+    return;
+  }
+
+  // Element (i, j) at index i * cols + j moves to j * rows + i. The first
+  // and the last element stay where they are.
+  size_t size = rows * cols;
+  std::vector<bool> moved(size);
+  for (size_t start = 1; start + 1 < size; ++start) {
+    if (moved[start]) continue;
+    double carried = a[start];
+    size_t k = start;
+    do {
+      size_t next = (k % cols) * rows + k / cols;
+      std::swap(a[next], carried);
+      moved[next] = true;
+      k = next;
+    } while (k != start);
+  }
+}
+
+}  // namespace task
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+namespace task {
+
+/*
+ * Cache-oblivious transposition of row-major blocks. The block is split
+ * in halves along its longer side until it fits in L1, so every level of
+ * the cache hierarchy sees whole tiles without tuning for its size.
+ */
+
+// dst (cols x rows, leading dimension ldd) = transpose of src (rows x cols)
+void transpose_copy(size_t rows, size_t cols, const double* src, size_t lds,
+                    double* dst, size_t ldd);
+
+// Transposes the n x n block a in place
+void transpose_square(size_t n, double* a, size_t lda);
+
+/*
+ * Transposes a contiguous rows x cols matrix in place into cols x rows by
+ * following the cycles of the index permutation. Needs one bit of scratch
+ * per element instead of a second buffer.
+ */
+void transpose_in_place(size_t rows, size_t cols, double* a);
+
+}  // namespace task
@@ -0,0 +1,141 @@
+#include "view.h"
+
+#include "matrix.h"
+
+namespace task {
+
+/*
+ * ConstMatrixView
+ */
+ConstMatrixView::ConstMatrixView(const double* data, size_t rows, size_t cols,
+                                 size_t ld)
+    : data(data), rows(rows), cols(cols), ld(ld) {}
+
+ConstMatrixView::ConstMatrixView(const Matrix& matrix)
+    : ConstMatrixView(matrix.array, matrix.getRows(),
+                      matrix.getColumns(), matrix.getColumns()) {}
+
+ConstMatrixView::ConstMatrixView(const MatrixView& view)
+    : ConstMatrixView(view.data, view.rows, view.cols, view.ld) {}
+
+const double& ConstMatrixView::get(size_t row, size_t col) const {
+  if (row >= rows || col >= cols) {
+    throw OutOfBoundsException();
+  }
+  return data[row * ld + col];
+}
+
+const double* ConstMatrixView::operator[](size_t row) const {
+  if (row >= rows) {
+    throw OutOfBoundsException();
+  }
+  return data + row * ld;
+}
+
+ConstMatrixView ConstMatrixView::row(size_t row) const {
+  return block(row, 0, 1, cols);
+}
+
+ConstMatrixView ConstMatrixView::column(size_t col) const {
+  return block(0, col, rows, 1);
+}
+
+ConstMatrixView ConstMatrixView::block(size_t row, size_t col,
+                                       size_t block_rows,
+                                       size_t block_cols) const {
+  if (row + block_rows > rows || col + block_cols > cols ||
+      row + block_rows < row || col + block_cols < col) {
+    throw OutOfBoundsException();
+  }
+  return ConstMatrixView(data + row * ld + col, block_rows, block_cols, ld);
+}
+
+/*
+ * MatrixView
+ */
+MatrixView::MatrixView(double* data, size_t rows, size_t cols, size_t ld)
+    : data(data), rows(rows), cols(cols), ld(ld) {}
+
+MatrixView::MatrixView(double* data, size_t rows, size_t cols, size_t ld,
+                       Matrix* owner)
+    : data(data), rows(rows), cols(cols), ld(ld), owner(owner) {}
+
+MatrixView::MatrixView(Matrix& matrix)
+    : MatrixView(matrix.getRawArray(), matrix.getRows(), matrix.getColumns(),
+                 matrix.getColumns(), &matrix) {}
+
+void MatrixView::modified() const {
+  if (owner) {
+    owner->modified_through_view();
+  }
+}
+
+void MatrixView::check_size(size_t other_rows, size_t other_cols) const {
+  if (other_rows != rows || other_cols != cols) {
+    throw SizeMismatchException();
+  }
+}
+
+MatrixView& MatrixView::operator=(const MatrixView& other) {
+  if (this == &other) {
+    return *this;
+  }
+  return *this = ConstMatrixView(other);
+}
+
+MatrixView& MatrixView::operator*=(const double& number) {
+  modified();
+  for (size_t r = 0; r < rows; ++r) {
+    double* data_row = data + r * ld;
+    for (size_t c = 0; c < cols; ++c) data_row[c] *= number;
+  }
+  return *this;
+}
+
+void MatrixView::fill(double value) {
+  modified();
+  for (size_t r = 0; r < rows; ++r) {
+    double* data_row = data + r * ld;
+    for (size_t c = 0; c < cols; ++c) data_row[c] = value;
+  }
+}
+
+double* MatrixView::getRawArray() const {
+  modified();
+  return data;
+}
+
+double& MatrixView::get(size_t row, size_t col) const {
+  if (row >= rows || col >= cols) {
+    throw OutOfBoundsException();
+  }
+  modified();
+  return data[row * ld + col];
+}
+
+double* MatrixView::operator[](size_t row) const {
+  if (row >= rows) {
+    throw OutOfBoundsException();
+  }
+  modified();
+  return data + row * ld;
+}
+
+MatrixView MatrixView::row(size_t row) const {
+  return block(row, 0, 1, cols);
+}
+
+MatrixView MatrixView::column(size_t col) const {
+  return block(0, col, rows, 1);
+}
+
+MatrixView MatrixView::block(size_t row, size_t col, size_t block_rows,
+                             size_t block_cols) const {
+  if (row + block_rows > rows || col + block_cols > cols ||
+      row + block_rows < row || col + block_cols < col) {
+    throw OutOfBoundsException();
+  }
+  return MatrixView(data + row * ld + col, block_rows, block_cols, ld, owner);
+}
+
+}  // namespace task
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+
+#include "exceptions.h"
+#include "expression.h"
+
+namespace task {
+
+class MatrixView;
+
+/*
+ * Non-owning window into row-major storage: rows x cols elements, row r
+ * starting ld elements after row r - 1. Views never allocate and must not
+ * outlive the storage they look at. Slicing a view is checked and throws
+ * OutOfBoundsException.
+ *
+ * Views are MatrixExpression leaves, so they mix with Matrix in +, -,
+ * scalar * and ==, and a Matrix can be built from one. Matrices convert to
+ * views implicitly, so functions taking views accept matrices too.
+ */
+class ConstMatrixView : public MatrixExpression<ConstMatrixView> {
+ public:
+  ConstMatrixView(const double* data, size_t rows, size_t cols, size_t ld);
+  ConstMatrixView(const Matrix& matrix);
+  ConstMatrixView(const MatrixView& view);
+
+  size_t getRows() const { return rows; }
+  size_t getColumns() const { return cols; }
+  size_t getLeadingDimension() const { return ld; }
+  const double* getRawArray() const { return data; }
+  bool isContiguous() const { return ld == cols || rows <= 1; }
+
+  const double& get(size_t row, size_t col) const;
+  const double* operator[](size_t row) const;
+  double eval(size_t row, size_t col) const { return data[row * ld + col]; }
+
+  ConstMatrixView row(size_t row) const;
+  ConstMatrixView column(size_t col) const;
+  ConstMatrixView block(size_t row, size_t col, size_t block_rows,
+                        size_t block_cols) const;
+
+ private:
+  const double* data;
+  size_t rows;
+  size_t cols;
+  size_t ld;
+};
+
+/*
+ * Mutable view. Copy construction makes another view of the same
+ * elements; assignment writes elements through the view and throws
+ * SizeMismatchException unless the shapes are equal. A view of a Matrix,
+ * and the rows and blocks taken from it, drop the matrix's cached det()
+ * whenever they write or hand out a pointer or reference for writing.
+ */
+class MatrixView : public MatrixExpression<MatrixView> {
+ public:
+  MatrixView(double* data, size_t rows, size_t cols, size_t ld);
+  MatrixView(Matrix& matrix);
+  MatrixView(const MatrixView& other) = default;
+
+  MatrixView& operator=(const MatrixView& other);
+  template <class E>
+  MatrixView& operator=(const MatrixExpression<E>& e);
+  template <class E>
+  MatrixView& operator+=(const MatrixExpression<E>& e);
+  template <class E>
+  MatrixView& operator-=(const MatrixExpression<E>& e);
+  MatrixView& operator*=(const double& number);
+
+  // Sets every element to value
+  void fill(double value);
+
+  size_t getRows() const { return rows; }
+  size_t getColumns() const { return cols; }
+  size_t getLeadingDimension() const { return ld; }
+  double* getRawArray() const;
+  bool isContiguous() const { return ld == cols || rows <= 1; }
+
+  double& get(size_t row, size_t col) const;
+  double* operator[](size_t row) const;
+  double eval(size_t row, size_t col) const { return data[row * ld + col]; }
+
+  MatrixView row(size_t row) const;
+  MatrixView column(size_t col) const;
+  MatrixView block(size_t row, size_t col, size_t block_rows,
+                   size_t block_cols) const;
+
+ private:
+  friend class ConstMatrixView;
+
+  double* data;
+  size_t rows;
+  size_t cols;
+  size_t ld;
+  // The matrix viewed, or nullptr for a view of other storage
+  Matrix* owner = nullptr;
+
+  MatrixView(double* data, size_t rows, size_t cols, size_t ld,
+             Matrix* owner);
+
+  void check_size(size_t other_rows, size_t other_cols) const;
+  // Called before any write to the elements
+  void modified() const;
+};
+
+template <>
+struct ExpressionLeaf<ConstMatrixView> : std::true_type {};
+template <>
+struct ExpressionLeaf<MatrixView> : std::true_type {};
+
+inline const double* leaf_row(const ConstMatrixView& view, size_t row) {
+  return view.getRawArray() + row * view.getLeadingDimension();
+}
+
+inline const double* leaf_row(const MatrixView& view, size_t row) {
+  return leaf_row(ConstMatrixView(view), row);
+}
+
+template <class E>
+MatrixView& MatrixView::operator=(const MatrixExpression<E>& e) {
+  check_size(e.self().getRows(), e.self().getColumns());
+  modified();
+  evaluate_into(data, ld, e);
+  return *this;
+}
+
+template <class E>
+MatrixView& MatrixView::operator+=(const MatrixExpression<E>& e) {
+  return *this = *this + e;
+}
+
+template <class E>
+MatrixView& MatrixView::operator-=(const MatrixExpression<E>& e) {
+  return *this = *this - e;
+}
+
+}  // namespace task
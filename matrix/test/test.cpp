@@ -3,8 +3,31 @@
 #include <random>
 #include <algorithm>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+#include <vector>
+#include "src/basic_matrix.h"
+#include "src/batch.h"
+#include "src/cholesky.h"
+#include "src/fixed_matrix.h"
+#include "src/gemm.h"
+#include "src/instrumentation.h"
+#include "src/lu.h"
 #include "src/matrix.h"
+#include "src/out_of_core.h"
+#include "src/qr.h"
+#include "src/serialization.h"
+#include "src/simd.h"
+#include "src/sparse.h"
+#include "src/storage.h"
+#include "src/strassen.h"
+#include "src/transpose.h"
 
 
 using task::Matrix;
@@ -44,6 +67,103 @@ Matrix RandomMatrix(size_t rows, size_t cols) {
 }
 
 
+Matrix NaiveMultiply(const Matrix& a, const Matrix& b) {
+    Matrix result(a.getRows(), b.getColumns());
+    for (size_t i = 0; i < a.getRows(); ++i) {
+        for (size_t j = 0; j < b.getColumns(); ++j) {
+            double sum = 0.;
+            for (size_t k = 0; k < a.getColumns(); ++k) {
+                sum += a.get(i, k) * b.get(k, j);
+            }
+            result.set(i, j, sum);
+        }
+    }
+    return result;
+}
+
+
+bool BitwiseEqual(const Matrix& a, const Matrix& b) {
+    if (a.getRows() != b.getRows() || a.getColumns() != b.getColumns()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.getRows(); ++i) {
+        for (size_t j = 0; j < a.getColumns(); ++j) {
+            if (a.get(i, j) != b.get(i, j)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+double MaxDifference(const Matrix& a, const Matrix& b) {
+    double result = 0.;
+    for (size_t i = 0; i < a.getRows(); ++i) {
+        for (size_t j = 0; j < a.getColumns(); ++j) {
+            result = std::max(result, fabs(a.get(i, j) - b.get(i, j)));
+        }
+    }
+    return result;
+}
+
+// Textbook elimination with partial pivoting
+double NaiveDet(Matrix a) {
+    size_t n = a.getRows();
+    double det = 1.;
+    for (size_t k = 0; k < n; ++k) {
+        size_t pivot = k;
+        for (size_t i = k + 1; i < n; ++i) {
+            if (fabs(a[i][k]) > fabs(a[pivot][k])) pivot = i;
+        }
+        if (a[pivot][k] == 0.) return 0.;
+        if (pivot != k) {
+            for (size_t j = 0; j < n; ++j) std::swap(a[k][j], a[pivot][j]);
+            det = -det;
+        }
+        det *= a[k][k];
+        for (size_t i = k + 1; i < n; ++i) {
+            double factor = a[i][k] / a[k][k];
+            for (size_t j = k; j < n; ++j) a[i][j] -= factor * a[k][j];
+        }
+    }
+    return det;
+}
+
+
+// Dense matrix with about one entry in `every` non-zero
+Matrix RandomSparseDense(size_t rows, size_t cols, size_t every) {
+    Matrix temp(rows, cols);
+    for (size_t row = 0; row < rows; ++row) {
+        for (size_t col = 0; col < cols; ++col) {
+            temp[row][col] = RandomUInt(every - 1) == 0 ? RandomDouble() : 0.;
+        }
+    }
+    return temp;
+}
+
+
+// Exact cofactor expansion along the first row
+int64_t LaplaceDet(const std::vector<std::vector<int64_t>>& a) {
+    size_t n = a.size();
+    if (n == 0) return 1;
+    int64_t det = 0;
+    for (size_t col = 0; col < n; ++col) {
+        std::vector<std::vector<int64_t>> minor;
+        for (size_t i = 1; i < n; ++i) {
+            std::vector<int64_t> row;
+            for (size_t j = 0; j < n; ++j) {
+                if (j != col) row.push_back(a[i][j]);
+            }
+            minor.push_back(row);
+        }
+        int64_t term = a[0][col] * LaplaceDet(minor);
+        det += col % 2 == 0 ? term : -term;
+    }
+    return det;
+}
+
+
 void FailWithMsg(const std::string& msg, int line) {
     std::cerr << "Test failed!\n";
     std::cerr << "[Line " << line << "] "  << msg << std::endl;
@@ -68,6 +188,75 @@ void FailWithMsg(const std::string& msg, int line) {
 const double EPS = 1e-6;
 
 
+// FixedMatrix<N, N> against Matrix, for the closed forms and elimination
+template <size_t N>
+void CheckFixedMatrix() {
+    using Fixed = task::FixedMatrix<N, N>;
+    auto mat1 = RandomMatrix(N, N);
+    auto mat2 = RandomMatrix(N, N);
+    Fixed fixed1(mat1), fixed2(mat2);
+
+    ASSERT_TRUE_MSG(fixed1.toMatrix() == mat1, "FixedMatrix round trip")
+    ASSERT_TRUE_MSG((fixed1 * fixed2).toMatrix() == NaiveMultiply(mat1, mat2), "FixedMatrix *")
+    ASSERT_TRUE_MSG((fixed1 + fixed2 * 2.).toMatrix() == mat1 + mat2 * 2., "FixedMatrix +")
+    ASSERT_TRUE_MSG((-fixed1 - fixed2).toMatrix() == -mat1 - mat2, "FixedMatrix -")
+    ASSERT_TRUE_MSG(fixed1.transposed().toMatrix() == mat1.transposed(), "FixedMatrix::transposed()")
+    ASSERT_TRUE_MSG(fabs(fixed1.trace() - mat1.trace()) < EPS, "FixedMatrix::trace()")
+
+    double det = NaiveDet(mat1);
+    ASSERT_TRUE_MSG(fabs(fixed1.det() - det) <= 1e-9 * fabs(det), "FixedMatrix::det()")
+    if (fabs(det) > 1e-3) {
+        ASSERT_TRUE_MSG(MaxDifference((fixed1 * fixed1.inverse()).toMatrix(), Matrix(N, N)) < 1e-8,
+                        "FixedMatrix::inverse()")
+    }
+
+    auto product = fixed1;
+    product *= fixed2;
+    ASSERT_TRUE_MSG(product == fixed1 * fixed2, "FixedMatrix *=")
+    ASSERT_TRUE_MSG(!(product != fixed1 * fixed2), "FixedMatrix !=")
+    ASSERT_EXCEPTION_MSG(fixed1.get(N, 0), task::OutOfBoundsException, "FixedMatrix::get()")
+    ASSERT_EXCEPTION_MSG(fixed1.set(0, N, 1.), task::OutOfBoundsException, "FixedMatrix::set()")
+    ASSERT_EXCEPTION_MSG(Fixed(RandomMatrix(N, N + 1)), task::SizeMismatchException,
+                         "FixedMatrix from Matrix")
+    ASSERT_EXCEPTION_MSG(Fixed::zero().inverse(), task::SingularMatrixException,
+                         "Singular FixedMatrix::inverse()")
+}
+
+
+// Forwards to the pool, counting blocks and checking their alignment
+class CountingAllocator : public task::MatrixAllocator {
+public:
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    bool aligned = true;
+
+    void* allocate(size_t bytes) override {
+        ++allocations;
+        void* block = task::PoolAllocator::instance().allocate(bytes);
+        aligned = aligned && reinterpret_cast<uintptr_t>(block) % task::STORAGE_ALIGNMENT == 0;
+        return block;
+    }
+
+    void deallocate(void* block, size_t bytes) override {
+        ++deallocations;
+        task::PoolAllocator::instance().deallocate(block, bytes);
+    }
+};
+
+
+// Serves a string through an istream that cannot seek, as a pipe would
+class UnseekableBuffer : public std::streambuf {
+public:
+    explicit UnseekableBuffer(const std::string& bytes) : bytes(bytes) {
+        char* begin = &this->bytes[0];
+        setg(begin, begin, begin + this->bytes.size());
+    }
+
+private:
+    std::string bytes;
+};
+
+
 int main(int argc, char** argv) {
 
     {
@@ -208,6 +397,1457 @@ int main(int argc, char** argv) {
     }
 
 
+    {
+        // Shapes around the register tile, the cache blocks and the small
+        // product cutoff, including ones that are not a multiple of any
+        const size_t shapes[][3] = {{1, 1, 1}, {1, 300, 1}, {300, 1, 300},
+                                    {4, 8, 256}, {5, 9, 257}, {97, 13, 257},
+                                    {33, 33, 33}, {96, 2049, 3}, {191, 65, 513}};
+        for (const auto& shape : shapes) {
+            auto mat1 = RandomMatrix(shape[0], shape[2]);
+            auto mat2 = RandomMatrix(shape[2], shape[1]);
+            auto expected = NaiveMultiply(mat1, mat2);
+            ASSERT_TRUE_MSG(mat1 * mat2 == expected, "Blocked multiply")
+            mat1 *= mat2;
+            ASSERT_TRUE_MSG(mat1 == expected, "Blocked operator *=")
+        }
+
+        // alpha, beta and leading dimensions wider than the operands
+        auto mat1 = RandomMatrix(70, 90);
+        auto mat2 = RandomMatrix(90, 110);
+        auto mat3 = RandomMatrix(70, 110);
+        auto expected = mat3;
+        for (size_t i = 0; i < 61; ++i) {
+            for (size_t j = 0; j < 101; ++j) {
+                double sum = 0.;
+                for (size_t k = 0; k < 83; ++k) {
+                    sum += mat1[i][k] * mat2[k][j];
+                }
+                expected[i][j] = 2. * sum - 0.5 * mat3[i][j];
+            }
+        }
+        task::gemm(61, 101, 83, 2., mat1.getRawArray(), 90, mat2.getRawArray(), 110,
+                   -0.5, mat3.getRawArray(), 110);
+        ASSERT_TRUE_MSG(mat3 == expected, "gemm()")
+
+        // Empty products: k == 0 only scales C, m == 0 or n == 0 touch nothing
+        expected = mat3 * 2.;
+        task::gemm(70, 110, 0, 1., nullptr, 1, nullptr, 110, 2., mat3.getRawArray(), 110);
+        ASSERT_TRUE_MSG(mat3 == expected, "gemm() with k == 0")
+        task::gemm(0, 110, 5, 1., nullptr, 5, mat2.getRawArray(), 110, 0., nullptr, 110);
+        task::gemm(70, 0, 5, 1., mat1.getRawArray(), 90, nullptr, 1, 0., mat3.getRawArray(), 110);
+        ASSERT_TRUE_MSG(mat3 == expected, "gemm() with n == 0")
+    }
+
+
+    {
+        // Every kernel on every instruction set the CPU has, for sizes
+        // around the vector widths and from an unaligned start
+        const task::simd::Isa isas[] = {task::simd::Isa::Scalar, task::simd::Isa::Sse2,
+                                        task::simd::Isa::Avx2, task::simd::Isa::Avx512};
+        for (auto isa : isas) {
+            task::simd::set_isa(isa);
+            for (size_t size = 0; size <= 37; ++size) {
+                std::vector<double> a(size + 1), b(size + 1);
+                for (size_t i = 0; i <= size; ++i) {
+                    a[i] = RandomDouble();
+                    b[i] = RandomDouble();
+                }
+                const double* x = a.data() + 1;
+                const double* y = b.data() + 1;
+
+                std::vector<double> dst(x, x + size), expected(x, x + size);
+                task::simd::add(dst.data(), y, size);
+                for (size_t i = 0; i < size; ++i) expected[i] += y[i];
+                ASSERT_TRUE_MSG(dst == expected, "simd::add()")
+
+                task::simd::sub(dst.data(), y, size);
+                for (size_t i = 0; i < size; ++i) expected[i] -= y[i];
+                ASSERT_TRUE_MSG(dst == expected, "simd::sub()")
+
+                task::simd::scale(dst.data(), -1.5, size);
+                for (size_t i = 0; i < size; ++i) expected[i] *= -1.5;
+                ASSERT_TRUE_MSG(dst == expected, "simd::scale()")
+
+                task::simd::negate(dst.data(), dst.data(), size);
+                for (size_t i = 0; i < size; ++i) expected[i] = -expected[i];
+                ASSERT_TRUE_MSG(dst == expected, "simd::negate()")
+
+                task::simd::axpy(dst.data(), 0.25, y, size);
+                for (size_t i = 0; i < size; ++i) {
+                    // May be fused into one rounding
+                    ASSERT_TRUE_MSG(fabs(dst[i] - (expected[i] + 0.25 * y[i])) < EPS, "simd::axpy()")
+                }
+
+                double dot = 0.;
+                for (size_t i = 0; i < size; ++i) dot += x[i] * y[i];
+                ASSERT_TRUE_MSG(fabs(task::simd::dot(x, y, size) - dot) < EPS, "simd::dot()")
+
+                ASSERT_TRUE_MSG(task::simd::equal(x, x, size, 0.), "simd::equal()")
+                if (size > 0) {
+                    std::vector<double> other(x, x + size);
+                    other[size - 1] += 2 * EPS;
+                    ASSERT_TRUE_MSG(!task::simd::equal(x, other.data(), size, EPS), "simd::equal()")
+                    ASSERT_TRUE_MSG(task::simd::equal(x, other.data(), size, 3 * EPS), "simd::equal()")
+                }
+            }
+
+            auto mat1 = RandomMatrix(7, 5);
+            auto mat2 = RandomMatrix(7, 5);
+            Matrix sum = mat1;
+            sum += mat2;
+            for (size_t i = 0; i < 7; ++i) {
+                for (size_t j = 0; j < 5; ++j) {
+                    ASSERT_TRUE_MSG(sum[i][j] == mat1[i][j] + mat2[i][j], "Operator += after set_isa()")
+                }
+            }
+        }
+        ASSERT_TRUE_MSG(task::simd::set_isa(task::simd::Isa::Scalar) == task::simd::Isa::Scalar, "set_isa()")
+        ASSERT_TRUE_MSG(task::simd::active_isa() == task::simd::Isa::Scalar, "active_isa()")
+        auto best = task::simd::set_isa(task::simd::Isa::Avx512);
+        ASSERT_TRUE_MSG(task::simd::active_isa() == best, "set_isa()")
+    }
+
+
+    {
+        // Parallel results are the same as the sequential ones, bit for bit
+        auto sequential = task::ExecutionPolicy::sequential();
+        const size_t shapes[][3] = {{1, 1, 1}, {3, 200, 5}, {257, 129, 300}, {500, 31, 97}};
+        for (const auto& shape : shapes) {
+            auto mat1 = RandomMatrix(shape[0], shape[2]);
+            auto mat2 = RandomMatrix(shape[2], shape[1]);
+            auto expected = Matrix::multiply(mat1, mat2, sequential);
+            ASSERT_TRUE_MSG(expected == NaiveMultiply(mat1, mat2), "Sequential multiply()")
+            for (size_t threads : {2, 3, 8}) {
+                auto policy = task::ExecutionPolicy::parallel(threads);
+                ASSERT_TRUE_MSG(BitwiseEqual(Matrix::multiply(mat1, mat2, policy), expected),
+                                "Parallel multiply()")
+                ASSERT_TRUE_MSG(BitwiseEqual(mat1.transposed(policy), mat1.transposed()),
+                                "Parallel transposed()")
+            }
+        }
+
+        for (size_t n : {1, 2, 65, 300}) {
+            auto mat = RandomMatrix(n, n);
+            double expected = mat.det(sequential);
+            for (size_t threads : {2, 5}) {
+                ASSERT_TRUE_MSG(mat.det(task::ExecutionPolicy::parallel(threads)) == expected,
+                                "Parallel det()")
+            }
+        }
+
+        ASSERT_TRUE_MSG(task::ExecutionPolicy::parallel(3).getThreads() == 3, "ExecutionPolicy")
+        ASSERT_TRUE_MSG(task::ExecutionPolicy::parallel().getThreads() >= 1, "ExecutionPolicy")
+
+        // Every index runs once; the first exception reaches the caller
+        auto& pool = task::ThreadPool::shared(4);
+        std::vector<int> hits(1000, 0);
+        pool.parallel_for(hits.size(), [&](size_t i) { ++hits[i]; });
+        ASSERT_TRUE_MSG(std::count(hits.begin(), hits.end(), 1) == 1000, "ThreadPool::parallel_for()")
+        pool.parallel_for(0, [&](size_t) { hits[0] = 5; });
+        ASSERT_TRUE_MSG(hits[0] == 1, "ThreadPool::parallel_for() with no work")
+        ASSERT_EXCEPTION_MSG(pool.parallel_for(100, [](size_t i) {
+                                 if (i == 42) throw std::runtime_error("task");
+                             }),
+                             std::runtime_error, "ThreadPool::parallel_for() exception")
+    }
+
+
+    REPEAT(10)
+    {
+        // Expression chains evaluated in one pass match element-wise loops
+        auto rows = RandomUInt(1, 40), cols = RandomUInt(1, 40);
+        auto mat1 = RandomMatrix(rows, cols);
+        auto mat2 = RandomMatrix(rows, cols);
+        auto mat3 = RandomMatrix(rows, cols);
+        Matrix res = mat1 + mat2 - mat3 * 2. + -mat1 * 0.5;
+        Matrix expected(rows, cols);
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t j = 0; j < cols; ++j) {
+                expected[i][j] = mat1[i][j] + mat2[i][j] - mat3[i][j] * 2. + -mat1[i][j] * 0.5;
+            }
+        }
+        ASSERT_TRUE_MSG(res == expected, "Expression chain")
+        ASSERT_TRUE_MSG(mat1 + mat2 - mat3 * 2. + -mat1 * 0.5 == expected, "Expression ==")
+        ASSERT_TRUE_MSG(mat1 - mat1 != mat2 + mat2 || rows * cols == 0, "Expression !=")
+
+        // The destination may appear on the right-hand side
+        auto copy = mat1;
+        mat1 = mat2 - mat1 * 3.;
+        ASSERT_TRUE_MSG(mat1 == mat2 - copy * 3., "Aliased assignment")
+        mat1 = copy;
+        mat1 += mat1 * 2.;
+        ASSERT_TRUE_MSG(mat1 == copy * 3., "Aliased +=")
+        mat1 -= -mat1;
+        ASSERT_TRUE_MSG(mat1 == copy * 6., "Aliased -=")
+
+        // Assignment of another shape reallocates, noalias() refuses to
+        Matrix other(1, 1);
+        other = mat2 + mat3;
+        ASSERT_TRUE_MSG(other.getRows() == rows && other.getColumns() == cols, "Assignment reshapes")
+        other.noalias() = mat2 * 2.;
+        ASSERT_TRUE_MSG(other == mat2 + mat2, "noalias()")
+        other.noalias() += mat3;
+        other.noalias() -= mat2;
+        ASSERT_TRUE_MSG(other == mat2 + mat3, "noalias() += / -=")
+        Matrix wrong(rows + 1, cols);
+        ASSERT_EXCEPTION_MSG(wrong.noalias() = mat2 + mat3, task::SizeMismatchException, "noalias()")
+        ASSERT_EXCEPTION_MSG(mat1 + mat2 - wrong, task::SizeMismatchException, "Expression sizes")
+    }
+
+
+    {
+        // Moves leave the source empty and usable, for heap and inline storage
+        for (size_t n : {1, 3, 50}) {
+            auto mat1 = RandomMatrix(n, n + 1);
+            auto copy = mat1;
+            Matrix mat2(std::move(mat1));
+            ASSERT_TRUE_MSG(mat2 == copy, "Move constructor")
+            ASSERT_TRUE_MSG(mat1.getRows() == 0 && mat1.getColumns() == 0, "Moved-from matrix")
+            ASSERT_EXCEPTION_MSG(mat1.get(0, 0), task::OutOfBoundsException, "Moved-from matrix")
+
+            Matrix mat3(2, 2);
+            mat3 = std::move(mat2);
+            ASSERT_TRUE_MSG(mat3 == copy, "Move assignment")
+            ASSERT_TRUE_MSG(mat2.getRows() == 0 && mat2.getColumns() == 0, "Moved-from matrix")
+
+            mat1 = copy;
+            ASSERT_TRUE_MSG(mat1 == copy, "Copy into moved-from matrix")
+            mat2.resize(2, 3);
+            ASSERT_TRUE_MSG(mat2.getRows() == 2 && mat2[1][2] == 0. && mat2[0][0] == 0.,
+                            "Resize of moved-from matrix")
+            mat2 = mat3 + mat1;
+            ASSERT_TRUE_MSG(mat2 == copy * 2., "Expression into moved-from matrix")
+
+            std::swap(mat1, mat2);
+            ASSERT_TRUE_MSG(mat1 == copy * 2. && mat2 == copy, "std::swap()")
+
+            mat3 = std::move(mat3);
+            ASSERT_TRUE_MSG(mat3 == copy, "Self move assignment")
+
+            // Copy assignment of the same element count keeps the shape right
+            Matrix mat4(n + 1, n);
+            mat4 = copy;
+            ASSERT_TRUE_MSG(mat4.getRows() == n && mat4.getColumns() == n + 1 && mat4 == copy,
+                            "Copy assignment")
+        }
+    }
+
+
+    {
+        // LU around the panel width, against elimination and residuals
+        for (size_t n : {1, 2, 3, 63, 64, 65, 150}) {
+            auto mat = RandomMatrix(n, n);
+            task::LUDecomposition lu(mat);
+            ASSERT_TRUE_MSG(lu.getSize() == n && !lu.isSingular(), "LUDecomposition")
+
+            double det = NaiveDet(mat);
+            ASSERT_TRUE_MSG(fabs(lu.det() - det) <= 1e-9 * fabs(det), "LUDecomposition::det()")
+            ASSERT_TRUE_MSG(fabs(mat.det() - det) <= 1e-9 * fabs(det), "det()")
+
+            // L is unit lower, U upper, and every row of L * U is a row of A
+            auto l = lu.getL(), u = lu.getU();
+            auto product = l * u;
+            for (size_t i = 0; i < n; ++i) {
+                ASSERT_TRUE_MSG(l[i][i] == 1., "LUDecomposition::getL()")
+                for (size_t j = i + 1; j < n; ++j) {
+                    ASSERT_TRUE_MSG(l[i][j] == 0. && u[j][i] == 0., "LUDecomposition triangles")
+                }
+                bool found = false;
+                for (size_t r = 0; r < n && !found; ++r) {
+                    found = true;
+                    for (size_t j = 0; j < n; ++j) {
+                        found = found && fabs(product[i][j] - mat[r][j]) < 1e-9;
+                    }
+                }
+                ASSERT_TRUE_MSG(found, "P * A == L * U")
+            }
+
+            auto rhs = RandomMatrix(n, 3);
+            auto x = lu.solve(rhs);
+            ASSERT_TRUE_MSG(MaxDifference(mat * x, rhs) < 1e-8, "LUDecomposition::solve()")
+            std::vector<double> b(n);
+            for (auto& value : b) value = RandomDouble();
+            auto y = lu.solve(b);
+            for (size_t i = 0; i < n; ++i) {
+                double sum = 0.;
+                for (size_t j = 0; j < n; ++j) sum += mat[i][j] * y[j];
+                ASSERT_TRUE_MSG(fabs(sum - b[i]) < 1e-8, "LUDecomposition::solve() of a vector")
+            }
+            ASSERT_TRUE_MSG(MaxDifference(mat * lu.inverse(), Matrix(n, n)) < 1e-8,
+                            "LUDecomposition::inverse()")
+            ASSERT_EXCEPTION_MSG(lu.solve(RandomMatrix(n + 1, 1)), task::SizeMismatchException,
+                                 "LUDecomposition::solve()")
+        }
+
+        // Singular: two equal rows
+        auto mat = RandomMatrix(70, 70);
+        for (size_t j = 0; j < 70; ++j) mat[69][j] = mat[3][j];
+        task::LUDecomposition lu(mat);
+        ASSERT_TRUE_MSG(lu.isSingular() && lu.det() == 0., "Singular LUDecomposition")
+        ASSERT_EXCEPTION_MSG(lu.solve(RandomMatrix(70, 1)), task::SingularMatrixException,
+                             "Singular LUDecomposition::solve()")
+        ASSERT_EXCEPTION_MSG(lu.inverse(), task::SingularMatrixException,
+                             "Singular LUDecomposition::inverse()")
+        ASSERT_EXCEPTION_MSG(task::LUDecomposition(RandomMatrix(3, 4)), task::SizeMismatchException,
+                             "Non-square LUDecomposition")
+    }
+
+
+    {
+        // In-place square and cycle paths and the copy, around the 16 x 16 leaf
+        const size_t shapes[][2] = {{1, 1}, {1, 40}, {40, 1}, {16, 16}, {17, 17},
+                                    {3, 5}, {17, 40}, {100, 37}, {129, 129}};
+        for (const auto& shape : shapes) {
+            auto mat = RandomMatrix(shape[0], shape[1]);
+            Matrix expected(shape[1], shape[0]);
+            for (size_t i = 0; i < shape[0]; ++i) {
+                for (size_t j = 0; j < shape[1]; ++j) {
+                    expected[j][i] = mat[i][j];
+                }
+            }
+            ASSERT_TRUE_MSG(BitwiseEqual(mat.transposed(), expected), "transposed()")
+            auto copy = mat;
+            mat.transpose();
+            ASSERT_TRUE_MSG(BitwiseEqual(mat, expected), "In-place transpose()")
+            mat.transpose();
+            ASSERT_TRUE_MSG(BitwiseEqual(mat, copy), "transpose() twice")
+
+            // A square block inside a wider matrix, in place
+            Matrix wide = RandomMatrix(shape[0], shape[0] + 3);
+            auto before = wide;
+            task::transpose_square(shape[0], wide.getRawArray(), shape[0] + 3);
+            for (size_t i = 0; i < shape[0]; ++i) {
+                for (size_t j = 0; j < shape[0] + 3; ++j) {
+                    double value = j < shape[0] ? before[j][i] : before[i][j];
+                    ASSERT_TRUE_MSG(wide[i][j] == value, "transpose_square()")
+                }
+            }
+        }
+
+        // Empty blocks are left alone
+        task::transpose_in_place(0, 5, nullptr);
+        task::transpose_square(0, nullptr, 1);
+        task::transpose_copy(0, 0, nullptr, 1, nullptr, 1);
+    }
+
+
+    REPEAT(20)
+    {
+        CheckFixedMatrix<1>();
+        CheckFixedMatrix<2>();
+        CheckFixedMatrix<3>();
+        CheckFixedMatrix<4>();
+        CheckFixedMatrix<5>();
+        CheckFixedMatrix<7>();
+
+        // Non-square products and constant evaluation
+        task::FixedMatrix<2, 3> wide{1., 2., 3., 4., 5., 6.};
+        task::FixedMatrix<3, 2> tall{1., 0., 0., 1., 1., 1.};
+        constexpr task::Matrix2 constant = task::Matrix2{2., 1., 1., 1.}.inverse();
+        static_assert(constant(0, 0) == 1. && constant(0, 1) == -1., "constexpr inverse()");
+        ASSERT_TRUE_MSG((wide * tall == task::Matrix2{4., 5., 10., 11.}), "Non-square FixedMatrix *")
+        ASSERT_TRUE_MSG(wide.transposed()(2, 1) == 6., "Non-square FixedMatrix::transposed()")
+    }
+
+
+    REPEAT(10)
+    {
+        // Sparse products and sums against the same dense matrices
+        using task::SparseMatrix;
+        size_t n = RandomUInt(1, 60), m = RandomUInt(1, 60), k = RandomUInt(1, 60);
+        auto dense1 = RandomSparseDense(n, k, 8);
+        auto dense2 = RandomSparseDense(k, m, 8);
+        auto dense3 = RandomSparseDense(n, k, 3);
+        for (auto format1 : {SparseMatrix::Format::Csr, SparseMatrix::Format::Csc}) {
+            for (auto format2 : {SparseMatrix::Format::Csr, SparseMatrix::Format::Csc}) {
+                SparseMatrix sparse1(dense1, format1), sparse2(dense2, format2), sparse3(dense3, format2);
+                ASSERT_TRUE_MSG(sparse1.toDense() == dense1, "SparseMatrix round trip")
+                ASSERT_TRUE_MSG(sparse1.getFormat() == format1, "SparseMatrix::getFormat()")
+
+                auto product = sparse1 * sparse2;
+                ASSERT_TRUE_MSG(product.getFormat() == format1, "SpGEMM format")
+                ASSERT_TRUE_MSG(product.toDense() == NaiveMultiply(dense1, dense2), "SpGEMM")
+                ASSERT_TRUE_MSG(sparse1 * dense2 == NaiveMultiply(dense1, dense2), "Sparse * dense")
+                ASSERT_TRUE_MSG((sparse1 + sparse3).toDense() == dense1 + dense3, "Sparse +")
+                ASSERT_TRUE_MSG((sparse1 - sparse3 * 2.).toDense() == dense1 - dense3 * 2., "Sparse -")
+                ASSERT_TRUE_MSG((sparse1 - sparse1).getNonZeros() == 0, "Sparse cancellation")
+                ASSERT_TRUE_MSG(sparse1.transposed().toDense() == dense1.transposed(),
+                                "SparseMatrix::transposed()")
+
+                std::vector<double> x(k);
+                for (auto& value : x) value = RandomDouble();
+                auto y = sparse1 * x;
+                ASSERT_TRUE_MSG(y.size() == n, "SpMV size")
+                for (size_t i = 0; i < n; ++i) {
+                    double sum = 0.;
+                    for (size_t j = 0; j < k; ++j) sum += dense1[i][j] * x[j];
+                    ASSERT_TRUE_MSG(fabs(y[i] - sum) < EPS, "SpMV")
+                }
+                auto y_parallel = sparse1.multiply(x, task::ExecutionPolicy::parallel(3));
+                auto y_again = sparse1.multiply(x, task::ExecutionPolicy::parallel(3));
+                for (size_t i = 0; i < n; ++i) {
+                    ASSERT_TRUE_MSG(fabs(y_parallel[i] - y[i]) < EPS, "Parallel SpMV")
+                    ASSERT_TRUE_MSG(y_parallel[i] == y_again[i], "Parallel SpMV is reproducible")
+                }
+                ASSERT_EXCEPTION_MSG(sparse1 * SparseMatrix(k + 1, 2), task::SizeMismatchException, "SpGEMM sizes")
+                ASSERT_EXCEPTION_MSG(sparse1 * std::vector<double>(k + 1), task::SizeMismatchException,
+                                     "SpMV sizes")
+            }
+        }
+
+        // Duplicate triplets are summed and zeros are never stored
+        auto sparse = SparseMatrix::fromTriplets(
+            3, 4, {{0, 1, 2.}, {2, 3, 1.}, {0, 1, 3.}, {1, 0, 0.}, {2, 3, -1.}});
+        ASSERT_TRUE_MSG(sparse.get(0, 1) == 5. && sparse.get(2, 3) == 0., "fromTriplets()")
+        ASSERT_TRUE_MSG(sparse.getNonZeros() == 1, "fromTriplets() drops zeros")
+        ASSERT_TRUE_MSG(sparse.toCsc() == sparse && sparse.toCsc().toCsr() == sparse, "Format conversions")
+        ASSERT_EXCEPTION_MSG(sparse.get(3, 0), task::OutOfBoundsException, "SparseMatrix::get()")
+        ASSERT_TRUE_MSG(SparseMatrix(4, 5).getNonZeros() == 4, "SparseMatrix(rows, cols) is the identity")
+        auto empty = SparseMatrix::fromTriplets(5, 5, {}, SparseMatrix::Format::Csc);
+        ASSERT_TRUE_MSG(empty.getNonZeros() == 0 && empty * std::vector<double>(5, 1.) == std::vector<double>(5, 0.),
+                        "Empty SpMV")
+        ASSERT_TRUE_MSG((empty * empty).getNonZeros() == 0, "Empty SpGEMM")
+    }
+
+
+    {
+        // Binary and mapped round trips are exact, malformed input throws
+        const std::string path = "test_matrix.bin";
+        const size_t shapes[][2] = {{1, 1}, {0, 0}, {0, 5}, {3, 7}, {64, 65}};
+        for (const auto& shape : shapes) {
+            auto mat = RandomMatrix(shape[0], shape[1]);
+
+            std::stringstream stream;
+            task::writeBinary(stream, mat);
+            ASSERT_TRUE_MSG(stream.str().size() == sizeof(task::BinaryHeader) + mat.getRows() * mat.getColumns() * sizeof(double),
+                            "writeBinary() size")
+            ASSERT_TRUE_MSG(BitwiseEqual(task::readBinary(stream), mat), "Binary stream round trip")
+
+            task::saveBinary(path, mat);
+            ASSERT_TRUE_MSG(BitwiseEqual(task::loadBinary(path), mat), "Binary file round trip")
+
+            task::MappedMatrix mapped(path);
+            ASSERT_TRUE_MSG(mapped.getRows() == shape[0] && mapped.getColumns() == shape[1], "MappedMatrix shape")
+            ASSERT_TRUE_MSG(BitwiseEqual(mapped.toMatrix(), mat), "MappedMatrix::toMatrix()")
+            ASSERT_TRUE_MSG(mapped + mat == mat * 2., "MappedMatrix in expressions")
+            if (shape[0] > 0 && shape[1] > 0) {
+                size_t row = shape[0] - 1, col = shape[1] - 1;
+                ASSERT_TRUE_MSG(mapped.get(row, col) == mat[row][col] && mapped[row][col] == mat[row][col],
+                                "MappedMatrix::get()")
+            }
+            ASSERT_EXCEPTION_MSG(mapped.get(shape[0], 0), task::OutOfBoundsException, "MappedMatrix::get()")
+
+            task::MappedMatrix moved(std::move(mapped));
+            ASSERT_TRUE_MSG(BitwiseEqual(moved.toMatrix(), mat), "MappedMatrix move")
+            ASSERT_TRUE_MSG(mapped.getRows() == 0 && mapped.getColumns() == 0, "Moved-from MappedMatrix")
+        }
+
+        auto mat = RandomMatrix(4, 4);
+        std::stringstream stream;
+        task::writeBinary(stream, mat);
+        std::string bytes = stream.str();
+
+        std::stringstream truncated(bytes.substr(0, bytes.size() - 1));
+        ASSERT_EXCEPTION_MSG(task::readBinary(truncated), task::MatrixIOException, "Truncated binary")
+        std::stringstream short_header(bytes.substr(0, 10));
+        ASSERT_EXCEPTION_MSG(task::readBinary(short_header), task::MatrixIOException, "Short header")
+        std::string bad_magic = bytes;
+        bad_magic[0] = 'X';
+        std::stringstream bad(bad_magic);
+        ASSERT_EXCEPTION_MSG(task::readBinary(bad), task::MatrixIOException, "Bad magic")
+
+        {
+            std::ofstream file(path, std::ios::binary);
+            file << bytes.substr(0, bytes.size() - 8);
+        }
+        ASSERT_EXCEPTION_MSG(task::MappedMatrix(path), task::MatrixIOException, "Truncated mapped file")
+        std::remove(path.c_str());
+        ASSERT_EXCEPTION_MSG(task::MappedMatrix(path), task::MatrixIOException, "Missing mapped file")
+        ASSERT_EXCEPTION_MSG(task::loadBinary(path), task::MatrixIOException, "Missing binary file")
+    }
+
+
+    {
+        // Views read and write the right elements of the parent
+        auto mat = RandomMatrix(9, 11);
+        auto copy = mat;
+        auto block = mat.block(2, 3, 4, 5);
+        ASSERT_TRUE_MSG(block.getRows() == 4 && block.getColumns() == 5 && block.getLeadingDimension() == 11,
+                        "block() shape")
+        ASSERT_TRUE_MSG(!block.isContiguous() && mat.view().isContiguous(), "isContiguous()")
+        for (size_t i = 0; i < 4; ++i) {
+            for (size_t j = 0; j < 5; ++j) {
+                ASSERT_TRUE_MSG(block.get(i, j) == copy[i + 2][j + 3] && block[i][j] == copy[i + 2][j + 3],
+                                "View element access")
+            }
+        }
+        ASSERT_TRUE_MSG(block.block(1, 1, 2, 2).get(1, 1) == copy[4][5], "Nested block()")
+        ASSERT_TRUE_MSG(block.row(3).get(0, 4) == copy[5][7] && block.column(4).get(3, 0) == copy[5][7],
+                        "row() and column()")
+
+        block *= 2.;
+        block += block;
+        block.block(0, 0, 1, 1).fill(-1.);
+        for (size_t i = 0; i < 9; ++i) {
+            for (size_t j = 0; j < 11; ++j) {
+                bool inside = i >= 2 && i < 6 && j >= 3 && j < 8;
+                double expected = !inside ? copy[i][j] : (i == 2 && j == 3 ? -1. : copy[i][j] * 4.);
+                ASSERT_TRUE_MSG(mat[i][j] == expected, "Writes through a view")
+            }
+        }
+
+        // Expressions, products and noalias() over views
+        auto other = RandomMatrix(4, 5);
+        Matrix sum = block + other * 2.;
+        ASSERT_TRUE_MSG(sum == Matrix(block) + other * 2., "View expression")
+        ASSERT_TRUE_MSG(mat.block(0, 0, 4, 5) * other.transposed() ==
+                            NaiveMultiply(Matrix(mat.block(0, 0, 4, 5)), other.transposed()),
+                        "Product of views")
+        mat.block(5, 6, 4, 5) = other;
+        ASSERT_TRUE_MSG(mat.block(5, 6, 4, 5) == other, "View assignment")
+        mat.block(0, 0, 4, 5) = mat.block(5, 6, 4, 5) - other;
+        ASSERT_TRUE_MSG(mat.block(0, 0, 4, 5) == Matrix(4, 5) * 0., "View assignment from a view")
+        other.noalias() = mat.block(5, 6, 4, 5) * 3.;
+        ASSERT_TRUE_MSG(other == mat.block(5, 6, 4, 5) * 3., "noalias() from a view")
+
+        ASSERT_EXCEPTION_MSG(mat.block(6, 0, 4, 1), task::OutOfBoundsException, "block() bounds")
+        ASSERT_EXCEPTION_MSG(mat.block(0, 7, 1, 5), task::OutOfBoundsException, "block() bounds")
+        ASSERT_EXCEPTION_MSG(block.get(4, 0), task::OutOfBoundsException, "View get() bounds")
+        ASSERT_EXCEPTION_MSG(mat.block(0, 0, 2, 2) = other, task::SizeMismatchException, "View assignment size")
+
+        // Empty views
+        auto empty = mat.block(9, 11, 0, 0);
+        ASSERT_TRUE_MSG(empty.getRows() == 0 && Matrix(empty).getRows() == 0, "Empty view")
+    }
+
+
+    REPEAT(20)
+    {
+        // int64_t det() by Bareiss is exact, zero leading pivots included
+        size_t n = RandomUInt(1, 7);
+        task::BasicMatrix<int64_t> ints(n, n);
+        std::vector<std::vector<int64_t>> rows(n, std::vector<int64_t>(n));
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                rows[i][j] = TossCoin() ? 0 : static_cast<int64_t>(RandomUInt(0, 40)) - 20;
+                ints[i][j] = rows[i][j];
+            }
+        }
+        ASSERT_TRUE_MSG(ints.det() == LaplaceDet(rows), "BasicMatrix<int64_t>::det()")
+        task::BasicMatrix<int64_t> swap(2, 2);
+        swap[0][0] = 0;
+        swap[0][1] = 1;
+        swap[1][0] = 1;
+        swap[1][1] = 0;
+        ASSERT_TRUE_MSG(swap.det() == -1, "Bareiss with a zero pivot")
+
+        // Integer products are exact
+        auto square = ints * ints;
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                int64_t sum = 0;
+                for (size_t k = 0; k < n; ++k) sum += rows[i][k] * rows[k][j];
+                ASSERT_TRUE_MSG(square[i][j] == sum, "BasicMatrix<int64_t> *")
+            }
+        }
+
+        // float products accumulate in double: close to the double product;
+        // k != m, so floats1 * floats1 below is a size mismatch
+        size_t m = RandomUInt(1, 80), k = m + RandomUInt(1, 300);
+        auto mat1 = RandomMatrix(m, k), mat2 = RandomMatrix(k, m);
+        task::BasicMatrix<float> floats1(mat1), floats2(mat2);
+        auto expected = NaiveMultiply(task::BasicMatrix<double>(floats1).toMatrix(),
+                                      task::BasicMatrix<double>(floats2).toMatrix());
+        auto product = (floats1 * floats2).toMatrix();
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < m; ++j) {
+                // A few float roundings of partial sums bounded by sum |a * b|
+                double scale = 0.;
+                for (size_t p = 0; p < k; ++p) scale += fabs(floats1[i][p] * floats2[p][j]);
+                ASSERT_TRUE_MSG(fabs(product[i][j] - expected[i][j]) <= 1e-6 * scale,
+                                "BasicMatrix<float> *")
+            }
+        }
+        auto parallel = task::BasicMatrix<float>::multiply(floats1, floats2, task::ExecutionPolicy::parallel(3));
+        ASSERT_TRUE_MSG(parallel.toMatrix() == product, "Parallel BasicMatrix<float>::multiply()")
+
+        // double matches Matrix; complex matches the expansion by hand
+        task::BasicMatrix<double> doubles(mat1);
+        ASSERT_TRUE_MSG((doubles * task::BasicMatrix<double>(mat2)).toMatrix() == NaiveMultiply(mat1, mat2),
+                        "BasicMatrix<double> *")
+        ASSERT_TRUE_MSG(doubles.transposed().toMatrix() == mat1.transposed(), "BasicMatrix::transposed()")
+        using Complex = std::complex<double>;
+        task::BasicMatrix<Complex> complex(2, 2);
+        complex[0][0] = Complex(1, 2);
+        complex[0][1] = Complex(0, 1);
+        complex[1][0] = Complex(3, 0);
+        complex[1][1] = Complex(2, -1);
+        Complex det = Complex(1, 2) * Complex(2, -1) - Complex(0, 1) * Complex(3, 0);
+        ASSERT_TRUE_MSG(std::abs(complex.det() - det) < EPS, "BasicMatrix<complex>::det()")
+        ASSERT_TRUE_MSG(std::abs((complex * complex)[1][0] - (Complex(3, 0) * Complex(1, 2) + Complex(2, -1) * Complex(3, 0))) < EPS,
+                        "BasicMatrix<complex> *")
+
+        ASSERT_EXCEPTION_MSG(floats1 * floats1, task::SizeMismatchException, "BasicMatrix sizes")
+        ASSERT_EXCEPTION_MSG(ints.get(n, 0), task::OutOfBoundsException, "BasicMatrix::get()")
+        ASSERT_EXCEPTION_MSG(task::BasicMatrix<int64_t>(2, 3).det(), task::SizeMismatchException,
+                             "Non-square BasicMatrix::det()")
+    }
+
+
+    {
+        // Up to 16 elements live inline; larger matrices take one aligned block
+        CountingAllocator counting;
+        {
+            task::ScopedAllocator scope(counting);
+            Matrix small1(4, 4), small2 = RandomMatrix(2, 8);
+            small1 = small1 * 2.;
+            ASSERT_TRUE_MSG(counting.allocations == 0, "Small buffer")
+            Matrix moved(std::move(small2));
+            ASSERT_TRUE_MSG(moved.getRows() == 2 && moved[1][7] != 0. && counting.allocations == 0,
+                            "Small buffer move")
+
+            Matrix large = RandomMatrix(5, 5);
+            ASSERT_TRUE_MSG(counting.allocations == 1 && counting.aligned, "Aligned storage")
+            Matrix stolen(std::move(large));
+            ASSERT_TRUE_MSG(counting.allocations == 1, "Moves steal heap storage")
+            stolen = stolen + stolen;
+            ASSERT_TRUE_MSG(counting.allocations == 1, "Same-shape assignment reuses storage")
+            stolen.resize(2, 2);
+            ASSERT_TRUE_MSG(stolen.getRows() == 2 && counting.deallocations == 1, "Resize into the small buffer")
+            stolen = RandomMatrix(30, 30);
+        }
+        // Blocks go back to the allocator that produced them, after the scope too
+        ASSERT_TRUE_MSG(counting.allocations == counting.deallocations, "Blocks are returned")
+
+        CountingAllocator outer, inner;
+        {
+            task::ScopedAllocator scope1(outer);
+            Matrix a = RandomMatrix(10, 10);
+            {
+                task::ScopedAllocator scope2(inner);
+                Matrix b = RandomMatrix(10, 10);
+                a = b * 2.;
+            }
+            Matrix c = RandomMatrix(10, 10);
+        }
+        ASSERT_TRUE_MSG(outer.allocations == 2 && inner.allocations == 1, "Nested ScopedAllocator")
+        ASSERT_TRUE_MSG(outer.allocations == outer.deallocations && inner.allocations == inner.deallocations,
+                        "Nested ScopedAllocator returns")
+
+        // Arena blocks are aligned, distinct and reusable after reset()
+        task::ArenaAllocator arena(1 << 12);
+        void* block1 = arena.allocate(100);
+        void* block2 = arena.allocate(5000);
+        ASSERT_TRUE_MSG(block1 != block2, "ArenaAllocator")
+        ASSERT_TRUE_MSG(reinterpret_cast<uintptr_t>(block1) % task::STORAGE_ALIGNMENT == 0 &&
+                        reinterpret_cast<uintptr_t>(block2) % task::STORAGE_ALIGNMENT == 0,
+                        "ArenaAllocator alignment")
+        {
+            task::ScopedAllocator scope(arena);
+            Matrix a = RandomMatrix(50, 50), b = RandomMatrix(50, 50);
+            ASSERT_TRUE_MSG(a * b == NaiveMultiply(a, b), "Matrices in an arena")
+        }
+        arena.reset();
+        ASSERT_TRUE_MSG(arena.allocate(100) == block1, "ArenaAllocator::reset()")
+
+        // The pool hands a freed block of the same size class straight back
+        auto& pool = task::PoolAllocator::instance();
+        void* block = pool.allocate(1000);
+        pool.deallocate(block, 1000);
+        ASSERT_TRUE_MSG(pool.allocate(900) == block, "PoolAllocator reuse")
+        pool.deallocate(block, 900);
+        pool.trim();
+        ASSERT_TRUE_MSG(pool.getCachedBytes() == 0, "PoolAllocator::trim()")
+
+        // However many blocks are freed, a thread caches a bounded amount
+        std::vector<std::pair<void*, size_t>> blocks;
+        for (size_t bytes = 1000; bytes <= (size_t(4) << 20); bytes *= 2) {
+            for (int i = 0; i < 10; ++i) blocks.emplace_back(pool.allocate(bytes), bytes);
+        }
+        for (auto& [freed, bytes] : blocks) pool.deallocate(freed, bytes);
+        size_t cached = pool.getCachedBytes();
+        ASSERT_TRUE_MSG(cached > 0 && cached <= task::PoolAllocator::MAX_CACHED_BYTES, "PoolAllocator cache bound")
+        void* reused = pool.allocate(1000);
+        ASSERT_TRUE_MSG(pool.getCachedBytes() == cached - 1024, "PoolAllocator cached bytes")
+        pool.deallocate(reused, 1000);
+        pool.trim();
+    }
+
+
+    {
+        // Strassen-Winograd against the naive product, within its normwise bound
+        ASSERT_TRUE_MSG(task::strassen_cutoff() == 0, "Strassen is off by default")
+        for (size_t n : {1, 15, 16, 17, 33, 64, 99}) {
+            auto mat1 = RandomMatrix(n, n);
+            auto mat2 = RandomMatrix(n, n);
+            auto expected = NaiveMultiply(mat1, mat2);
+            Matrix result(n, n);
+            task::strassen(n, mat1.getRawArray(), n, mat2.getRawArray(), n, result.getRawArray(), n, 16,
+                           task::ExecutionPolicy::sequential());
+            double bound = 100. * n * 1e-13;
+            ASSERT_TRUE_MSG(MaxDifference(result, expected) < bound, "strassen()")
+
+            Matrix parallel(n, n);
+            task::strassen(n, mat1.getRawArray(), n, mat2.getRawArray(), n, parallel.getRawArray(), n, 16,
+                           task::ExecutionPolicy::parallel(4));
+            ASSERT_TRUE_MSG(BitwiseEqual(parallel, result), "Parallel strassen()")
+
+            // Matrix products switch over at the cutoff, square ones only
+            task::set_strassen_cutoff(32);
+            ASSERT_TRUE_MSG(task::strassen_cutoff() == 32, "set_strassen_cutoff()")
+            ASSERT_TRUE_MSG(MaxDifference(mat1 * mat2, expected) < bound, "Product with a Strassen cutoff")
+            auto wide = RandomMatrix(n, n + 1);
+            ASSERT_TRUE_MSG(MaxDifference(mat1 * wide, NaiveMultiply(mat1, wide)) < 1e-9,
+                            "Non-square product with a Strassen cutoff")
+            task::set_strassen_cutoff(0);
+            if (n < 32) {
+                ASSERT_TRUE_MSG(MaxDifference(mat1 * mat2, expected) < 1e-9, "Product below the Strassen cutoff")
+            }
+        }
+
+        // Blocks with wider leading dimensions
+        auto mat = RandomMatrix(40, 50);
+        Matrix result = RandomMatrix(40, 45);
+        task::strassen(37, mat.getRawArray(), 50, mat.getRawArray() + 3, 50, result.getRawArray(), 45, 8,
+                       task::ExecutionPolicy::sequential());
+        ASSERT_TRUE_MSG(MaxDifference(result.block(0, 0, 37, 37), mat.block(0, 0, 37, 37) * mat.block(0, 3, 37, 37)) < 1e-10,
+                        "strassen() on blocks")
+    }
+
+
+    {
+        // Batches of every padding remainder against the same matrices one by one
+        const task::simd::Isa isas[] = {task::simd::Isa::Scalar, task::simd::Isa::Avx2, task::simd::Isa::Avx512};
+        for (auto isa : isas) {
+            task::simd::set_isa(isa);
+            for (size_t count : {0, 1, 7, 8, 9, 17}) {
+                for (size_t n : {1, 2, 3, 4, 5}) {
+                    task::MatrixBatch batch1(count, n, n), batch2(count, n, n);
+                    std::vector<Matrix> mats1, mats2;
+                    for (size_t k = 0; k < count; ++k) {
+                        mats1.push_back(RandomMatrix(n, n));
+                        mats2.push_back(RandomMatrix(n, n));
+                        batch1.setMatrix(k, mats1[k]);
+                        batch2.setMatrix(k, mats2[k]);
+                    }
+                    auto product = task::MatrixBatch::multiply(batch1, batch2);
+                    auto dets = batch1.det();
+                    auto transposed = batch1.transposed();
+                    ASSERT_TRUE_MSG(product.size() == count && dets.size() == count, "MatrixBatch sizes")
+                    for (size_t k = 0; k < count; ++k) {
+                        ASSERT_TRUE_MSG(BitwiseEqual(batch1.getMatrix(k), mats1[k]), "MatrixBatch round trip")
+                        ASSERT_TRUE_MSG(product.getMatrix(k) == NaiveMultiply(mats1[k], mats2[k]),
+                                        "MatrixBatch::multiply()")
+                        double det = NaiveDet(mats1[k]);
+                        ASSERT_TRUE_MSG(fabs(dets[k] - det) <= 1e-9 * (1. + fabs(det)), "MatrixBatch::det()")
+                        ASSERT_TRUE_MSG(transposed.getMatrix(k) == mats1[k].transposed(), "MatrixBatch::transposed()")
+                    }
+
+                    // Diagonally dominant, so every matrix is well conditioned
+                    for (size_t k = 0; k < count; ++k) {
+                        for (size_t i = 0; i < n; ++i) batch1.get(k, i, i) += 100.;
+                    }
+                    auto inverse = batch1.inverse();
+                    for (size_t k = 0; k < count; ++k) {
+                        ASSERT_TRUE_MSG(MaxDifference(batch1.getMatrix(k) * inverse.getMatrix(k), Matrix(n, n)) < 1e-9,
+                                        "MatrixBatch::inverse()")
+                    }
+                }
+            }
+        }
+        task::simd::set_isa(task::simd::Isa::Avx512);
+
+        // Non-square shapes, errors and value semantics
+        task::MatrixBatch wide(9, 2, 3), tall(9, 3, 4);
+        for (size_t k = 0; k < 9; ++k) {
+            wide.setMatrix(k, RandomMatrix(2, 3));
+            tall.setMatrix(k, RandomMatrix(3, 4));
+        }
+        auto product = task::MatrixBatch::multiply(wide, tall);
+        ASSERT_TRUE_MSG(product.getRows() == 2 && product.getColumns() == 4, "Non-square MatrixBatch::multiply()")
+        ASSERT_TRUE_MSG(product.getMatrix(8) == NaiveMultiply(wide.getMatrix(8), tall.getMatrix(8)),
+                        "Non-square MatrixBatch::multiply()")
+        ASSERT_EXCEPTION_MSG(task::MatrixBatch::multiply(wide, wide), task::SizeMismatchException, "MatrixBatch shapes")
+        ASSERT_EXCEPTION_MSG(task::MatrixBatch::multiply(wide, task::MatrixBatch(8, 3, 4)), task::SizeMismatchException,
+                             "MatrixBatch counts")
+        ASSERT_EXCEPTION_MSG(wide.det(), task::SizeMismatchException, "Non-square MatrixBatch::det()")
+        ASSERT_EXCEPTION_MSG(wide.setMatrix(0, Matrix(3, 2)), task::SizeMismatchException, "MatrixBatch::setMatrix()")
+        ASSERT_EXCEPTION_MSG(wide.get(9, 0, 0), task::OutOfBoundsException, "MatrixBatch::get()")
+        task::MatrixBatch singular(3, 3, 3);
+        singular.setMatrix(1, Matrix(3, 3) * 0.);
+        ASSERT_EXCEPTION_MSG(singular.inverse(), task::SingularMatrixException, "Singular MatrixBatch::inverse()")
+        ASSERT_TRUE_MSG(task::MatrixBatch(2, 3, 3).getMatrix(1) == Matrix(3, 3), "MatrixBatch starts as identities")
+
+        auto copy = wide;
+        task::MatrixBatch moved(std::move(wide));
+        ASSERT_TRUE_MSG(moved.getMatrix(4) == copy.getMatrix(4) && wide.size() == 0, "MatrixBatch move")
+        wide = copy;
+        ASSERT_TRUE_MSG(wide.getMatrix(8) == copy.getMatrix(8), "MatrixBatch copy assignment")
+    }
+
+
+    {
+        // The text_io benchmark case: "n n" and the elements, read back into
+        // a matrix of another shape, for the sizes its sweep visits
+        for (size_t n = 2; n <= 256; n *= 2) {
+            auto mat = RandomMatrix(n, n);
+            Matrix read(3, 1);
+            std::stringstream stream;
+            stream << n << " " << n << mat;
+            stream >> read;
+            ASSERT_TRUE_MSG(read.getRows() == n && read.getColumns() == n, "Benchmark text round trip shape")
+            ASSERT_TRUE_MSG(MaxDifference(read, mat) < 1e-10, "Benchmark text round trip")
+        }
+        Matrix empty(2, 2);
+        std::stringstream stream("0 0");
+        stream >> empty;
+        ASSERT_TRUE_MSG(empty.getRows() == 0 && empty.getColumns() == 0, "Empty text round trip")
+    }
+
+
+    {
+        // operator() and operator[] address the same elements and are checked
+        // in this build, as MATRIX_BOUNDS_CHECK defaults to on without NDEBUG
+        ASSERT_TRUE_MSG(MATRIX_BOUNDS_CHECK == 1, "MATRIX_BOUNDS_CHECK default")
+        auto mat = RandomMatrix(5, 7);
+        const Matrix& const_mat = mat;
+        for (size_t i = 0; i < 5; ++i) {
+            for (size_t j = 0; j < 7; ++j) {
+                ASSERT_TRUE_MSG(mat(i, j) == mat.get(i, j) && const_mat(i, j) == const_mat[i][j], "operator()")
+            }
+        }
+        mat(4, 6) = 42.;
+        ASSERT_TRUE_MSG(mat[4][6] == 42. && mat.get(4, 6) == 42., "operator() write")
+        ASSERT_EXCEPTION_MSG(mat(5, 0), task::OutOfBoundsException, "operator() bounds")
+        ASSERT_EXCEPTION_MSG(mat(0, 7), task::OutOfBoundsException, "operator() bounds")
+        ASSERT_EXCEPTION_MSG(const_mat(5, 6), task::OutOfBoundsException, "const operator() bounds")
+        ASSERT_EXCEPTION_MSG(mat[5], task::OutOfBoundsException, "operator[] bounds")
+        ASSERT_EXCEPTION_MSG(mat[0][7], task::OutOfBoundsException, "Row::operator[] bounds")
+        ASSERT_EXCEPTION_MSG(const_mat[4][7], task::OutOfBoundsException, "const Row::operator[] bounds")
+        Matrix empty;
+        empty.resize(0, 0);
+        ASSERT_EXCEPTION_MSG(empty(0, 0), task::OutOfBoundsException, "operator() on an empty matrix")
+    }
+
+
+    {
+        // pow against repeated naive products, on both sides of the threshold
+        // where multiply switches to blocked kernels
+        ASSERT_TRUE_MSG(RandomMatrix(3, 3).pow(0) == Matrix(3, 3), "pow(0) is the identity")
+        ASSERT_EXCEPTION_MSG(RandomMatrix(3, 4).pow(2), task::SizeMismatchException, "pow of a non-square matrix")
+        ASSERT_EXCEPTION_MSG(RandomMatrix(4, 3).expm(), task::SizeMismatchException, "expm of a non-square matrix")
+        for (size_t n : {1, 2, 5, 17, 64, 70}) {
+            Matrix mat = RandomMatrix(n, n) * (0.1 / n);
+            ASSERT_TRUE_MSG(mat.pow(1) == mat, "pow(1)")
+            Matrix expected = mat;
+            for (size_t k = 2; k <= 9; ++k) {
+                expected = NaiveMultiply(expected, mat);
+                ASSERT_TRUE_MSG(MaxDifference(mat.pow(k), expected) < 1e-12, "pow(k)")
+                ASSERT_TRUE_MSG(BitwiseEqual(mat.pow(k, task::ExecutionPolicy::parallel(3)), mat.pow(k)),
+                                "pow with a policy")
+            }
+        }
+        Matrix empty;
+        empty.resize(0, 0);
+        ASSERT_TRUE_MSG(empty.pow(5).getRows() == 0 && empty.expm().getRows() == 0, "pow and expm of 0 x 0")
+    }
+
+
+    {
+        // expm: closed forms for the zero, diagonal and nilpotent cases
+        for (size_t n : {1, 3, 8, 33}) {
+            Matrix zero = Matrix(n, n) * 0.;
+            ASSERT_TRUE_MSG(MaxDifference(zero.expm(), Matrix(n, n)) < 1e-15, "expm(0) is the identity")
+
+            for (double scale : {0.1, 1., 10.}) {
+                Matrix diagonal = Matrix(n, n) * 0.;
+                for (size_t i = 0; i < n; ++i) {
+                    diagonal[i][i] = scale * RandomDouble() / 10.;
+                }
+                Matrix result = diagonal.expm();
+                for (size_t i = 0; i < n; ++i) {
+                    for (size_t j = 0; j < n; ++j) {
+                        double expected = i == j ? std::exp(diagonal[i][i]) : 0.;
+                        ASSERT_TRUE_MSG(std::abs(result[i][j] - expected) <= 1e-12 * std::max(1., expected),
+                                        "expm of a diagonal matrix")
+                    }
+                }
+            }
+
+            // Strictly upper triangular with N^2 = 0: expm is exactly I + N
+            Matrix nilpotent = Matrix(n, n) * 0.;
+            if (n > 1) {
+                nilpotent[0][n - 1] = RandomDouble();
+            }
+            ASSERT_TRUE_MSG(MaxDifference(nilpotent.expm(), Matrix(n, n) + nilpotent) < 1e-12, "expm(N) is I + N")
+
+            Matrix mat = RandomMatrix(n, n) * (1. / n);
+            Matrix product = NaiveMultiply(mat.expm(), Matrix(mat * -1.).expm());
+            ASSERT_TRUE_MSG(MaxDifference(product, Matrix(n, n)) < 1e-9, "expm(A) * expm(-A) is the identity")
+            ASSERT_TRUE_MSG(BitwiseEqual(mat.expm(task::ExecutionPolicy::parallel(4)), mat.expm()),
+                            "expm with a policy")
+        }
+    }
+
+
+    {
+        // QR: factors, solves and least squares across the panel width of 32
+        for (auto shape : {std::make_pair(1, 1), std::make_pair(5, 3), std::make_pair(31, 31),
+                           std::make_pair(33, 32), std::make_pair(70, 65), std::make_pair(100, 33)}) {
+            size_t m = shape.first, n = shape.second;
+            Matrix a = RandomMatrix(m, n);
+            task::QRDecomposition qr(a);
+            ASSERT_TRUE_MSG(qr.getRows() == m && qr.getColumns() == n && qr.isFullRank(), "QR shape")
+
+            Matrix q = qr.getQ(), r = qr.getR();
+            ASSERT_TRUE_MSG(q.getRows() == m && q.getColumns() == n && r.getRows() == n && r.getColumns() == n,
+                            "thin factors")
+            ASSERT_TRUE_MSG(MaxDifference(NaiveMultiply(q.transposed(), q), Matrix(n, n)) < 1e-10,
+                            "Q has orthonormal columns")
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t j = 0; j < i; ++j) {
+                    ASSERT_TRUE_MSG(r[i][j] == 0., "R is upper triangular")
+                }
+            }
+            ASSERT_TRUE_MSG(MaxDifference(NaiveMultiply(q, r), a) < 1e-9, "Q * R is A")
+
+            // Least squares against the normal equations A^T A x = A^T b
+            Matrix b = RandomMatrix(m, 3);
+            Matrix at = a.transposed();
+            Matrix expected = task::LUDecomposition(NaiveMultiply(at, a)).solve(NaiveMultiply(at, b));
+            Matrix x = task::lstsq(a, b);
+            ASSERT_TRUE_MSG(MaxDifference(x, expected) < 1e-7, "lstsq")
+            ASSERT_TRUE_MSG(BitwiseEqual(task::lstsq(a, b, task::ExecutionPolicy::parallel(3)), x),
+                            "lstsq with a policy")
+            if (m == n) {
+                ASSERT_TRUE_MSG(MaxDifference(NaiveMultiply(a, x), b) < 1e-8, "square QR solve")
+            }
+
+            std::vector<double> column(m);
+            for (size_t i = 0; i < m; ++i) {
+                column[i] = b[i][0];
+            }
+            std::vector<double> v = task::lstsq(a, column);
+            ASSERT_TRUE_MSG(v.size() == n, "vector lstsq size")
+            for (size_t i = 0; i < n; ++i) {
+                ASSERT_TRUE_MSG(std::abs(v[i] - x[i][0]) < 1e-10, "vector lstsq")
+            }
+            ASSERT_EXCEPTION_MSG(qr.solve(RandomMatrix(m + 1, 1)), task::SizeMismatchException, "QR solve size")
+        }
+        ASSERT_EXCEPTION_MSG(task::QRDecomposition(RandomMatrix(3, 4)), task::SizeMismatchException,
+                             "QR of a wide matrix")
+
+        Matrix rank_deficient = RandomMatrix(6, 3);
+        for (size_t i = 0; i < 6; ++i) {
+            rank_deficient[i][2] = rank_deficient[i][0] * 2.;
+        }
+        task::QRDecomposition deficient(rank_deficient);
+        ASSERT_TRUE_MSG(!deficient.isFullRank(), "rank deficient QR")
+        ASSERT_EXCEPTION_MSG(deficient.solve(RandomMatrix(6, 1)), task::SingularMatrixException,
+                             "rank deficient lstsq")
+    }
+
+
+    {
+        // Cholesky of G G^T / 100n + I across the panel width of 64
+        for (size_t n : {1, 2, 7, 63, 64, 65, 130}) {
+            Matrix g = RandomMatrix(n, n);
+            Matrix a = NaiveMultiply(g, g.transposed()) * (0.01 / n) + Matrix(n, n);
+            task::CholeskyDecomposition cholesky(a);
+            ASSERT_TRUE_MSG(cholesky.getSize() == n && cholesky.isPositiveDefinite(), "positive definite")
+
+            Matrix l = cholesky.getL();
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t j = i + 1; j < n; ++j) {
+                    ASSERT_TRUE_MSG(l[i][j] == 0., "L is lower triangular")
+                }
+            }
+            double scale = MaxDifference(a, Matrix(n, n) * 0.);
+            ASSERT_TRUE_MSG(MaxDifference(NaiveMultiply(l, l.transposed()), a) < 1e-12 * scale, "L * L^T is A")
+
+            double det = NaiveDet(a);
+            ASSERT_TRUE_MSG(std::abs(cholesky.det() - det) <= 1e-9 * std::abs(det), "Cholesky det")
+
+            Matrix b = RandomMatrix(n, 4);
+            Matrix x = cholesky.solve(b);
+            ASSERT_TRUE_MSG(MaxDifference(NaiveMultiply(a, x), b) < 1e-9, "Cholesky solve")
+            ASSERT_TRUE_MSG(MaxDifference(NaiveMultiply(a, cholesky.inverse()), Matrix(n, n)) < 1e-9,
+                            "Cholesky inverse")
+            ASSERT_TRUE_MSG(BitwiseEqual(task::CholeskyDecomposition(a, task::ExecutionPolicy::parallel(4)).getL(), l),
+                            "Cholesky with a policy")
+            ASSERT_EXCEPTION_MSG(cholesky.solve(RandomMatrix(n + 1, 1)), task::SizeMismatchException,
+                                 "Cholesky solve size")
+
+            // Only the last pivot fails, past the first panel once n > 64
+            Matrix indefinite = a;
+            indefinite[n - 1][n - 1] = -1.;
+            task::CholeskyDecomposition failed(indefinite);
+            ASSERT_TRUE_MSG(!failed.isPositiveDefinite(), "indefinite matrix")
+            ASSERT_EXCEPTION_MSG(failed.det(), task::SingularMatrixException, "det of an indefinite matrix")
+            ASSERT_EXCEPTION_MSG(failed.solve(b), task::SingularMatrixException, "solve with an indefinite matrix")
+        }
+        ASSERT_EXCEPTION_MSG(task::CholeskyDecomposition(RandomMatrix(3, 4)), task::SizeMismatchException,
+                             "Cholesky of a non-square matrix")
+    }
+
+
+    {
+        // MatrixWriter and MatrixReader round trips with blocks that do not
+        // divide the rows, and the out-of-core products against dense ones
+        for (auto format : {task::MatrixFormat::Text, task::MatrixFormat::Binary}) {
+            for (size_t rows : {0, 1, 7, 100}) {
+                size_t cols = 5;
+                Matrix mat = RandomMatrix(rows, cols);
+                if (rows == 0) {
+                    mat.resize(0, cols);
+                }
+
+                std::stringstream stream;
+                stream.precision(3);
+                task::MatrixWriter writer(stream, format, rows, cols);
+                for (size_t row = 0; row < rows; row += 3) {
+                    writer.write(mat.block(row, 0, std::min<size_t>(3, rows - row), cols));
+                }
+                ASSERT_TRUE_MSG(stream.precision() == 3, "MatrixWriter keeps the stream precision")
+                ASSERT_EXCEPTION_MSG(writer.write(RandomMatrix(1, cols)), task::SizeMismatchException,
+                                     "MatrixWriter past the last row")
+                writer.finish();
+                std::string contents = stream.str();
+
+                for (size_t block_rows : {1, 4, 1000}) {
+                    std::stringstream input(contents);
+                    task::MatrixReader reader(input, format);
+                    ASSERT_TRUE_MSG(reader.getRows() == rows && reader.getColumns() == cols, "MatrixReader header")
+                    ASSERT_EXCEPTION_MSG(reader.next(mat, 0), std::invalid_argument, "MatrixReader block of 0 rows")
+                    Matrix block;
+                    size_t row = 0;
+                    while (reader.next(block, block_rows)) {
+                        ASSERT_TRUE_MSG(block.getRows() == std::min(block_rows, rows - row), "MatrixReader block")
+                        ASSERT_TRUE_MSG(BitwiseEqual(block, Matrix(mat.block(row, 0, block.getRows(), cols))),
+                                        "MatrixReader round trip")
+                        row += block.getRows();
+                    }
+                    ASSERT_TRUE_MSG(row == rows && reader.getRemainingRows() == 0, "MatrixReader reads every row")
+                }
+
+                std::vector<double> x(cols), y(rows);
+                for (double& value : x) value = RandomDouble();
+                for (double& value : y) value = RandomDouble();
+                Matrix mat_t = mat.transposed();
+                for (size_t block_rows : {1, 3, 64}) {
+                    std::stringstream gramian_input(contents), multiply_input(contents), transposed_input(contents);
+                    task::MatrixReader gramian_reader(gramian_input, format);
+                    task::MatrixReader multiply_reader(multiply_input, format);
+                    task::MatrixReader transposed_reader(transposed_input, format);
+
+                    Matrix expected = NaiveMultiply(mat_t, mat);
+                    ASSERT_TRUE_MSG(MaxDifference(task::streamGramian(gramian_reader, block_rows), expected) < 1e-9,
+                                    "streamGramian")
+                    std::vector<double> ax = task::streamMultiply(multiply_reader, x, block_rows);
+                    std::vector<double> aty = task::streamMultiplyTransposed(transposed_reader, y, block_rows);
+                    ASSERT_TRUE_MSG(ax.size() == rows && aty.size() == cols, "out-of-core result sizes")
+                    for (size_t i = 0; i < rows; ++i) {
+                        double sum = 0;
+                        for (size_t j = 0; j < cols; ++j) sum += mat[i][j] * x[j];
+                        ASSERT_TRUE_MSG(std::abs(ax[i] - sum) < 1e-10, "streamMultiply")
+                    }
+                    for (size_t j = 0; j < cols; ++j) {
+                        double sum = 0;
+                        for (size_t i = 0; i < rows; ++i) sum += y[i] * mat[i][j];
+                        ASSERT_TRUE_MSG(std::abs(aty[j] - sum) < 1e-9, "streamMultiplyTransposed")
+                    }
+                }
+
+                std::stringstream input(contents);
+                task::MatrixReader reader(input, format);
+                ASSERT_EXCEPTION_MSG(task::streamGramian(reader, 0), std::invalid_argument,
+                                     "streamGramian with blocks of 0 rows")
+                ASSERT_EXCEPTION_MSG(task::streamMultiply(reader, x, 0), std::invalid_argument,
+                                     "streamMultiply with blocks of 0 rows")
+                ASSERT_EXCEPTION_MSG(task::streamMultiply(reader, std::vector<double>(cols + 1), 4),
+                                     task::SizeMismatchException, "streamMultiply size")
+                ASSERT_EXCEPTION_MSG(task::streamMultiplyTransposed(reader, std::vector<double>(rows + 1), 4),
+                                     task::SizeMismatchException, "streamMultiplyTransposed size")
+            }
+        }
+
+        std::stringstream stream;
+        task::MatrixWriter writer(stream, task::MatrixFormat::Text, 3, 2);
+        ASSERT_EXCEPTION_MSG(writer.write(RandomMatrix(2, 3)), task::SizeMismatchException, "MatrixWriter width")
+        writer.write(RandomMatrix(2, 2));
+        ASSERT_EXCEPTION_MSG(writer.finish(), task::MatrixIOException, "MatrixWriter missing rows")
+
+        std::stringstream truncated("3 2\n1 2 3");
+        task::MatrixReader reader(truncated, task::MatrixFormat::Text);
+        Matrix block;
+        ASSERT_EXCEPTION_MSG(reader.next(block, 3), task::MatrixIOException, "MatrixReader truncated input")
+        std::stringstream malformed("x 2");
+        ASSERT_EXCEPTION_MSG(task::MatrixReader(malformed, task::MatrixFormat::Text), task::MatrixIOException,
+                             "MatrixReader malformed header")
+    }
+
+
+    {
+        // det() cache: every write path drops it, const access keeps it
+        const size_t n = 6;
+        auto fresh = [&](const Matrix& mat) {
+            double expected = NaiveDet(mat);
+            return std::abs(mat.det() - expected) <= 1e-9 * std::max(1., std::abs(expected));
+        };
+        Matrix mat = RandomMatrix(n, n);
+        ASSERT_TRUE_MSG(fresh(mat), "det")
+        mat.set(1, 2, 100.);
+        ASSERT_TRUE_MSG(fresh(mat), "det after set()")
+        mat.get(2, 3) = -50.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after get()")
+        mat[3][4] = 70.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after operator[]")
+        mat(4, 5) = 30.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after operator()")
+        mat.getRawArray()[0] = 20.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after getRawArray()")
+        mat.view()[5][0] = -20.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after writing a view")
+        mat.block(1, 1, 2, 2)[0][1] = 11.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after writing a block")
+        mat += RandomMatrix(n, n);
+        ASSERT_TRUE_MSG(fresh(mat), "det after +=")
+        mat -= RandomMatrix(n, n) * 2.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after -= of an expression")
+        mat *= 3.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after *= scalar")
+        mat *= RandomMatrix(n, n);
+        ASSERT_TRUE_MSG(fresh(mat), "det after *=")
+        mat.noalias() = mat * 0.5 + RandomMatrix(n, n);
+        ASSERT_TRUE_MSG(fresh(mat), "det after noalias()")
+        mat = RandomMatrix(n, n);
+        ASSERT_TRUE_MSG(fresh(mat), "det after assignment")
+        mat = RandomMatrix(n, n) + RandomMatrix(n, n);
+        ASSERT_TRUE_MSG(fresh(mat), "det after assigning an expression")
+        mat.transpose();
+        ASSERT_TRUE_MSG(fresh(mat), "det after transpose()")
+        mat.resize(n - 1, n - 1);
+        ASSERT_TRUE_MSG(fresh(mat), "det after resize()")
+
+        Matrix copy = mat;
+        copy[0][0] += 1.;
+        ASSERT_TRUE_MSG(fresh(copy) && fresh(mat), "det of a copy")
+        Matrix moved = std::move(copy);
+        ASSERT_TRUE_MSG(fresh(moved), "det after a move")
+        copy = mat;
+        ASSERT_TRUE_MSG(fresh(copy), "det of a moved-from matrix assigned to")
+
+        double cached;
+        // Views, blocks and rows kept from before det() drop it when they
+        // write, including views of views and const reads in between
+        auto view = mat.view();
+        auto block = mat.block(1, 1, 2, 2);
+        auto column = block.column(1);
+        auto row = mat[2];
+        mat.det();
+        view[0][1] = 5.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after writing a view kept from before det()")
+        block.get(0, 0) = -3.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after writing a kept block")
+        column[1][0] = 9.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after writing a column of a kept block")
+        block.fill(2.);
+        ASSERT_TRUE_MSG(fresh(mat), "det after filling a kept block")
+        view *= 0.5;
+        ASSERT_TRUE_MSG(fresh(mat), "det after scaling a kept view")
+        block = RandomMatrix(2, 2);
+        ASSERT_TRUE_MSG(fresh(mat), "det after assigning a kept block")
+        block += RandomMatrix(2, 2) * 2.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after += through a kept block")
+        row[1] = 4.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after writing a kept row")
+        double* view_data = view.getRawArray();
+        view_data[0] = 1.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after getRawArray() of a kept view")
+
+        // A write through a pointer kept from before det() is not seen, so
+        // the cached value survives the const reads and view reads in between
+        double* data = mat.getRawArray();
+        cached = mat.det();
+        data[0] += 1.;
+        const Matrix& const_mat = mat;
+        double read = const_mat(0, 0) + const_mat[1][1] + const_mat.get(2, 2) + const_mat.getRawArray()[3];
+        read += const_mat.view()[0][0] + mat.transposed()[0][0] + mat.trace();
+        Matrix scaled = view * 1., part = block;
+        read += scaled(0, 0) + part(1, 1) + task::ConstMatrixView(block)[1][1] + block.eval(0, 0);
+        ASSERT_TRUE_MSG(std::isfinite(read) && mat.det() == cached, "const access keeps the cached det()")
+        mat[0][0] += 0.;
+        ASSERT_TRUE_MSG(fresh(mat), "det after the next write")
+    }
+
+
+    {
+        // gemv and gevm against naive sums: alpha, beta, a leading dimension
+        // wider than the rows, tails of the SIMD width and empty shapes
+        auto random_vector = [](size_t size) {
+            std::vector<double> v(size);
+            for (double& value : v) value = RandomDouble();
+            return v;
+        };
+        for (auto shape : {std::make_pair(0, 5), std::make_pair(5, 0), std::make_pair(1, 1), std::make_pair(3, 7),
+                           std::make_pair(1000, 3), std::make_pair(3, 1000), std::make_pair(5000, 9),
+                           std::make_pair(70, 1500), std::make_pair(129, 131)}) {
+            size_t m = shape.first, n = shape.second, lda = n + 3;
+            std::vector<double> a = random_vector(m * lda);
+            std::vector<double> x = random_vector(n), xt = random_vector(m);
+            for (double alpha : {1., -0.5}) {
+                for (double beta : {0., 1., 2.5}) {
+                    std::vector<double> y = random_vector(m), yt = random_vector(n);
+                    std::vector<double> expected = y, expected_t = yt;
+                    for (size_t i = 0; i < m; ++i) {
+                        double sum = 0;
+                        for (size_t j = 0; j < n; ++j) sum += a[i * lda + j] * x[j];
+                        expected[i] = alpha * sum + (beta == 0. ? 0. : beta * y[i]);
+                    }
+                    for (size_t j = 0; j < n; ++j) {
+                        double sum = 0;
+                        for (size_t i = 0; i < m; ++i) sum += xt[i] * a[i * lda + j];
+                        expected_t[j] = alpha * sum + (beta == 0. ? 0. : beta * yt[j]);
+                    }
+
+                    std::vector<double> y_parallel = y, yt_parallel = yt;
+                    task::gemv(m, n, alpha, a.data(), lda, x.data(), beta, y.data());
+                    task::gevm(m, n, alpha, xt.data(), a.data(), lda, beta, yt.data());
+                    task::gemv(m, n, alpha, a.data(), lda, x.data(), beta, y_parallel.data(),
+                               task::ExecutionPolicy::parallel(3));
+                    task::gevm(m, n, alpha, xt.data(), a.data(), lda, beta, yt_parallel.data(),
+                               task::ExecutionPolicy::parallel(5));
+                    for (size_t i = 0; i < m; ++i) {
+                        ASSERT_TRUE_MSG(std::abs(y[i] - expected[i]) < 1e-9 * (n + 1), "gemv")
+                    }
+                    for (size_t j = 0; j < n; ++j) {
+                        ASSERT_TRUE_MSG(std::abs(yt[j] - expected_t[j]) < 1e-9 * (m + 1), "gevm")
+                    }
+                    ASSERT_TRUE_MSG(y_parallel == y, "parallel gemv is bitwise sequential")
+                    ASSERT_TRUE_MSG(yt_parallel == yt, "parallel gevm is bitwise sequential")
+                }
+            }
+        }
+
+        // The Matrix forms, through views of blocks too
+        Matrix mat = RandomMatrix(37, 21);
+        std::vector<double> x = random_vector(21), xt = random_vector(37);
+        std::vector<double> y = mat * x, yt = xt * mat;
+        Matrix x_column(21, 1), xt_row(1, 37);
+        for (size_t i = 0; i < 21; ++i) x_column[i][0] = x[i];
+        for (size_t i = 0; i < 37; ++i) xt_row[0][i] = xt[i];
+        Matrix column = NaiveMultiply(mat, x_column);
+        Matrix row = NaiveMultiply(xt_row, mat);
+        ASSERT_TRUE_MSG(y.size() == 37 && yt.size() == 21, "Matrix * vector sizes")
+        for (size_t i = 0; i < 37; ++i) {
+            ASSERT_TRUE_MSG(std::abs(y[i] - column[i][0]) < 1e-9, "Matrix * vector")
+        }
+        for (size_t j = 0; j < 21; ++j) {
+            ASSERT_TRUE_MSG(std::abs(yt[j] - row[0][j]) < 1e-9, "vector * Matrix")
+        }
+        std::vector<double> y_block(5);
+        task::gemv(mat.block(2, 3, 5, 4), std::vector<double>(x.begin(), x.begin() + 4), y_block,
+                   task::ExecutionPolicy::parallel(2));
+        for (size_t i = 0; i < 5; ++i) {
+            double sum = 0;
+            for (size_t j = 0; j < 4; ++j) sum += mat[i + 2][j + 3] * x[j];
+            ASSERT_TRUE_MSG(std::abs(y_block[i] - sum) < 1e-12, "gemv of a block")
+        }
+        ASSERT_EXCEPTION_MSG(mat * xt, task::SizeMismatchException, "Matrix * vector size")
+        ASSERT_EXCEPTION_MSG(x * mat, task::SizeMismatchException, "vector * Matrix size")
+        std::vector<double> wrong(36);
+        ASSERT_EXCEPTION_MSG(task::gemv(mat, x, wrong), task::SizeMismatchException, "gemv output size")
+        ASSERT_EXCEPTION_MSG(task::gevm(xt, mat, wrong), task::SizeMismatchException, "gevm output size")
+    }
+
+
+    {
+        // Instrumentation counters: the hooks record whether or not the
+        // macros are compiled in, and the macros only count when they are
+        namespace inst = task::instrumentation;
+        inst::reset();
+        Matrix product = RandomMatrix(20, 20) * RandomMatrix(20, 20);
+        double det = product.det() + product.det();
+        inst::Snapshot counted = inst::snapshot();
+        uint64_t expected_calls = MATRIX_INSTRUMENTATION ? 1 : 0;
+        ASSERT_TRUE_MSG(counted[inst::Operation::Multiply].calls == expected_calls, "multiply counter")
+        ASSERT_TRUE_MSG(counted[inst::Operation::Multiply].bytes == expected_calls * 20 * 20 * sizeof(double),
+                        "multiply bytes")
+        ASSERT_TRUE_MSG(std::isfinite(det) && counted[inst::Operation::Det].calls == expected_calls &&
+                        counted[inst::Operation::DetCached].calls == expected_calls, "det counters")
+
+        inst::reset();
+        inst::record(inst::Operation::Transpose, 100, 7);
+        inst::record(inst::Operation::Transpose, 28, 3);
+        {
+            inst::ScopedTimer timer(inst::Operation::Power, 64);
+        }
+        // A thread that has exited still counts
+        std::thread([] { inst::record(inst::Operation::Transpose, 2, 0); }).join();
+        inst::Snapshot snapshot = inst::snapshot();
+        ASSERT_TRUE_MSG(snapshot[inst::Operation::Transpose].calls == 3 &&
+                        snapshot[inst::Operation::Transpose].bytes == 130 &&
+                        snapshot[inst::Operation::Transpose].cycles == 10, "record()")
+        ASSERT_TRUE_MSG(snapshot[inst::Operation::Power].calls == 1 && snapshot[inst::Operation::Power].bytes == 64,
+                        "ScopedTimer")
+        ASSERT_TRUE_MSG(snapshot[inst::Operation::Copy].calls == 0, "untouched counter")
+
+        std::stringstream json;
+        inst::writeJson(json, snapshot);
+        std::string text = json.str();
+        ASSERT_TRUE_MSG(text.find(MATRIX_INSTRUMENTATION ? "\"enabled\": true" : "\"enabled\": false") == 1,
+                        "writeJson enabled")
+        ASSERT_TRUE_MSG(text.find("\"transpose\": {\"calls\": 3, \"bytes\": 130, \"cycles\": 10}") !=
+                        std::string::npos, "writeJson counters")
+        for (size_t i = 0; i < static_cast<size_t>(inst::Operation::Count); ++i) {
+            std::string name = inst::operationName(inst::Operation(i));
+            ASSERT_TRUE_MSG(name != "unknown" && text.find("\"" + name + "\"") != std::string::npos,
+                            "writeJson names every operation")
+        }
+
+        inst::reset();
+        inst::Snapshot cleared = inst::snapshot();
+        ASSERT_TRUE_MSG(cleared[inst::Operation::Transpose].calls == 0 && cleared[inst::Operation::Power].calls == 0,
+                        "reset()")
+    }
+
+
+    {
+        // operator== compares shapes before elements
+        Matrix wide = RandomMatrix(2, 3);
+        Matrix tall(3, 2);
+        std::copy(wide.getRawArray(), wide.getRawArray() + 6, tall.getRawArray());
+        ASSERT_TRUE_MSG(!(wide == tall) && wide != tall, "Same elements, other shape")
+        ASSERT_TRUE_MSG(!(Matrix(2, 2) == Matrix(3, 3)) && Matrix(3, 3) != Matrix(2, 2), "Different element counts")
+        Matrix empty_rows(1, 1), empty_cols(1, 1);
+        empty_rows.resize(0, 4);
+        empty_cols.resize(4, 0);
+        ASSERT_TRUE_MSG(empty_rows != empty_cols && empty_rows == Matrix(empty_rows), "Empty shapes")
+    }
+
+
+    {
+        // Expressions where a whole matrix is needed are evaluated first
+        Matrix a = RandomMatrix(5, 5), b = RandomMatrix(5, 5), c = RandomMatrix(5, 4);
+        Matrix sum = a + b;
+        ASSERT_TRUE_MSG(BitwiseEqual((a + b) * c, sum * c), "(a + b) * c")
+        ASSERT_TRUE_MSG(BitwiseEqual(c.transposed() * (a - b), c.transposed() * Matrix(a - b)), "c * (a - b)")
+        ASSERT_TRUE_MSG(BitwiseEqual((a * 2.) * (-b), Matrix(a * 2.) * Matrix(-b)), "Product of two nodes")
+        ASSERT_TRUE_MSG(BitwiseEqual(a.view() * (b + b), a * Matrix(b + b)), "View times a node")
+        ASSERT_TRUE_MSG((a + b).det() == sum.det(), "(a + b).det()")
+        ASSERT_TRUE_MSG((-a).trace() == -a.trace(), "(-a).trace()")
+        ASSERT_TRUE_MSG(BitwiseEqual((c * 2.).transposed(), Matrix(c * 2.).transposed()), "(a * 2.).transposed()")
+        ASSERT_TRUE_MSG(BitwiseEqual((a + b).eval(), sum), "eval()")
+        ASSERT_EXCEPTION_MSG((c + c).trace(), task::SizeMismatchException, "trace() of a non-square node")
+        ASSERT_EXCEPTION_MSG((c + c) * c, task::SizeMismatchException, "Product of mismatched nodes")
+    }
+
+
+    {
+        // Single operations on matrices and views run through the simd
+        // kernels, with the destination as either operand
+        for (size_t cols : {1, 3, 8, 13, 64}) {
+            Matrix a = RandomMatrix(7, cols), b = RandomMatrix(7, cols);
+            auto check = [&](const Matrix& result, double (*op)(double, double), const char* msg) {
+                for (size_t i = 0; i < 7; ++i) {
+                    for (size_t j = 0; j < cols; ++j) {
+                        ASSERT_TRUE_MSG(result[i][j] == op(a[i][j], b[i][j]), msg)
+                    }
+                }
+            };
+            auto plus = [](double x, double y) { return x + y; };
+            auto minus = [](double x, double y) { return x - y; };
+            check(a + b, plus, "Leaf + leaf");
+            check(a - b, minus, "Leaf - leaf");
+            check(a.view() - b.block(0, 0, 7, cols), minus, "View - view");
+            check(a * 3., [](double x, double) { return x * 3.; }, "Leaf * scalar");
+            check(-a, [](double x, double) { return -x; }, "Negated leaf");
+
+            Matrix result = a;
+            result = result + b;
+            check(result, plus, "dst + leaf");
+            result = b;
+            result = a + result;
+            check(result, plus, "leaf + dst");
+            result = a;
+            result = result - b;
+            check(result, minus, "dst - leaf");
+            result = b;
+            result = a - result;
+            check(result, minus, "leaf - dst");
+            result = a;
+            result = result * 0.5;
+            check(result, [](double x, double) { return x * 0.5; }, "dst * scalar");
+            result = a;
+            result = -result;
+            check(result, [](double x, double) { return -x; }, "Negated dst");
+            result = a;
+            result = result - result;
+            ASSERT_TRUE_MSG(result == Matrix(7, cols) * 0., "dst - dst")
+
+            // Into a block with a wider leading dimension
+            Matrix wide = RandomMatrix(7, cols + 5);
+            wide.block(0, 2, 7, cols) = a - b;
+            check(Matrix(wide.block(0, 2, 7, cols)), minus, "Leaf - leaf into a block");
+        }
+    }
+
+
+    {
+        // MappedMatrix reads in place wherever a view is taken, and a
+        // corrupt header cannot make readBinary() allocate what it claims
+        const std::string path = "test_matrix.bin";
+        auto mat = RandomMatrix(9, 6), other = RandomMatrix(6, 4);
+        task::saveBinary(path, mat);
+        {
+            task::MappedMatrix mapped(path);
+            ASSERT_TRUE_MSG(mapped.view().getRawArray() == mapped.getRawArray() &&
+                            task::ConstMatrixView(mapped).getLeadingDimension() == 6, "MappedMatrix view")
+            ASSERT_TRUE_MSG(BitwiseEqual(mapped * other, mat * other), "MappedMatrix product")
+            ASSERT_TRUE_MSG(BitwiseEqual(mapped.transposed() * mapped, mat.transposed() * mat), "MappedMatrix on the right")
+            ASSERT_TRUE_MSG(BitwiseEqual(Matrix::multiply(mapped, other, task::ExecutionPolicy::parallel(2)),
+                                         mat * other), "MappedMatrix policy multiply")
+            std::vector<double> x(6, 1.5), y(9), expected(9);
+            task::gemv(mapped, x, y);
+            task::gemv(mat, x, expected);
+            ASSERT_TRUE_MSG(y == expected, "MappedMatrix gemv")
+            Matrix square = RandomMatrix(6, 6);
+            task::saveBinary(path, square);
+            task::MappedMatrix mapped_square(path);
+            ASSERT_TRUE_MSG(task::LUDecomposition(mapped_square).det() == task::LUDecomposition(square).det(),
+                            "MappedMatrix LUDecomposition")
+            ASSERT_TRUE_MSG(BitwiseEqual(-mapped_square, -square) && mapped_square.eval() == square,
+                            "MappedMatrix leaf expressions")
+        }
+        std::remove(path.c_str());
+
+        std::stringstream stream;
+        task::writeBinary(stream, mat);
+        std::string bytes = stream.str();
+        for (uint64_t rows : {uint64_t(10), uint64_t(1) << 40, ~uint64_t(0) / 64}) {
+            task::BinaryHeader header;
+            std::copy(bytes.begin(), bytes.begin() + sizeof(header), reinterpret_cast<char*>(&header));
+            header.rows = rows;
+            std::string corrupt = bytes;
+            std::copy(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header) + sizeof(header),
+                      corrupt.begin());
+            std::stringstream seekable(corrupt);
+            ASSERT_EXCEPTION_MSG(task::readBinary(seekable), task::MatrixIOException, "Header claiming extra rows")
+            UnseekableBuffer buffer(corrupt);
+            std::istream pipe(&buffer);
+            ASSERT_EXCEPTION_MSG(task::readBinary(pipe), task::MatrixIOException, "Extra rows from a pipe")
+        }
+        UnseekableBuffer buffer(bytes + bytes);
+        std::istream pipe(&buffer);
+        ASSERT_TRUE_MSG(BitwiseEqual(task::readBinary(pipe), mat) && BitwiseEqual(task::readBinary(pipe), mat),
+                        "Binary round trip through a pipe")
+        std::stringstream twice(bytes + bytes);
+        ASSERT_TRUE_MSG(BitwiseEqual(task::readBinary(twice), mat) && BitwiseEqual(task::readBinary(twice), mat),
+                        "Consecutive binary matrices")
+    }
+
+
     const int STRESS_TEST_COUNT = argc > 1 ? std::stoi(argv[1]) : 0;
 
     REPEAT(STRESS_TEST_COUNT)
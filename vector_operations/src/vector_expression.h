@@ -0,0 +1,260 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "vector_simd.h"
+
+namespace task {
+
+/*
+ * CRTP base of everything that can appear in an element-wise vector
+ * expression. A concrete expression E provides
+ *   size_t size() const;
+ *   double eval(size_t i) const;
+ * Binary +, -, unary - and multiplication by a scalar build nodes lazily;
+ * the chain is evaluated in a single pass when it is converted to a
+ * std::vector<double>, so `v = a + b - 2. * c` allocates only the result.
+ *
+ * Nodes keep the vectors they were built from by reference, so `auto`
+ * does not give a vector: after `auto v = a + b;` v[i] does not compile,
+ * and v sees later writes to a and b, or dangles if one was a temporary.
+ * Name the type, `std::vector<double> v = a + b;`, to evaluate the chain.
+ */
+template <class E>
+class VectorExpression {
+ public:
+  const E& self() const { return static_cast<const E&>(*this); }
+
+  operator std::vector<double>() const {
+    std::vector<double> result(self().size());
+    evaluate_into(result.data(), self());
+    return result;
+  }
+};
+
+// A std::vector<double> operand
+class VectorLeaf : public VectorExpression<VectorLeaf> {
+ public:
+  explicit VectorLeaf(const std::vector<double>& vector)
+      : values(vector.data()), count(vector.size()) {}
+
+  size_t size() const { return count; }
+  double eval(size_t i) const { return values[i]; }
+  const double* data() const { return values; }
+
+ private:
+  const double* values;
+  size_t count;
+};
+
+/*
+ * Maps an operand type to the node stored for it: vectors become a
+ * VectorLeaf, expressions are stored as they are (a few pointers and a
+ * scalar at most). Anything else has no node, which keeps the operators
+ * below out of overload resolution for it.
+ */
+template <class T, class = void>
+struct VectorNode {};
+
+template <>
+struct VectorNode<std::vector<double>> {
+  using type = VectorLeaf;
+  static VectorLeaf wrap(const std::vector<double>& vector) {
+    return VectorLeaf(vector);
+  }
+};
+
+template <class T>
+struct VectorNode<
+    T, std::enable_if_t<std::is_base_of<VectorExpression<T>, T>::value>> {
+  using type = T;
+  static const T& wrap(const T& expression) { return expression; }
+};
+
+template <class T>
+using VectorNodeType = typename VectorNode<T>::type;
+
+struct VectorPlusOp {
+  static double apply(double a, double b) { return a + b; }
+};
+
+struct VectorMinusOp {
+  static double apply(double a, double b) { return a - b; }
+};
+
+// Sized by the left operand, as the element-wise operators always were
+template <class L, class R, class Op>
+class VectorBinaryExpression
+    : public VectorExpression<VectorBinaryExpression<L, R, Op>> {
+ public:
+  VectorBinaryExpression(const L& lhs, const R& rhs) : lhs(lhs), rhs(rhs) {}
+
+  size_t size() const { return lhs.size(); }
+  double eval(size_t i) const {
+    return Op::apply(lhs.eval(i), rhs.eval(i));
+  }
+
+  const L& left() const { return lhs; }
+  const R& right() const { return rhs; }
+
+ private:
+  L lhs;
+  R rhs;
+};
+
+template <class E>
+class VectorScaledExpression
+    : public VectorExpression<VectorScaledExpression<E>> {
+ public:
+  VectorScaledExpression(const E& operand, double factor)
+      : operand(operand), factor(factor) {}
+
+  size_t size() const { return operand.size(); }
+  double eval(size_t i) const { return operand.eval(i) * factor; }
+
+ private:
+  E operand;
+  double factor;
+};
+
+template <class E>
+class VectorNegatedExpression
+    : public VectorExpression<VectorNegatedExpression<E>> {
+ public:
+  explicit VectorNegatedExpression(const E& operand) : operand(operand) {}
+
+  size_t size() const { return operand.size(); }
+  double eval(size_t i) const { return -operand.eval(i); }
+
+  const E& inner() const { return operand; }
+
+ private:
+  E operand;
+};
+
+/*
+ * Writes every element of e to dst, which must hold e.size() elements
+ * and not overlap the operands. Single operations on plain vectors go
+ * to the SIMD kernels; longer chains run one fused loop.
+ */
+template <class E>
+void evaluate_into(double* dst, const E& e) {
+  size_t size = e.size();
+  for (size_t i = 0; i < size; i++) {
+    dst[i] = e.eval(i);
+  }
+}
+
+inline void evaluate_into(
+    double* dst,
+    const VectorBinaryExpression<VectorLeaf, VectorLeaf, VectorPlusOp>& e) {
+  simd::add(e.left().data(), e.right().data(), dst, e.size());
+}
+
+inline void evaluate_into(
+    double* dst,
+    const VectorBinaryExpression<VectorLeaf, VectorLeaf, VectorMinusOp>& e) {
+  simd::sub(e.left().data(), e.right().data(), dst, e.size());
+}
+
+inline void evaluate_into(double* dst,
+                          const VectorNegatedExpression<VectorLeaf>& e) {
+  simd::negate(e.inner().data(), dst, e.size());
+}
+
+// binary +
+template <class L, class R>
+VectorBinaryExpression<VectorNodeType<L>, VectorNodeType<R>, VectorPlusOp>
+operator+(const L& a, const R& b) {
+  return {VectorNode<L>::wrap(a), VectorNode<R>::wrap(b)};
+}
+
+// binary -
+template <class L, class R>
+VectorBinaryExpression<VectorNodeType<L>, VectorNodeType<R>, VectorMinusOp>
+operator-(const L& a, const R& b) {
+  return {VectorNode<L>::wrap(a), VectorNode<R>::wrap(b)};
+}
+
+// unary + of an expression; std::vector<double> has its own
+template <class E>
+E operator+(const VectorExpression<E>& a) {
+  return a.self();
+}
+
+// unary -
+template <class E>
+VectorNegatedExpression<VectorNodeType<E>> operator-(const E& a) {
+  return VectorNegatedExpression<VectorNodeType<E>>(VectorNode<E>::wrap(a));
+}
+
+// multiplication by a scalar
+template <class E>
+VectorScaledExpression<VectorNodeType<E>> operator*(const E& a,
+                                                    double factor) {
+  return {VectorNode<E>::wrap(a), factor};
+}
+
+template <class E>
+VectorScaledExpression<VectorNodeType<E>> operator*(double factor,
+                                                    const E& a) {
+  return {VectorNode<E>::wrap(a), factor};
+}
+
+/*
+ * Elements [begin, begin + count) of e for the dot product: a pointer into
+ * a leaf, other expressions evaluated into buffer.
+ */
+template <class E>
+const double* dot_operand(const E& e, size_t begin, size_t count,
+                          double* buffer) {
+  for (size_t i = 0; i < count; i++) {
+    buffer[i] = e.eval(begin + i);
+  }
+  return buffer;
+}
+
+inline const double* dot_operand(const VectorLeaf& e, size_t begin, size_t,
+                                 double*) {
+  return e.data() + begin;
+}
+
+// Elements of an expression evaluated at a time for the dot product
+inline const size_t DOT_CHUNK = 256;
+
+/*
+ * Dot product with an expression on either side, without materializing
+ * it. Sums in index order without fusing into FMAs, as the operator in
+ * vector_ops.h does for two plain vectors, unless
+ * simd::set_dot_reassociation(true): then operands are evaluated
+ * DOT_CHUNK elements at a time into stack buffers and each chunk goes
+ * through the SIMD kernel.
+ */
+template <class L, class R, class = VectorNodeType<L>,
+          class = VectorNodeType<R>>
+VECTOR_OPS_NO_CONTRACT double operator*(const L& a, const R& b) {
+  VECTOR_OPS_NO_CONTRACT_BODY
+  const VectorNodeType<L>& lhs = VectorNode<L>::wrap(a);
+  const VectorNodeType<R>& rhs = VectorNode<R>::wrap(b);
+  size_t size = lhs.size();
+  double result = 0;
+  if (!simd::dot_reassociation()) {
+    for (size_t i = 0; i < size; i++) {
+      result += lhs.eval(i) * rhs.eval(i);
+    }
+    return result;
+  }
+
+  double lhs_buffer[DOT_CHUNK];
+  double rhs_buffer[DOT_CHUNK];
+  for (size_t begin = 0; begin < size; begin += DOT_CHUNK) {
+    size_t count = std::min(DOT_CHUNK, size - begin);
+    result += simd::dot(dot_operand(lhs, begin, count, lhs_buffer),
+                        dot_operand(rhs, begin, count, rhs_buffer), count);
+  }
+  return result;
+}
+
+}  // namespace task
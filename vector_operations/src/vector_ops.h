@@ -3,49 +3,25 @@
 #include <iostream>
 #include <vector>
 
-namespace task {
+#include "vector_expression.h"
+#include "vector_simd.h"
 
-// binary +
-std::vector<double> operator+(const std::vector<double>& a,
-                              const std::vector<double>& b) {
-  std::vector<double> result(a.size());
-  for (size_t i = 0; i < result.size(); i++) {
-    result[i] = a[i] + b[i];
-  }
-  return result;
-}
+namespace task {
 
-// binary -
-std::vector<double> operator-(const std::vector<double>& a,
-                              const std::vector<double>& b) {
-  std::vector<double> result(a.size());
-  for (size_t i = 0; i < result.size(); i++) {
-    result[i] = a[i] - b[i];
-  }
-  return result;
-}
+/*
+ * Binary +, -, unary - and multiplication by a scalar are lazy, see
+ * vector_expression.h: they produce nodes that become a
+ * std::vector<double> on assignment.
+ */
 
 // unary +
 std::vector<double> operator+(const std::vector<double>& vector) {
   return vector;
 }
 
-// unary -
-std::vector<double> operator-(const std::vector<double>& vector) {
-  std::vector<double> result(vector.size());
-  for (size_t i = 0; i < result.size(); i++) {
-    result[i] = -vector[i];
-  }
-  return result;
-}
-
-// scalar multiply
+// scalar multiply, in index order unless simd::set_dot_reassociation(true)
 double operator*(const std::vector<double>& a, const std::vector<double>& b) {
-  double result = 0;
-  for (size_t i = 0; i < a.size(); i++) {
-    result += a[i] * b[i];
-  }
-  return result;
+  return simd::dot(a.data(), b.data(), a.size());
 }
 
 // vector multiply, only 3-dim
@@ -121,7 +97,7 @@ void reverse(std::vector<double>& vector) {
 std::vector<int> operator|(const std::vector<int>& a,
                            const std::vector<int>& b) {
   std::vector<int> result(std::min(a.size(), b.size()));
-  for (size_t i = 0; i < result.size(); i++) result[i] = a[i] | b[i];
+  simd::bit_or(a.data(), b.data(), result.data(), result.size());
   return result;
 }
 
@@ -129,7 +105,7 @@ std::vector<int> operator|(const std::vector<int>& a,
 std::vector<int> operator&(const std::vector<int>& a,
                            const std::vector<int>& b) {
   std::vector<int> result(std::min(a.size(), b.size()));
-  for (size_t i = 0; i < result.size(); i++) result[i] = a[i] & b[i];
+  simd::bit_and(a.data(), b.data(), result.data(), result.size());
   return result;
 }
 
@@ -0,0 +1,437 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VECTOR_OPS_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Keeps a * b + c in the function that follows from being fused into an
+ * FMA, which rounds once instead of twice. GCC fuses across statements
+ * whenever the target has FMA, e.g. with -march=native; clang only fuses
+ * within a statement, which VECTOR_OPS_NO_CONTRACT_BODY turns off at the
+ * start of the body.
+ */
+#if defined(__clang__)
+#define VECTOR_OPS_NO_CONTRACT
+#define VECTOR_OPS_NO_CONTRACT_BODY _Pragma("clang fp contract(off)")
+#elif defined(__GNUC__)
+#define VECTOR_OPS_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#define VECTOR_OPS_NO_CONTRACT_BODY
+#else
+#define VECTOR_OPS_NO_CONTRACT
+#define VECTOR_OPS_NO_CONTRACT_BODY
+#endif
+
+namespace task {
+namespace simd {
+
+/*
+ * Kernels behind the vector_ops operators. The widest instruction set the
+ * CPU supports is picked on first use; set_isa() can lower it, e.g. to
+ * compare against the scalar code.
+ */
+enum class Isa { Scalar, Avx2, Avx512 };
+
+namespace detail {
+
+struct Kernels {
+  void (*add)(const double*, const double*, double*, size_t);
+  void (*sub)(const double*, const double*, double*, size_t);
+  void (*negate)(const double*, double*, size_t);
+  // Reassociated: partial sums in several accumulators, added at the end
+  double (*dot)(const double*, const double*, size_t);
+  void (*bit_or)(const int*, const int*, int*, size_t);
+  void (*bit_and)(const int*, const int*, int*, size_t);
+};
+
+/*
+ * Scalar kernels, also used for the tails the AVX2 kernels leave over.
+ */
+inline void add_scalar(const double* a, const double* b, double* out,
+                       size_t size) {
+  for (size_t i = 0; i < size; i++) out[i] = a[i] + b[i];
+}
+
+inline void sub_scalar(const double* a, const double* b, double* out,
+                       size_t size) {
+  for (size_t i = 0; i < size; i++) out[i] = a[i] - b[i];
+}
+
+inline void negate_scalar(const double* a, double* out, size_t size) {
+  for (size_t i = 0; i < size; i++) out[i] = -a[i];
+}
+
+// In index order, as the original loop, and never fused into FMAs
+VECTOR_OPS_NO_CONTRACT inline double dot_strict(const double* a,
+                                                const double* b,
+                                                size_t size) {
+  VECTOR_OPS_NO_CONTRACT_BODY
+  double result = 0;
+  for (size_t i = 0; i < size; i++) result += a[i] * b[i];
+  return result;
+}
+
+inline double dot_scalar(const double* a, const double* b, size_t size) {
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    s0 += a[i] * b[i];
+    s1 += a[i + 1] * b[i + 1];
+    s2 += a[i + 2] * b[i + 2];
+    s3 += a[i + 3] * b[i + 3];
+  }
+  for (; i < size; i++) s0 += a[i] * b[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+inline void or_scalar(const int* a, const int* b, int* out, size_t size) {
+  for (size_t i = 0; i < size; i++) out[i] = a[i] | b[i];
+}
+
+inline void and_scalar(const int* a, const int* b, int* out, size_t size) {
+  for (size_t i = 0; i < size; i++) out[i] = a[i] & b[i];
+}
+
+inline const Kernels SCALAR = {add_scalar, sub_scalar, negate_scalar,
+                               dot_scalar, or_scalar,  and_scalar};
+
+#ifdef VECTOR_OPS_X86
+
+/*
+ * AVX2: 4 doubles or 8 ints per register, unaligned loads, scalar tails.
+ */
+__attribute__((target("avx2"))) inline void add_avx2(const double* a,
+                                                     const double* b,
+                                                     double* out,
+                                                     size_t size) {
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i),
+                                            _mm256_loadu_pd(b + i)));
+  }
+  add_scalar(a + i, b + i, out + i, size - i);
+}
+
+__attribute__((target("avx2"))) inline void sub_avx2(const double* a,
+                                                     const double* b,
+                                                     double* out,
+                                                     size_t size) {
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_loadu_pd(a + i),
+                                            _mm256_loadu_pd(b + i)));
+  }
+  sub_scalar(a + i, b + i, out + i, size - i);
+}
+
+__attribute__((target("avx2"))) inline void negate_avx2(const double* a,
+                                                        double* out,
+                                                        size_t size) {
+  // Flipping the sign bit matches unary minus, including -0.0
+  __m256d sign = _mm256_set1_pd(-0.);
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_xor_pd(_mm256_loadu_pd(a + i), sign));
+  }
+  negate_scalar(a + i, out + i, size - i);
+}
+
+// Four accumulators hide the latency of the dependent FMAs
+__attribute__((target("avx2,fma"))) inline double dot_avx2(const double* a,
+                                                           const double* b,
+                                                           size_t size) {
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+  __m256d s2 = _mm256_setzero_pd();
+  __m256d s3 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+    s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4),
+                         _mm256_loadu_pd(b + i + 4), s1);
+    s2 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 8),
+                         _mm256_loadu_pd(b + i + 8), s2);
+    s3 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 12),
+                         _mm256_loadu_pd(b + i + 12), s3);
+  }
+  for (; i + 4 <= size; i += 4) {
+    s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+  }
+  __m256d s = _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3));
+  double partial[4];
+  _mm256_storeu_pd(partial, s);
+  double result = (partial[0] + partial[1]) + (partial[2] + partial[3]);
+  return result + dot_strict(a + i, b + i, size - i);
+}
+
+__attribute__((target("avx2"))) inline void or_avx2(const int* a,
+                                                    const int* b, int* out,
+                                                    size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_or_si256(x, y));
+  }
+  or_scalar(a + i, b + i, out + i, size - i);
+}
+
+__attribute__((target("avx2"))) inline void and_avx2(const int* a,
+                                                     const int* b, int* out,
+                                                     size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_and_si256(x, y));
+  }
+  and_scalar(a + i, b + i, out + i, size - i);
+}
+
+inline const Kernels AVX2 = {add_avx2, sub_avx2, negate_avx2,
+                             dot_avx2, or_avx2,  and_avx2};
+
+/*
+ * AVX-512: 8 doubles or 16 ints per register, tails handled with masked
+ * loads and stores.
+ */
+__attribute__((target("avx512f"))) inline __mmask8 tail_mask8(size_t count) {
+  return static_cast<__mmask8>((1u << count) - 1);
+}
+
+__attribute__((target("avx512f"))) inline __mmask16 tail_mask16(size_t count) {
+  return static_cast<__mmask16>((1u << count) - 1);
+}
+
+__attribute__((target("avx512f"))) inline void add_avx512(const double* a,
+                                                          const double* b,
+                                                          double* out,
+                                                          size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    _mm512_storeu_pd(out + i, _mm512_add_pd(_mm512_loadu_pd(a + i),
+                                            _mm512_loadu_pd(b + i)));
+  }
+  if (i < size) {
+    __mmask8 m = tail_mask8(size - i);
+    _mm512_mask_storeu_pd(out + i, m,
+                          _mm512_add_pd(_mm512_maskz_loadu_pd(m, a + i),
+                                        _mm512_maskz_loadu_pd(m, b + i)));
+  }
+}
+
+__attribute__((target("avx512f"))) inline void sub_avx512(const double* a,
+                                                          const double* b,
+                                                          double* out,
+                                                          size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    _mm512_storeu_pd(out + i, _mm512_sub_pd(_mm512_loadu_pd(a + i),
+                                            _mm512_loadu_pd(b + i)));
+  }
+  if (i < size) {
+    __mmask8 m = tail_mask8(size - i);
+    _mm512_mask_storeu_pd(out + i, m,
+                          _mm512_sub_pd(_mm512_maskz_loadu_pd(m, a + i),
+                                        _mm512_maskz_loadu_pd(m, b + i)));
+  }
+}
+
+__attribute__((target("avx512f"))) inline void negate_avx512(const double* a,
+                                                             double* out,
+                                                             size_t size) {
+  __m512i sign = _mm512_set1_epi64(0x8000000000000000LL);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m512i x = _mm512_castpd_si512(_mm512_loadu_pd(a + i));
+    _mm512_storeu_pd(out + i, _mm512_castsi512_pd(_mm512_xor_si512(x, sign)));
+  }
+  if (i < size) {
+    __mmask8 m = tail_mask8(size - i);
+    __m512i x = _mm512_castpd_si512(_mm512_maskz_loadu_pd(m, a + i));
+    _mm512_mask_storeu_pd(out + i, m,
+                          _mm512_castsi512_pd(_mm512_xor_si512(x, sign)));
+  }
+}
+
+__attribute__((target("avx512f"))) inline double dot_avx512(const double* a,
+                                                            const double* b,
+                                                            size_t size) {
+  __m512d s0 = _mm512_setzero_pd();
+  __m512d s1 = _mm512_setzero_pd();
+  __m512d s2 = _mm512_setzero_pd();
+  __m512d s3 = _mm512_setzero_pd();
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+    s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8),
+                         _mm512_loadu_pd(b + i + 8), s1);
+    s2 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 16),
+                         _mm512_loadu_pd(b + i + 16), s2);
+    s3 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 24),
+                         _mm512_loadu_pd(b + i + 24), s3);
+  }
+  for (; i < size; i += 8) {
+    __mmask8 m = (size - i >= 8) ? static_cast<__mmask8>(0xff)
+                                 : tail_mask8(size - i);
+    s0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, a + i),
+                         _mm512_maskz_loadu_pd(m, b + i), s0);
+  }
+  __m512d s = _mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3));
+  double partial[8];
+  _mm512_storeu_pd(partial, s);
+  return ((partial[0] + partial[1]) + (partial[2] + partial[3])) +
+         ((partial[4] + partial[5]) + (partial[6] + partial[7]));
+}
+
+__attribute__((target("avx512f"))) inline void or_avx512(const int* a,
+                                                         const int* b,
+                                                         int* out,
+                                                         size_t size) {
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    _mm512_storeu_si512(out + i, _mm512_or_si512(_mm512_loadu_si512(a + i),
+                                                 _mm512_loadu_si512(b + i)));
+  }
+  if (i < size) {
+    __mmask16 m = tail_mask16(size - i);
+    _mm512_mask_storeu_epi32(
+        out + i, m,
+        _mm512_or_si512(_mm512_maskz_loadu_epi32(m, a + i),
+                        _mm512_maskz_loadu_epi32(m, b + i)));
+  }
+}
+
+__attribute__((target("avx512f"))) inline void and_avx512(const int* a,
+                                                          const int* b,
+                                                          int* out,
+                                                          size_t size) {
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    _mm512_storeu_si512(out + i, _mm512_and_si512(_mm512_loadu_si512(a + i),
+                                                  _mm512_loadu_si512(b + i)));
+  }
+  if (i < size) {
+    __mmask16 m = tail_mask16(size - i);
+    _mm512_mask_storeu_epi32(
+        out + i, m,
+        _mm512_and_si512(_mm512_maskz_loadu_epi32(m, a + i),
+                         _mm512_maskz_loadu_epi32(m, b + i)));
+  }
+}
+
+inline const Kernels AVX512 = {add_avx512, sub_avx512, negate_avx512,
+                               dot_avx512, or_avx512,  and_avx512};
+
+#endif  // VECTOR_OPS_X86
+
+inline Isa supported_isa() {
+  static const Isa isa = [] {
+#ifdef VECTOR_OPS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return Isa::Avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+      return Isa::Avx2;
+    }
+#endif
+    return Isa::Scalar;
+  }();
+  return isa;
+}
+
+inline const Kernels* kernels_for(Isa isa) {
+#ifdef VECTOR_OPS_X86
+  if (isa == Isa::Avx512) return &AVX512;
+  if (isa == Isa::Avx2) return &AVX2;
+#endif
+  (void)isa;
+  return &SCALAR;
+}
+
+struct State {
+  std::atomic<Isa> isa{supported_isa()};
+  std::atomic<const Kernels*> kernels{kernels_for(supported_isa())};
+  std::atomic<bool> reassociate{false};
+};
+
+inline State& state() {
+  static State s;
+  return s;
+}
+
+inline const Kernels& active() {
+  return *state().kernels.load(std::memory_order_relaxed);
+}
+
+// Below this the call through the table costs more than it saves
+inline const size_t SMALL_SIZE = 8;
+
+}  // namespace detail
+
+inline Isa active_isa() {
+  return detail::state().isa.load(std::memory_order_relaxed);
+}
+
+// Clamped to what the CPU supports; returns the instruction set selected
+inline Isa set_isa(Isa isa) {
+  if (isa > detail::supported_isa()) isa = detail::supported_isa();
+  detail::state().isa.store(isa, std::memory_order_relaxed);
+  detail::state().kernels.store(detail::kernels_for(isa),
+                                std::memory_order_relaxed);
+  return isa;
+}
+
+/*
+ * The dot product sums in index order by default and never fuses into
+ * FMAs, so its result does not change with the instruction set or with
+ * flags such as -march=native. Allowing reassociation lets it keep
+ * several partial sums and use FMA, several times faster on long vectors
+ * but rounded differently.
+ */
+inline void set_dot_reassociation(bool enabled) {
+  detail::state().reassociate.store(enabled, std::memory_order_relaxed);
+}
+
+inline bool dot_reassociation() {
+  return detail::state().reassociate.load(std::memory_order_relaxed);
+}
+
+inline void add(const double* a, const double* b, double* out, size_t size) {
+  if (size < detail::SMALL_SIZE) return detail::add_scalar(a, b, out, size);
+  detail::active().add(a, b, out, size);
+}
+
+inline void sub(const double* a, const double* b, double* out, size_t size) {
+  if (size < detail::SMALL_SIZE) return detail::sub_scalar(a, b, out, size);
+  detail::active().sub(a, b, out, size);
+}
+
+inline void negate(const double* a, double* out, size_t size) {
+  if (size < detail::SMALL_SIZE) return detail::negate_scalar(a, out, size);
+  detail::active().negate(a, out, size);
+}
+
+inline double dot(const double* a, const double* b, size_t size) {
+  if (size < detail::SMALL_SIZE || !dot_reassociation()) {
+    return detail::dot_strict(a, b, size);
+  }
+  return detail::active().dot(a, b, size);
+}
+
+inline void bit_or(const int* a, const int* b, int* out, size_t size) {
+  if (size < detail::SMALL_SIZE) return detail::or_scalar(a, b, out, size);
+  detail::active().bit_or(a, b, out, size);
+}
+
+inline void bit_and(const int* a, const int* b, int* out, size_t size) {
+  if (size < detail::SMALL_SIZE) return detail::and_scalar(a, b, out, size);
+  detail::active().bit_and(a, b, out, size);
+}
+
+}  // namespace simd
+}  // namespace task
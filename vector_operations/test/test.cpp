@@ -51,6 +51,14 @@ void RandomFillDouble(T& container, size_t count) {
     }
 }
 
+// Reference for the default dot product: index order, no FMAs
+VECTOR_OPS_NO_CONTRACT double StrictDot(const std::vector<double>& a, const std::vector<double>& b) {
+    VECTOR_OPS_NO_CONTRACT_BODY
+    double sum = 0.;
+    for (size_t i = 0; i < a.size(); ++i) sum += a[i] * b[i];
+    return sum;
+}
+
 
 void FailWithMsg(const std::string& msg, int line) {
     std::cerr << "Test failed!\n";
@@ -235,4 +243,126 @@ int main() {
         ASSERT_EQUAL_MSG(vec, vec2, "reverse")
     }
 
+    {
+        // Every instruction set the CPU has, on sizes around the register
+        // widths so each tail path runs, from unaligned starts
+        for (auto isa : {simd::Isa::Scalar, simd::Isa::Avx2, simd::Isa::Avx512}) {
+            simd::Isa selected = simd::set_isa(isa);
+            ASSERT_TRUE_MSG(selected <= isa && simd::active_isa() == selected, "set_isa")
+
+            for (size_t size = 0; size <= 70; ++size) {
+                std::vector<double> a, b, out(size + 1);
+                RandomFillDouble(a, size + 1);
+                RandomFillDouble(b, size + 1);
+                std::vector<int> x, y, bits(size + 1);
+                RandomFill(x, size + 1);
+                RandomFill(y, size + 1);
+
+                simd::add(a.data() + 1, b.data() + 1, out.data() + 1, size);
+                for (size_t i = 1; i <= size; ++i) {
+                    ASSERT_TRUE_MSG(out[i] == a[i] + b[i], "simd::add")
+                }
+                simd::sub(a.data() + 1, b.data() + 1, out.data() + 1, size);
+                for (size_t i = 1; i <= size; ++i) {
+                    ASSERT_TRUE_MSG(out[i] == a[i] - b[i], "simd::sub")
+                }
+                simd::negate(a.data() + 1, out.data() + 1, size);
+                for (size_t i = 1; i <= size; ++i) {
+                    ASSERT_TRUE_MSG(out[i] == -a[i], "simd::negate")
+                }
+                simd::bit_or(x.data() + 1, y.data() + 1, bits.data() + 1, size);
+                for (size_t i = 1; i <= size; ++i) {
+                    ASSERT_TRUE_MSG(bits[i] == (x[i] | y[i]), "simd::bit_or")
+                }
+                simd::bit_and(x.data() + 1, y.data() + 1, bits.data() + 1, size);
+                for (size_t i = 1; i <= size; ++i) {
+                    ASSERT_TRUE_MSG(bits[i] == (x[i] & y[i]), "simd::bit_and")
+                }
+
+                double sum = StrictDot(std::vector<double>(a.begin() + 1, a.end()),
+                                       std::vector<double>(b.begin() + 1, b.end()));
+                double magnitude = 0.;
+                for (size_t i = 1; i <= size; ++i) magnitude += fabs(a[i] * b[i]);
+                ASSERT_TRUE_MSG(simd::dot(a.data() + 1, b.data() + 1, size) == sum, "Strict dot product")
+                simd::set_dot_reassociation(true);
+                ASSERT_TRUE_MSG(fabs(simd::dot(a.data() + 1, b.data() + 1, size) - sum) <= 1e-14 * magnitude,
+                                "Reassociated dot product")
+                simd::set_dot_reassociation(false);
+            }
+        }
+
+        simd::Isa best = simd::set_isa(simd::Isa::Avx512);
+        ASSERT_TRUE_MSG(best == simd::detail::supported_isa() && simd::active_isa() == best, "set_isa clamping")
+        ASSERT_TRUE_MSG(!simd::dot_reassociation(), "set_dot_reassociation")
+    }
+
+
+    REPEAT(20)
+    {
+        // Lazy chains against naive loops, including empty vectors and
+        // sizes that are not multiples of the register widths
+        for (size_t size : {0, 1, 7, 9, 255, 257, 1000}) {
+            std::vector<double> a, b, c;
+            RandomFillDouble(a, size);
+            RandomFillDouble(b, size);
+            RandomFillDouble(c, size);
+            double factor = RandomDouble();
+
+            std::vector<double> chain = a + b - factor * c;
+            std::vector<double> scaled = -(a - b) * 2.;
+            std::vector<double> nested = +(a + (b - c)) + -a;
+            ASSERT_TRUE_MSG(chain.size() == size && scaled.size() == size && nested.size() == size,
+                            "Expression size")
+            for (size_t i = 0; i < size; ++i) {
+                ASSERT_TRUE_MSG(chain[i] == a[i] + b[i] - c[i] * factor, "Expression chain")
+                ASSERT_TRUE_MSG(scaled[i] == -(a[i] - b[i]) * 2., "Scaled expression")
+                ASSERT_TRUE_MSG(nested[i] == (a[i] + (b[i] - c[i])) + -a[i], "Nested expression")
+            }
+
+            // Operands that are also the destination
+            std::vector<double> v = a, w = b;
+            v = v + w;
+            w = v - w * 3.;
+            v = -v;
+            for (size_t i = 0; i < size; ++i) {
+                ASSERT_TRUE_MSG(v[i] == -(a[i] + b[i]) && w[i] == (a[i] + b[i]) - b[i] * 3., "Aliased operands")
+            }
+
+            // Dot products with expressions: index order by default,
+            // chunks through the SIMD kernel when reassociation is allowed
+            std::vector<double> sums(size), factors(size), differences(size);
+            double magnitude = 0.;
+            for (size_t i = 0; i < size; ++i) {
+                sums[i] = a[i] + b[i];
+                factors[i] = c[i] * factor;
+                differences[i] = b[i] - c[i];
+                magnitude += fabs(sums[i] * factors[i]);
+            }
+            double strict = StrictDot(sums, factors);
+            ASSERT_TRUE_MSG((a + b) * (c * factor) == strict, "Dot product of expressions")
+            double leaf = StrictDot(a, differences);
+            ASSERT_TRUE_MSG(a * (b - c) == leaf && (b - c) * a == a * (b - c), "Dot product with a vector")
+            simd::set_dot_reassociation(true);
+            ASSERT_TRUE_MSG(fabs((a + b) * (c * factor) - strict) <= 1e-14 * magnitude,
+                            "Reassociated dot product of expressions")
+            simd::set_dot_reassociation(false);
+
+            // Nodes convert to vectors for the other operators
+            if (size == 7) {
+                std::vector<double> d = a + b;
+                ASSERT_TRUE_MSG((a + b) || d, "Collinearity of an expression")
+                ASSERT_TRUE_MSG(((a + b) && (a + b) * 2.) && !((a + b) && -(a + b)),
+                                "Codirectionality of an expression")
+            }
+        }
+
+        std::vector<double> a, b, c;
+        RandomFillDouble(a, 3);
+        RandomFillDouble(b, 3);
+        RandomFillDouble(c, 3);
+        std::vector<double> cross = (a + b) % (c - a);
+        std::vector<double> expected = std::vector<double>(a + b) % std::vector<double>(c - a);
+        ASSERT_EQUAL_MSG(cross, expected, "Cross product of expressions")
+    }
+
 }